@@ -44,10 +44,35 @@ void Game::init() {
   } else {
     ERRLOG("Failed to create player sprite");
   }
+
+  if (PhysicsEngine* physics = engine.getPhysicsEngine()) {
+    spawnBodies(*physics, winSize);
+  }
   
   LOG("Game initialized");
 }
 
+// A pile of circles dropped into a box the size of the window.
+void Game::spawnBodies(PhysicsEngine& physics, const WindowData& window) {
+  const float width = static_cast<float>(window.width);
+  const float height = static_cast<float>(window.height);
+  physics.setGravity({0.0f, 600.0f});
+  physics.addBoundaryPlane({1.0f, 0.0f}, 0.0f);
+  physics.addBoundaryPlane({-1.0f, 0.0f}, -width);
+  physics.addBoundaryPlane({0.0f, -1.0f}, -height);
+
+  const int columns = 16;
+  const int rows = 6;
+  const float spacing = 3.0f * BODY_RADIUS;
+  for (int row = 0; row < rows; ++row) {
+    for (int column = 0; column < columns; ++column) {
+      const glm::vec2 position(width * 0.5f + (static_cast<float>(column - columns / 2) + 0.5f) * spacing + static_cast<float>(row % 2) * BODY_RADIUS,
+                               static_cast<float>(row + 1) * spacing);
+      m_bodies.push_back(physics.addBody(RigidBody::createCircle(BodyType::DYNAMIC, position, BODY_RADIUS)));
+    }
+  }
+}
+
 void Game::handleInput(const SDL_Event& event) {
   SDL_GetMouseState(&m_playerPosition.x, &m_playerPosition.y);
 }
@@ -58,8 +83,20 @@ void Game::update(double deltaTime) {
   }
 }
 
-void Game::render(IRenderer* renderer) {
-  if (!renderer) return;
+void Game::render(IRenderer* renderer, double interpolation) {
+  if (!renderer || !m_playerSprite) return;
+
+  const Texture* texture = m_playerSprite->getTexture();
+  if (PhysicsEngine* physics = Engine::getInstance().getPhysicsEngine()) {
+    const float alpha = static_cast<float>(interpolation);
+    const glm::vec2 size(2.0f * BODY_RADIUS);
+    for (BodyHandle handle : m_bodies) {
+      BodyRef body = physics->getBody(handle);
+      if (!body) continue;
+
+      renderer->drawSprite(texture, body.interpolatedPosition(alpha), size, body.interpolatedRotation(alpha));
+    }
+  }
   
-  renderer->drawSprite(m_playerSprite->getTexture(), m_playerPosition, m_playerSprite->getSize() / 6.0f);
+  renderer->drawSprite(texture, m_playerPosition, m_playerSprite->getSize() / 6.0f);
 }
\ No newline at end of file
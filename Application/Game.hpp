@@ -10,11 +10,17 @@ public:
   void init();
   void handleInput(const SDL_Event& event);
   void update(double deltaTime);
-  void render(IRenderer* renderer);
+  // interpolation is the fraction of a fixed step elapsed since the last
+  // update(); physics bodies are drawn at BodyRef::interpolatedPosition().
+  void render(IRenderer* renderer, double interpolation);
 
   bool isRunning() const { return m_running; }
 
 private:
+  static constexpr float BODY_RADIUS = 8.0f;
+
+  void spawnBodies(PhysicsEngine& physics, const WindowData& window);
+
   bool m_running = true;
   
   Texture m_backgroundTexture;
@@ -26,6 +32,8 @@ private:
   glm::vec2 m_playerPosition = {100.0f, 100.0f};
   glm::vec2 m_playerVelocity = {0.0f, 0.0f};
   float m_playerSpeed = 200.0f;
+
+  std::vector<BodyHandle> m_bodies;
   
   bool m_keyUp = false;
   bool m_keyDown = false;
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts calls to the global operator new of this executable. The bench
+// replaces the allocation functions, so every allocation the engine makes
+// on any thread is seen. Over-aligned allocations are not counted.
+namespace AllocationCounter {
+  uint64_t count();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "BenchReport.hpp"
+#include "Physics/Physics.hpp"
+#include "Core/JobSystem.hpp"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct BenchOptions {
+  uint32_t workers = JobSystem::defaultWorkerCount();
+  BroadPhaseType broadPhase = BroadPhaseType::SPATIAL_HASH;
+  IntegrationMethod integrationMethod = IntegrationMethod::VERLET;
+  // Overrides every scene's timed step count when non-zero.
+  uint32_t steps = 0;
+  // Skips the million-body runs.
+  bool quick = false;
+  // PhysicsEngine::setReorderInterval() for the scenes; 0 keeps it off.
+  uint32_t reorderInterval = 0;
+  // Hardware cache miss counts where the platform allows them.
+  bool perfCounters = false;
+};
+
+class Stopwatch {
+public:
+  Stopwatch() : m_start(std::chrono::steady_clock::now()) {}
+
+  void restart() { m_start = std::chrono::steady_clock::now(); }
+
+  double elapsedNs() const {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - m_start).count();
+  }
+
+private:
+  std::chrono::steady_clock::time_point m_start;
+};
+
+// A canonical stress scene. build() fills an empty engine; beforeStep()
+// runs ahead of every update() for scenes that spawn or remove bodies and
+// is timed separately from the step.
+class BenchScene {
+public:
+  virtual ~BenchScene() = default;
+
+  virtual const char* getName() const = 0;
+  virtual uint32_t getSteps() const = 0;
+  virtual bool isLarge() const { return false; }
+  virtual bool spawnsBodies() const { return false; }
+  virtual void build(PhysicsEngine& engine) = 0;
+  virtual void beforeStep(PhysicsEngine& engine, uint32_t step) { (void)engine; (void)step; }
+};
+
+// Falling circles in a walled box, the base of the circle_rain scenes.
+// Shuffled adds them in random order, as if a long run had scattered them.
+void buildCircleRain(PhysicsEngine& engine, uint32_t count, bool shuffled = false);
+
+std::vector<std::unique_ptr<BenchScene>> createBenchScenes();
+BenchResult runBenchScene(BenchScene& scene, const BenchOptions& options, JobSystem& jobSystem);
+
+// Microbenchmarks of single building blocks, outside a full step.
+BenchResult benchSpatialHash(uint32_t bodyCount);
+BenchResult benchJobOverhead(JobSystem& jobSystem);
+BenchResult benchCircleKernel();
+BenchResult benchRaycast(JobSystem& jobSystem);
+BenchResult benchSnapshot(const BenchOptions& options, JobSystem& jobSystem);
+BenchResult benchParticles(uint32_t particleCount, JobSystem& jobSystem);
+BenchResult benchBodyReorder(const BenchOptions& options, JobSystem& jobSystem);
@@ -0,0 +1,222 @@
+#include "BenchReport.hpp"
+#include "Logger/Logger.hpp"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace {
+  enum class MetricDirection {
+    NONE,
+    LOWER_IS_BETTER,
+    HIGHER_IS_BETTER
+  };
+
+  bool startsWith(const std::string& text, const char* prefix) {
+    return text.compare(0, std::char_traits<char>::length(prefix), prefix) == 0;
+  }
+
+  bool endsWith(const std::string& text, const char* suffix) {
+    const size_t length = std::char_traits<char>::length(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+  }
+
+  MetricDirection metricDirection(const std::string& key) {
+    if (startsWith(key, "ns_") || startsWith(key, "allocations_")) return MetricDirection::LOWER_IS_BETTER;
+    if (endsWith(key, "_per_second") || key == "speedup") return MetricDirection::HIGHER_IS_BETTER;
+    return MetricDirection::NONE;
+  }
+
+  std::string formatNumber(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+    return buffer;
+  }
+
+  // Just enough JSON for the files writeBenchReport() produces: objects,
+  // arrays, strings without escapes and numbers.
+  class JsonReader {
+  public:
+    explicit JsonReader(const std::string& text) : m_text(text) {}
+
+    bool readReport(BenchReport& report) {
+      if (!consume('{')) return false;
+      if (consume('}')) return true;
+
+      do {
+        std::string key;
+        if (!readString(key) || !consume(':')) return false;
+
+        if (key == "results") {
+          if (!readResults(report.results)) return false;
+        } else if (key == "kernel") {
+          if (!readString(report.kernel)) return false;
+        } else {
+          double value = 0.0;
+          if (!readNumber(value)) return false;
+          if (key == "threads") report.threads = static_cast<uint32_t>(value);
+        }
+      } while (consume(','));
+
+      return consume('}');
+    }
+
+  private:
+    const std::string& m_text;
+    size_t m_pos = 0;
+
+    void skipSpace() {
+      while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos]))) {
+        m_pos++;
+      }
+    }
+
+    bool consume(char c) {
+      skipSpace();
+      if (m_pos < m_text.size() && m_text[m_pos] == c) {
+        m_pos++;
+        return true;
+      }
+      return false;
+    }
+
+    bool readString(std::string& out) {
+      if (!consume('"')) return false;
+      size_t end = m_text.find('"', m_pos);
+      if (end == std::string::npos) return false;
+
+      out = m_text.substr(m_pos, end - m_pos);
+      m_pos = end + 1;
+      return true;
+    }
+
+    bool readNumber(double& out) {
+      skipSpace();
+      const char* begin = m_text.c_str() + m_pos;
+      char* end = nullptr;
+      out = std::strtod(begin, &end);
+      if (end == begin) return false;
+
+      m_pos += static_cast<size_t>(end - begin);
+      return true;
+    }
+
+    bool readResults(std::vector<BenchResult>& results) {
+      if (!consume('[')) return false;
+      if (consume(']')) return true;
+
+      do {
+        BenchResult result;
+        if (!consume('{')) return false;
+        do {
+          std::string key;
+          if (!readString(key) || !consume(':')) return false;
+
+          if (key == "name") {
+            if (!readString(result.name)) return false;
+          } else {
+            double value = 0.0;
+            if (!readNumber(value)) return false;
+            result.add(key, value);
+          }
+        } while (consume(','));
+        if (!consume('}')) return false;
+
+        results.push_back(std::move(result));
+      } while (consume(','));
+
+      return consume(']');
+    }
+  };
+}
+
+const double* BenchResult::find(const std::string& key) const {
+  for (const auto& metric : metrics) {
+    if (metric.first == key) return &metric.second;
+  }
+  return nullptr;
+}
+
+bool writeBenchReport(const std::string& path, const BenchReport& report) {
+  std::ofstream file(path);
+  if (!file) {
+    ERRLOG("Failed to open ", path, " for writing");
+    return false;
+  }
+
+  file << "{\n";
+  file << "  \"kernel\": \"" << report.kernel << "\",\n";
+  file << "  \"threads\": " << report.threads << ",\n";
+  file << "  \"results\": [\n";
+  for (size_t i = 0; i < report.results.size(); ++i) {
+    const BenchResult& result = report.results[i];
+    file << "    {\"name\": \"" << result.name << "\"";
+    for (const auto& metric : result.metrics) {
+      file << ", \"" << metric.first << "\": " << formatNumber(metric.second);
+    }
+    file << (i + 1 < report.results.size() ? "},\n" : "}\n");
+  }
+  file << "  ]\n";
+  file << "}\n";
+
+  return static_cast<bool>(file);
+}
+
+bool readBenchReport(const std::string& path, BenchReport& report) {
+  std::ifstream file(path);
+  if (!file) {
+    ERRLOG("Failed to open baseline ", path);
+    return false;
+  }
+
+  std::stringstream contents;
+  contents << file.rdbuf();
+  const std::string text = contents.str();
+
+  JsonReader reader(text);
+  if (!reader.readReport(report)) {
+    ERRLOG("Failed to parse baseline ", path);
+    return false;
+  }
+  return true;
+}
+
+size_t compareBenchReports(const BenchReport& current, const BenchReport& baseline, double tolerance) {
+  if (current.kernel != baseline.kernel || current.threads != baseline.threads) {
+    WARLOG("Baseline was recorded with kernel ", baseline.kernel, " on ", baseline.threads,
+           " threads, this run uses ", current.kernel, " on ", current.threads);
+  }
+
+  size_t regressions = 0;
+  for (const BenchResult& result : current.results) {
+    const BenchResult* previous = nullptr;
+    for (const BenchResult& candidate : baseline.results) {
+      if (candidate.name == result.name) {
+        previous = &candidate;
+        break;
+      }
+    }
+    if (!previous) continue;
+
+    for (const auto& metric : result.metrics) {
+      MetricDirection direction = metricDirection(metric.first);
+      const double* base = previous->find(metric.first);
+      if (direction == MetricDirection::NONE || !base) continue;
+
+      const double value = metric.second;
+      bool worse = direction == MetricDirection::LOWER_IS_BETTER ? value > *base * (1.0 + tolerance)
+                                                                  : value < *base * (1.0 - tolerance);
+      bool better = direction == MetricDirection::LOWER_IS_BETTER ? value < *base * (1.0 - tolerance)
+                                                                   : value > *base * (1.0 + tolerance);
+      if (worse) {
+        WARLOG("Regression ", result.name, ".", metric.first, ": ", formatNumber(*base), " -> ", formatNumber(value));
+        regressions++;
+      } else if (better) {
+        LOG("Improved ", result.name, ".", metric.first, ": ", formatNumber(*base), " -> ", formatNumber(value));
+      }
+    }
+  }
+
+  return regressions;
+}
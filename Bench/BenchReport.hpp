@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One scene or microbenchmark run. Metrics are flat name/value pairs; the
+// name prefix decides how a baseline comparison treats them: "ns_" and
+// "allocations_" are lower-is-better, "_per_second" and "speedup"
+// higher-is-better, everything else (body and step counts) only describes
+// the run.
+struct BenchResult {
+  std::string name;
+  std::vector<std::pair<std::string, double>> metrics;
+
+  void add(const std::string& key, double value) { metrics.emplace_back(key, value); }
+  const double* find(const std::string& key) const;
+};
+
+struct BenchReport {
+  std::string kernel;
+  uint32_t threads = 1;
+  std::vector<BenchResult> results;
+};
+
+bool writeBenchReport(const std::string& path, const BenchReport& report);
+// Reads the results of a report written by writeBenchReport().
+bool readBenchReport(const std::string& path, BenchReport& report);
+// Logs every compared metric that moved by more than tolerance (0.1 = 10%)
+// and returns how many of them got worse.
+size_t compareBenchReports(const BenchReport& current, const BenchReport& baseline, double tolerance);
@@ -0,0 +1,444 @@
+#include "Bench.hpp"
+#include "AllocationCounter.hpp"
+#include "PerfCounters.hpp"
+#include "Physics/SpatialHash.hpp"
+#include "Physics/NarrowPhaseKernels.hpp"
+#include "Physics/ParticleSystem.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+
+namespace {
+  std::string countLabel(uint32_t count) {
+    if (count >= 1000000 && count % 1000000 == 0) return std::to_string(count / 1000000) + "m";
+    if (count >= 1000 && count % 1000 == 0) return std::to_string(count / 1000) + "k";
+    return std::to_string(count);
+  }
+
+  // Keeps results alive so the compiler cannot drop the measured work.
+  volatile uint64_t g_sink = 0;
+}
+
+// Bodies drift by up to a quarter cell per step, so most updates keep their
+// cells and the rest re-file, as in a settling scene.
+BenchResult benchSpatialHash(uint32_t bodyCount) {
+  const float radius = 2.0f;
+  const float cellSize = 4.0f * radius;
+  const float side = std::sqrt(static_cast<float>(bodyCount)) * 5.0f;
+  const uint32_t steps = std::max(3u, 3000000u / bodyCount);
+
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<float> coordinate(0.0f, side);
+  std::uniform_real_distribution<float> drift(-0.25f * cellSize, 0.25f * cellSize);
+
+  std::vector<glm::vec2> positions(bodyCount);
+  for (glm::vec2& position : positions) {
+    position = {coordinate(rng), coordinate(rng)};
+  }
+
+  SpatialHash hash(cellSize);
+  std::vector<BodyPair> pairs;
+  const CollisionFilter filter;
+  auto step = [&]() {
+    for (uint32_t i = 0; i < bodyCount; ++i) {
+      const glm::vec2 extent(radius);
+      hash.update(i, AABB{positions[i] - extent, positions[i] + extent}, false, filter);
+    }
+    hash.computePairs(pairs);
+  };
+
+  // The first steps size the tables.
+  step();
+  step();
+
+  double ns = 0.0;
+  uint64_t pairCount = 0;
+  uint64_t allocations = 0;
+  for (uint32_t s = 0; s < steps; ++s) {
+    for (glm::vec2& position : positions) {
+      position += glm::vec2(drift(rng), drift(rng));
+    }
+
+    const uint64_t allocationsBefore = AllocationCounter::count();
+    Stopwatch watch;
+    step();
+    ns += watch.elapsedNs();
+    allocations += AllocationCounter::count() - allocationsBefore;
+    pairCount += pairs.size();
+  }
+
+  BenchResult result;
+  result.name = "spatial_hash_" + countLabel(bodyCount);
+  result.add("bodies", bodyCount);
+  result.add("cells_used", static_cast<double>(hash.getUsedCellCount()));
+  result.add("ns_per_body", ns / steps / bodyCount);
+  result.add("pairs_per_second", static_cast<double>(pairCount) * 1e9 / ns);
+  result.add("allocations_per_step", static_cast<double>(allocations) / steps);
+  return result;
+}
+
+// Cost of the scheduler itself: empty jobs submitted and waited for one
+// counter, and an empty parallelFor split down to its grain size.
+BenchResult benchJobOverhead(JobSystem& jobSystem) {
+  const uint32_t jobCount = 20000;
+  const uint32_t rounds = 20;
+  const uint32_t rangeCount = 1u << 20;
+  const uint32_t grainSize = 1024;
+
+  double jobNs = 0.0;
+  uint64_t jobAllocations = 0;
+  for (uint32_t round = 0; round < rounds; ++round) {
+    JobCounter counter;
+    const uint64_t allocationsBefore = AllocationCounter::count();
+    Stopwatch watch;
+    for (uint32_t i = 0; i < jobCount; ++i) {
+      jobSystem.run([](uint32_t) {}, &counter);
+    }
+    jobSystem.wait(counter);
+    jobNs += watch.elapsedNs();
+    jobAllocations += AllocationCounter::count() - allocationsBefore;
+  }
+
+  double rangeNs = 0.0;
+  for (uint32_t round = 0; round < rounds; ++round) {
+    Stopwatch watch;
+    jobSystem.parallelFor(rangeCount, grainSize, [](uint32_t begin, uint32_t end, uint32_t) {
+      g_sink = g_sink + (end - begin);
+    });
+    rangeNs += watch.elapsedNs();
+  }
+
+  const double jobs = static_cast<double>(jobCount) * rounds;
+  const double ranges = static_cast<double>(rangeCount / grainSize) * rounds;
+
+  BenchResult result;
+  result.name = "job_overhead";
+  result.add("threads", jobSystem.getThreadCount());
+  result.add("ns_per_job", jobNs / jobs);
+  result.add("ns_per_range", rangeNs / ranges);
+  result.add("allocations_per_job", static_cast<double>(jobAllocations) / jobs);
+  return result;
+}
+
+// collideCircleBatch() against circleVsCircle() on the same random pairs.
+// Like the narrow phase, each batch is queued into one reused
+// CirclePairBatch right before the kernel runs. ns_per_pair_gather is the
+// queueing, ns_per_pair the kernel, and speedup compares the scalar test
+// with both together.
+BenchResult benchCircleKernel() {
+  const uint32_t bodyCount = 4096;
+  const uint32_t batchCount = 1024;
+  const uint32_t rounds = 10;
+
+  std::mt19937 rng(9);
+  std::uniform_real_distribution<float> coordinate(0.0f, 200.0f);
+  std::uniform_real_distribution<float> radius(1.0f, 4.0f);
+  std::uniform_int_distribution<uint32_t> body(0, bodyCount - 1);
+
+  BodyStorage storage;
+  storage.reserve(bodyCount);
+  for (uint32_t i = 0; i < bodyCount; ++i) {
+    storage.add(RigidBody::createCircle(BodyType::DYNAMIC, {coordinate(rng), coordinate(rng)}, radius(rng)));
+  }
+
+  const uint32_t pairCount = batchCount * CirclePairBatch::CAPACITY;
+  std::vector<uint32_t> bodiesA;
+  std::vector<uint32_t> bodiesB;
+  bodiesA.reserve(pairCount);
+  bodiesB.reserve(pairCount);
+  while (bodiesA.size() < pairCount) {
+    uint32_t a = body(rng);
+    uint32_t b = body(rng);
+    if (a == b) continue;
+    bodiesA.push_back(a);
+    bodiesB.push_back(b);
+  }
+
+  CirclePairBatch batch;
+  CircleContactBatch contacts;
+  auto queueBatch = [&](uint32_t begin) {
+    batch.clear();
+    for (uint32_t i = begin; i < begin + CirclePairBatch::CAPACITY; ++i) {
+      batch.push(bodiesA[i], bodiesB[i]);
+    }
+  };
+
+  // Per-batch timers would cost more than the work they time, so the
+  // queueing is timed in a pass of its own and subtracted.
+  Stopwatch watch;
+  for (uint32_t round = 0; round < rounds; ++round) {
+    for (uint32_t begin = 0; begin < pairCount; begin += CirclePairBatch::CAPACITY) {
+      queueBatch(begin);
+      g_sink = g_sink + batch.bodyA[begin % CirclePairBatch::CAPACITY];
+    }
+  }
+  const double gatherNs = watch.elapsedNs();
+
+  uint64_t kernelContacts = 0;
+  watch.restart();
+  for (uint32_t round = 0; round < rounds; ++round) {
+    for (uint32_t begin = 0; begin < pairCount; begin += CirclePairBatch::CAPACITY) {
+      queueBatch(begin);
+      kernelContacts += collideCircleBatch(storage, batch, contacts);
+    }
+  }
+  const double batchedNs = watch.elapsedNs();
+
+  uint64_t scalarContacts = 0;
+  watch.restart();
+  for (uint32_t round = 0; round < rounds; ++round) {
+    for (uint32_t i = 0; i < pairCount; ++i) {
+      Collision collision;
+      scalarContacts += circleVsCircle(storage, bodiesA[i], bodiesB[i], collision) ? 1u : 0u;
+    }
+  }
+  const double scalarNs = watch.elapsedNs();
+  g_sink = g_sink + kernelContacts + scalarContacts;
+
+  if (kernelContacts != scalarContacts) {
+    WARLOG("Circle kernel found ", kernelContacts, " contacts, the scalar test ", scalarContacts);
+  }
+
+  const double pairs = static_cast<double>(pairCount) * rounds;
+
+  BenchResult result;
+  result.name = "circle_kernel";
+  result.add("ns_per_pair", std::max(batchedNs - gatherNs, 0.0) / pairs);
+  result.add("ns_per_pair_gather", gatherNs / pairs);
+  result.add("ns_per_pair_scalar", scalarNs / pairs);
+  result.add("speedup", scalarNs / batchedNs);
+  return result;
+}
+
+// Random segments through a settled circle_rain_100k scene, traced as one
+// batch and one ray at a time.
+BenchResult benchRaycast(JobSystem& jobSystem) {
+  const uint32_t bodyCount = 100000;
+  const uint32_t rayCount = 100000;
+
+  PhysicsEngine engine;
+  engine.setJobSystem(&jobSystem);
+  buildCircleRain(engine, bodyCount);
+  for (int step = 0; step < 30; ++step) {
+    engine.update(1.0f / 60.0f);
+  }
+
+  // buildCircleRain() places bodies over about this square.
+  const float side = std::sqrt(static_cast<float>(bodyCount) * 2.0f) * 5.0f;
+  std::mt19937 rng(13);
+  std::uniform_real_distribution<float> coordinate(0.0f, side);
+  std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+  std::vector<Ray> rays(rayCount);
+  for (Ray& ray : rays) {
+    const float a = angle(rng);
+    ray.from = {coordinate(rng), coordinate(rng) * 0.5f};
+    ray.to = ray.from + glm::vec2(std::cos(a), std::sin(a)) * 100.0f;
+  }
+  std::vector<RaycastHit> hits(rayCount);
+
+  // Brings the broad phase up to date outside the timed calls.
+  engine.raycast(rays[0], hits[0]);
+
+  Stopwatch watch;
+  engine.raycastBatch(rays.data(), hits.data(), rayCount);
+  const double batchNs = watch.elapsedNs();
+
+  uint64_t hitCount = 0;
+  watch.restart();
+  for (uint32_t i = 0; i < rayCount; ++i) {
+    RaycastHit hit;
+    hitCount += engine.raycast(rays[i], hit) ? 1u : 0u;
+  }
+  const double singleNs = watch.elapsedNs();
+
+  BenchResult result;
+  result.name = "raycast_" + countLabel(bodyCount);
+  result.add("rays", rayCount);
+  result.add("hit_fraction", static_cast<double>(hitCount) / rayCount);
+  result.add("ns_per_ray", batchNs / rayCount);
+  result.add("ns_per_ray_single", singleNs / rayCount);
+  return result;
+}
+
+BenchResult benchSnapshot(const BenchOptions& options, JobSystem& jobSystem) {
+  const uint32_t bodyCount = 10000;
+  const uint32_t rounds = 50;
+
+  PhysicsEngine engine;
+  engine.setBroadPhase(options.broadPhase);
+  engine.setIntegrationMethod(options.integrationMethod);
+  engine.setJobSystem(&jobSystem);
+  buildCircleRain(engine, bodyCount);
+  for (int step = 0; step < 120; ++step) {
+    engine.update(1.0f / 60.0f);
+  }
+
+  std::vector<uint8_t> buffer;
+  engine.saveSnapshot(buffer);
+
+  Stopwatch watch;
+  for (uint32_t round = 0; round < rounds; ++round) {
+    engine.saveSnapshot(buffer);
+  }
+  const double saveNs = watch.elapsedNs();
+
+  // The first restore sizes the validation scratch.
+  engine.restoreSnapshot(buffer);
+  const uint64_t allocationsBefore = AllocationCounter::count();
+  watch.restart();
+  for (uint32_t round = 0; round < rounds; ++round) {
+    engine.restoreSnapshot(buffer);
+  }
+  const double restoreNs = watch.elapsedNs();
+  const uint64_t allocations = AllocationCounter::count() - allocationsBefore;
+
+  BenchResult result;
+  result.name = "snapshot_" + countLabel(bodyCount);
+  result.add("bytes", static_cast<double>(buffer.size()));
+  result.add("ns_save", saveNs / rounds);
+  result.add("ns_restore", restoreNs / rounds);
+  result.add("allocations_per_restore", static_cast<double>(allocations) / rounds);
+  return result;
+}
+
+// The same circle rain twice, added in random order: once left in that
+// order and once kept in Morton order. The pair span shows how far apart in
+// memory the candidate pairs are; the step times show what that costs.
+// ns_reorder is the first, full reorder of the shuffled bodies and
+// ns_reorder_per_step that cost spread over the reorder interval; the
+// sorted step times include the reorders due within them. Cache misses are
+// only reported with --perf-counters where the kernel allows it.
+BenchResult benchBodyReorder(const BenchOptions& options, JobSystem& jobSystem) {
+  const uint32_t bodyCount = 100000;
+  const uint32_t warmupSteps = 20;
+  const uint32_t steps = options.steps ? options.steps : 60;
+  const uint32_t interval = options.reorderInterval ? options.reorderInterval : 60;
+
+  CacheMissCounter missCounter;
+  const bool countMisses = options.perfCounters && missCounter.open();
+
+  double stepNs[2] = {};
+  double pairSpan[2] = {};
+  double misses[2] = {};
+  double reorderNs = 0.0;
+  for (int sorted = 0; sorted < 2; ++sorted) {
+    PhysicsEngine engine;
+    engine.setBroadPhase(options.broadPhase);
+    engine.setIntegrationMethod(options.integrationMethod);
+    engine.setJobSystem(&jobSystem);
+    engine.setProfilingEnabled(true);
+    buildCircleRain(engine, bodyCount, true);
+    if (sorted) {
+      Stopwatch watch;
+      engine.reorderBodies();
+      reorderNs = watch.elapsedNs();
+      engine.setReorderInterval(interval);
+    }
+
+    for (uint32_t step = 0; step < warmupSteps; ++step) {
+      engine.update(1.0f / 60.0f);
+    }
+    for (uint32_t step = 0; step < steps; ++step) {
+      missCounter.start();
+      Stopwatch watch;
+      engine.update(1.0f / 60.0f);
+      stepNs[sorted] += watch.elapsedNs();
+      misses[sorted] += static_cast<double>(missCounter.stop());
+      pairSpan[sorted] += static_cast<double>(engine.getStats().pairSpan);
+    }
+  }
+
+  BenchResult result;
+  result.name = "body_reorder_" + countLabel(bodyCount);
+  result.add("reorder_interval", interval);
+  result.add("pair_span_shuffled", pairSpan[0] / steps);
+  result.add("pair_span_sorted", pairSpan[1] / steps);
+  result.add("ns_per_step_shuffled", stepNs[0] / steps);
+  result.add("ns_per_step_sorted", stepNs[1] / steps);
+  result.add("ns_reorder", reorderNs);
+  result.add("ns_reorder_per_step", reorderNs / interval);
+  if (countMisses) {
+    result.add("cache_misses_per_step_shuffled", misses[0] / steps);
+    result.add("cache_misses_per_step_sorted", misses[1] / steps);
+  }
+  result.add("speedup", stepNs[1] > 0.0 ? stepNs[0] / stepNs[1] : 0.0);
+  return result;
+}
+
+// Particles of radius 1 on a jittered grid falling into a walled box, past
+// static circles and tilted slabs, onto the floor. A step's result does not
+// depend on the thread count, so steps alternate between the job system
+// and the calling thread alone, and speedup is the scaling over one thread
+// on the same trajectory.
+BenchResult benchParticles(uint32_t particleCount, JobSystem& jobSystem) {
+  const float spacing = 2.5f;
+  const uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(particleCount) * 2.0f)));
+  const uint32_t rows = (particleCount + columns - 1) / columns;
+  const float width = static_cast<float>(columns) * spacing;
+  const float floor = static_cast<float>(rows) * spacing * 3.0f;
+  const uint32_t warmupSteps = 10;
+  const uint32_t steps = std::max(20u, 20000000u / particleCount);
+
+  PhysicsEngine world;
+  const float obstacleY = static_cast<float>(rows) * spacing * 1.8f;
+  for (float x = width * 0.125f; x < width; x += width * 0.25f) {
+    world.addBody(RigidBody::createCircle(BodyType::STATIC, {x, obstacleY}, width * 0.04f));
+    RigidBody slab = RigidBody::createRectangle(BodyType::STATIC, {x + width * 0.125f, obstacleY + width * 0.1f}, {width * 0.1f, 4.0f});
+    slab.rotation = 0.4f;
+    world.addBody(std::move(slab));
+  }
+
+  ParticleSystem particles(1.0f);
+  particles.setJobSystem(&jobSystem);
+  particles.setWorld(&world);
+  particles.setGravity({0.0f, 100.0f});
+  particles.addBoundaryPlane({1.0f, 0.0f}, 0.0f);
+  particles.addBoundaryPlane({-1.0f, 0.0f}, -width);
+  particles.addBoundaryPlane({0.0f, -1.0f}, -floor);
+
+  std::mt19937 rng(17);
+  std::uniform_real_distribution<float> jitter(-0.2f, 0.2f);
+  particles.reserve(particleCount);
+  for (uint32_t i = 0; i < particleCount; ++i) {
+    const uint32_t row = i / columns;
+    const uint32_t column = i % columns;
+    particles.addParticle({(static_cast<float>(column) + 0.5f + jitter(rng)) * spacing,
+                           (static_cast<float>(row) + 0.5f + jitter(rng)) * spacing},
+                          {jitter(rng) * 20.0f, 0.0f});
+  }
+
+  for (uint32_t step = 0; step < warmupSteps; ++step) {
+    particles.update(1.0f / 60.0f);
+  }
+
+  double ns = 0.0;
+  double serialNs = 0.0;
+  uint64_t contacts = 0;
+  const uint64_t allocationsBefore = AllocationCounter::count();
+  for (uint32_t step = 0; step < steps; ++step) {
+    const bool serial = step % 2 == 1;
+    particles.setJobSystem(serial ? nullptr : &jobSystem);
+    Stopwatch watch;
+    particles.update(1.0f / 60.0f);
+    (serial ? serialNs : ns) += watch.elapsedNs();
+    contacts += particles.getContactCount();
+  }
+  const uint64_t allocations = AllocationCounter::count() - allocationsBefore;
+  const double parallelSteps = static_cast<double>((steps + 1) / 2);
+  const double serialSteps = static_cast<double>(steps / 2);
+
+  BenchResult result;
+  result.name = "particles_" + countLabel(particleCount);
+  result.add("particles", particleCount);
+  result.add("threads", jobSystem.getThreadCount());
+  result.add("grid_cells", static_cast<double>(particles.getCellCount()));
+  result.add("ns_per_step", ns / parallelSteps);
+  result.add("ns_per_step_serial", serialNs / serialSteps);
+  result.add("ns_per_particle", ns / parallelSteps / particleCount);
+  result.add("speedup", ns > 0.0 ? serialNs / serialSteps / (ns / parallelSteps) : 0.0);
+  result.add("contacts_per_step", static_cast<double>(contacts) / steps);
+  result.add("allocations_per_step", static_cast<double>(allocations) / steps);
+  return result;
+}
@@ -0,0 +1,71 @@
+#include "PerfCounters.hpp"
+#include "Logger/Logger.hpp"
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+CacheMissCounter::~CacheMissCounter() {
+  if (m_fd >= 0) {
+    close(m_fd);
+  }
+}
+
+bool CacheMissCounter::open() {
+  if (m_fd >= 0) return true;
+
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  if (fd < 0) {
+    WARLOG("Cache miss counter unavailable: ", std::strerror(errno));
+    return false;
+  }
+  m_fd = static_cast<int>(fd);
+  return true;
+}
+
+void CacheMissCounter::start() {
+  if (m_fd < 0) return;
+  ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+  ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+uint64_t CacheMissCounter::stop() {
+  if (m_fd < 0) return 0;
+  ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+
+  uint64_t count = 0;
+  if (read(m_fd, &count, sizeof(count)) != static_cast<ssize_t>(sizeof(count))) {
+    return 0;
+  }
+  return count;
+}
+
+#else
+
+CacheMissCounter::~CacheMissCounter() = default;
+
+bool CacheMissCounter::open() {
+  WARLOG("Cache miss counters are only supported on Linux");
+  return false;
+}
+
+void CacheMissCounter::start() {}
+
+uint64_t CacheMissCounter::stop() {
+  return 0;
+}
+
+#endif
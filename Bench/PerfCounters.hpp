@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+// Hardware cache misses of the calling thread, for --perf-counters. Only
+// Linux perf events are supported; elsewhere, or when the kernel refuses
+// (perf_event_paranoid, containers), open() fails and no misses are
+// reported. Work done on job system workers is not counted, so runs that
+// should count a whole step use --workers 0.
+class CacheMissCounter {
+public:
+  CacheMissCounter() = default;
+  ~CacheMissCounter();
+
+  CacheMissCounter(const CacheMissCounter&) = delete;
+  CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+  bool open();
+  bool isOpen() const { return m_fd >= 0; }
+  void start();
+  // Misses since the last start().
+  uint64_t stop();
+
+private:
+  int m_fd = -1;
+};
@@ -0,0 +1,292 @@
+#include "Bench.hpp"
+#include "AllocationCounter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+
+namespace {
+  constexpr float TIME_STEP = 1.0f / 60.0f;
+  constexpr uint32_t WARMUP_STEPS = 20;
+
+  void setVelocity(RigidBody& body, const glm::vec2& velocity) {
+    body.velocity = velocity;
+    body.prevPosition = body.position - velocity * TIME_STEP;
+  }
+
+  // Keeps bodies inside [0, width] horizontally and above floor.
+  void addBox(PhysicsEngine& engine, float width, float floor) {
+    engine.addBoundaryPlane({1.0f, 0.0f}, 0.0f);
+    engine.addBoundaryPlane({-1.0f, 0.0f}, -width);
+    engine.addBoundaryPlane({0.0f, -1.0f}, -floor);
+  }
+
+  class CircleRainScene : public BenchScene {
+  public:
+    CircleRainScene(const char* name, uint32_t count, uint32_t steps)
+      : m_name(name), m_count(count), m_steps(steps) {}
+
+    const char* getName() const override { return m_name; }
+    uint32_t getSteps() const override { return m_steps; }
+    bool isLarge() const override { return m_count >= 1000000; }
+    void build(PhysicsEngine& engine) override { buildCircleRain(engine, m_count); }
+
+  private:
+    const char* m_name;
+    uint32_t m_count;
+    uint32_t m_steps;
+  };
+
+  // Stacking and warm starting: a 2D pyramid of equal boxes on a static
+  // ground slab.
+  class BoxPyramidScene : public BenchScene {
+  public:
+    const char* getName() const override { return "box_pyramid"; }
+    uint32_t getSteps() const override { return 600; }
+
+    void build(PhysicsEngine& engine) override {
+      const float size = 10.0f;
+      const float groundY = 1000.0f;
+      engine.setSpatialHashCellSize(2.0f * size);
+      engine.addBody(RigidBody::createRectangle(BodyType::STATIC, {BASE * size, groundY + size}, {4.0f * BASE * size, 2.0f * size}));
+
+      for (uint32_t row = 0; row < BASE; ++row) {
+        const uint32_t count = BASE - row;
+        const float y = groundY - (static_cast<float>(row) + 0.5f) * size;
+        const float startX = BASE * size - static_cast<float>(count) * size * 0.5f;
+        for (uint32_t i = 0; i < count; ++i) {
+          RigidBody box = RigidBody::createRectangle(BodyType::DYNAMIC, {startX + (static_cast<float>(i) + 0.5f) * size, y}, {size, size});
+          box.restitution = 0.0f;
+          box.friction = 0.6f;
+          engine.addBody(std::move(box));
+        }
+      }
+    }
+
+  private:
+    static constexpr uint32_t BASE = 40;
+  };
+
+  // Radii spread over four octaves with a quarter boxes, falling onto a
+  // lattice of large static platforms. Stresses broad phases with uneven
+  // body sizes.
+  class MixedSizesScene : public BenchScene {
+  public:
+    const char* getName() const override { return "mixed_sizes"; }
+    uint32_t getSteps() const override { return 200; }
+
+    void build(PhysicsEngine& engine) override {
+      const uint32_t count = 20000;
+      const uint32_t columns = 140;
+      const float spacing = 34.0f;
+      const float width = static_cast<float>(columns) * spacing;
+      const uint32_t rows = (count + columns - 1) / columns;
+      const float floor = static_cast<float>(rows) * spacing * 1.5f;
+
+      engine.setSpatialHashCellSize(64.0f);
+      addBox(engine, width, floor);
+
+      std::mt19937 rng(7);
+      std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+      for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t row = i / columns;
+        const uint32_t column = i % columns;
+        const glm::vec2 position((static_cast<float>(column) + 0.5f) * spacing, (static_cast<float>(row) + 0.5f) * spacing);
+        const float radius = std::exp2(unit(rng) * 4.0f);
+
+        RigidBody body = (i % 4 == 0) ? RigidBody::createRectangle(BodyType::DYNAMIC, position, glm::vec2(radius * 1.6f), radius * radius)
+                                      : RigidBody::createCircle(BodyType::DYNAMIC, position, radius, radius * radius);
+        setVelocity(body, {(unit(rng) - 0.5f) * 40.0f, unit(rng) * 40.0f});
+        engine.addBody(std::move(body));
+      }
+
+      // Staggered platforms every ten rows, well below the bodies' rows.
+      const float platformWidth = 600.0f;
+      for (uint32_t level = 0; level < rows / 10; ++level) {
+        const float y = floor - static_cast<float>(level + 1) * 10.0f * spacing * 0.3f;
+        const float offset = (level % 2) ? platformWidth : 0.0f;
+        for (float x = offset; x + platformWidth <= width; x += 2.0f * platformWidth) {
+          engine.addBody(RigidBody::createRectangle(BodyType::STATIC, {x + platformWidth * 0.5f, y}, {platformWidth, 20.0f}));
+        }
+      }
+    }
+  };
+
+  // Steady-state spawning and removal: SPAWN_PER_STEP circles enter at the
+  // top every step and are removed LIFETIME steps later.
+  class ChurnSpawnerScene : public BenchScene {
+  public:
+    const char* getName() const override { return "churn_spawner"; }
+    uint32_t getSteps() const override { return 400; }
+    bool spawnsBodies() const override { return true; }
+
+    void build(PhysicsEngine& engine) override {
+      engine.setSpatialHashCellSize(8.0f);
+      addBox(engine, WIDTH, 1500.0f);
+      m_batches.assign(LIFETIME, {});
+    }
+
+    void beforeStep(PhysicsEngine& engine, uint32_t step) override {
+      std::vector<BodyHandle>& batch = m_batches[step % LIFETIME];
+      engine.removeBodies(batch);
+      batch.clear();
+
+      std::uniform_real_distribution<float> x(4.0f, WIDTH - 4.0f);
+      std::uniform_real_distribution<float> jitter(-20.0f, 20.0f);
+      m_spawned.clear();
+      for (uint32_t i = 0; i < SPAWN_PER_STEP; ++i) {
+        RigidBody body = RigidBody::createCircle(BodyType::DYNAMIC, {x(m_rng), 4.0f}, 2.0f);
+        setVelocity(body, {jitter(m_rng), 300.0f + jitter(m_rng)});
+        m_spawned.push_back(std::move(body));
+      }
+      engine.addBodies(std::move(m_spawned), &batch);
+    }
+
+  private:
+    static constexpr float WIDTH = 2000.0f;
+    static constexpr uint32_t SPAWN_PER_STEP = 128;
+    static constexpr uint32_t LIFETIME = 150;
+
+    std::vector<std::vector<BodyHandle>> m_batches;
+    std::vector<RigidBody> m_spawned;
+    std::mt19937 m_rng{11};
+  };
+}
+
+// Circles of radius 2 on a jittered grid, falling onto the floor of a box
+// twice as tall as the grid.
+void buildCircleRain(PhysicsEngine& engine, uint32_t count, bool shuffled) {
+  const float radius = 2.0f;
+  const float spacing = 5.0f;
+  const uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(count) * 2.0f)));
+  const uint32_t rows = (count + columns - 1) / columns;
+  const float width = static_cast<float>(columns) * spacing;
+  const float floor = static_cast<float>(rows) * spacing * 2.0f;
+
+  engine.setSpatialHashCellSize(4.0f * radius);
+  engine.reserveBodies(count);
+  addBox(engine, width, floor);
+
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> jitter(-0.4f, 0.4f);
+  std::uniform_real_distribution<float> speed(-10.0f, 10.0f);
+  std::vector<RigidBody> bodies;
+  bodies.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint32_t row = i / columns;
+    const uint32_t column = i % columns;
+    const glm::vec2 position((static_cast<float>(column) + 0.5f + jitter(rng)) * spacing,
+                             (static_cast<float>(row) + 0.5f + jitter(rng)) * spacing);
+
+    RigidBody body = RigidBody::createCircle(BodyType::DYNAMIC, position, radius);
+    setVelocity(body, {speed(rng), 40.0f + speed(rng)});
+    bodies.push_back(std::move(body));
+  }
+
+  if (shuffled) {
+    std::shuffle(bodies.begin(), bodies.end(), std::mt19937(13));
+  }
+  for (RigidBody& body : bodies) {
+    engine.addBody(std::move(body));
+  }
+}
+
+std::vector<std::unique_ptr<BenchScene>> createBenchScenes() {
+  std::vector<std::unique_ptr<BenchScene>> scenes;
+  scenes.push_back(std::make_unique<CircleRainScene>("circle_rain_10k", 10000, 300));
+  scenes.push_back(std::make_unique<CircleRainScene>("circle_rain_100k", 100000, 100));
+  scenes.push_back(std::make_unique<CircleRainScene>("circle_rain_1m", 1000000, 20));
+  scenes.push_back(std::make_unique<BoxPyramidScene>());
+  scenes.push_back(std::make_unique<MixedSizesScene>());
+  scenes.push_back(std::make_unique<ChurnSpawnerScene>());
+  return scenes;
+}
+
+// Contacts are counted from the step's BEGIN and PERSIST events;
+// pairs_per_second is broad phase candidate pairs per second of step time.
+// The engine's profiling counters give the per-phase breakdown.
+BenchResult runBenchScene(BenchScene& scene, const BenchOptions& options, JobSystem& jobSystem) {
+  PhysicsEngine engine;
+  engine.setBroadPhase(options.broadPhase);
+  engine.setIntegrationMethod(options.integrationMethod);
+  engine.setJobSystem(&jobSystem);
+  engine.setProfilingEnabled(true);
+  engine.setReorderInterval(options.reorderInterval);
+  scene.build(engine);
+
+  for (uint32_t step = 0; step < WARMUP_STEPS; ++step) {
+    scene.beforeStep(engine, step);
+    engine.update(TIME_STEP);
+  }
+
+  const uint32_t steps = options.steps ? options.steps : scene.getSteps();
+  double stepNs = 0.0;
+  double maxStepNs = 0.0;
+  double sceneNs = 0.0;
+  uint64_t contacts = 0;
+  uint64_t candidatePairs = 0;
+  uint64_t allocations = 0;
+  double pairSpan = 0.0;
+  uint32_t reorders = 0;
+  double phaseNs[PhysicsStats::PHASE_COUNT] = {};
+
+  for (uint32_t i = 0; i < steps; ++i) {
+    Stopwatch watch;
+    scene.beforeStep(engine, WARMUP_STEPS + i);
+    sceneNs += watch.elapsedNs();
+
+    const uint64_t allocationsBefore = AllocationCounter::count();
+    watch.restart();
+    engine.update(TIME_STEP);
+    const double ns = watch.elapsedNs();
+    allocations += AllocationCounter::count() - allocationsBefore;
+
+    stepNs += ns;
+    maxStepNs = std::max(maxStepNs, ns);
+    for (const ContactEvent& event : engine.getContactEvents()) {
+      if (event.type != ContactEventType::END) contacts++;
+    }
+
+    const PhysicsStats& stats = engine.getStats();
+    candidatePairs += stats.candidatePairs;
+    pairSpan += static_cast<double>(stats.pairSpan);
+    reorders += stats.reordered ? 1 : 0;
+    for (size_t phase = 0; phase < PhysicsStats::PHASE_COUNT; ++phase) {
+      phaseNs[phase] += static_cast<double>(stats.phaseNs[phase]);
+    }
+  }
+
+  const PhysicsStats& stats = engine.getStats();
+
+  const double stepCount = static_cast<double>(steps);
+  const double bodies = static_cast<double>(engine.getBodyCount());
+
+  BenchResult result;
+  result.name = scene.getName();
+  result.add("bodies", bodies);
+  result.add("awake_bodies", static_cast<double>(engine.getAwakeBodyCount()));
+  result.add("sleeping_bodies", static_cast<double>(stats.sleepingBodies));
+  if (options.broadPhase == BroadPhaseType::SPATIAL_HASH) {
+    result.add("cells_used", static_cast<double>(stats.cellsUsed));
+  }
+  result.add("steps", stepCount);
+  result.add("ns_per_step", stepNs / stepCount);
+  result.add("ns_per_body", stepNs / stepCount / std::max(bodies, 1.0));
+  result.add("max_ns_per_step", maxStepNs);
+  if (scene.spawnsBodies()) {
+    result.add("ns_spawn_per_step", sceneNs / stepCount);
+  }
+  for (size_t phase = 0; phase < PhysicsStats::PHASE_COUNT; ++phase) {
+    const PhysicsPhase id = static_cast<PhysicsPhase>(phase);
+    result.add(std::string("ns_") + PhysicsStats::getPhaseName(id), phaseNs[phase] / stepCount);
+  }
+  result.add("candidate_pairs_per_step", static_cast<double>(candidatePairs) / stepCount);
+  result.add("pair_span", pairSpan / stepCount);
+  if (options.reorderInterval > 0) {
+    result.add("reorders", static_cast<double>(reorders));
+  }
+  result.add("contacts_per_step", static_cast<double>(contacts) / stepCount);
+  result.add("pairs_per_second", stepNs > 0.0 ? static_cast<double>(candidatePairs) * 1e9 / stepNs : 0.0);
+  result.add("allocations_per_step", static_cast<double>(allocations) / stepCount);
+  return result;
+}
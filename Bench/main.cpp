@@ -0,0 +1,161 @@
+#include "Bench.hpp"
+#include "Physics/NarrowPhaseKernels.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Headless physics benchmarks. Runs the stress scenes and microbenchmarks,
+// writes the results as JSON and optionally compares them with a stored
+// baseline; the exit code is 1 when any compared metric regressed.
+//
+//   physim_bench [--quick] [--only <substring>] [--workers <n>] [--steps <n>]
+//                [--broadphase hash|sap|tree] [--integrator verlet|leapfrog|xpbd]
+//                [--reorder <steps>] [--perf-counters] [--out <file>]
+//                [--baseline <file>] [--tolerance <fraction>]
+namespace {
+  struct CommandLine {
+    BenchOptions options;
+    std::string only;
+    std::string outPath = "bench_results.json";
+    std::string baselinePath;
+    double tolerance = 0.1;
+  };
+
+  bool parseBroadPhase(const char* name, BroadPhaseType& type) {
+    if (std::strcmp(name, "hash") == 0) type = BroadPhaseType::SPATIAL_HASH;
+    else if (std::strcmp(name, "sap") == 0) type = BroadPhaseType::SWEEP_AND_PRUNE;
+    else if (std::strcmp(name, "tree") == 0) type = BroadPhaseType::AABB_TREE;
+    else return false;
+    return true;
+  }
+
+  bool parseIntegrator(const char* name, IntegrationMethod& method) {
+    if (std::strcmp(name, "verlet") == 0) method = IntegrationMethod::VERLET;
+    else if (std::strcmp(name, "leapfrog") == 0) method = IntegrationMethod::LEAPFROG;
+    else if (std::strcmp(name, "xpbd") == 0) method = IntegrationMethod::XPBD;
+    else return false;
+    return true;
+  }
+
+  bool parseCommandLine(int argc, char** argv, CommandLine& commandLine) {
+    for (int i = 1; i < argc; ++i) {
+      const char* arg = argv[i];
+      if (std::strcmp(arg, "--quick") == 0) {
+        commandLine.options.quick = true;
+        continue;
+      }
+      if (std::strcmp(arg, "--perf-counters") == 0) {
+        commandLine.options.perfCounters = true;
+        continue;
+      }
+      if (std::strncmp(arg, "--", 2) != 0 || i + 1 >= argc) {
+        ERRLOG("Expected an option followed by a value, got ", arg);
+        return false;
+      }
+
+      const char* value = argv[++i];
+      if (std::strcmp(arg, "--only") == 0) {
+        commandLine.only = value;
+      } else if (std::strcmp(arg, "--workers") == 0) {
+        commandLine.options.workers = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+      } else if (std::strcmp(arg, "--steps") == 0) {
+        commandLine.options.steps = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+      } else if (std::strcmp(arg, "--broadphase") == 0) {
+        if (!parseBroadPhase(value, commandLine.options.broadPhase)) {
+          ERRLOG("Unknown broad phase ", value);
+          return false;
+        }
+      } else if (std::strcmp(arg, "--integrator") == 0) {
+        if (!parseIntegrator(value, commandLine.options.integrationMethod)) {
+          ERRLOG("Unknown integrator ", value);
+          return false;
+        }
+      } else if (std::strcmp(arg, "--reorder") == 0) {
+        commandLine.options.reorderInterval = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+      } else if (std::strcmp(arg, "--out") == 0) {
+        commandLine.outPath = value;
+      } else if (std::strcmp(arg, "--baseline") == 0) {
+        commandLine.baselinePath = value;
+      } else if (std::strcmp(arg, "--tolerance") == 0) {
+        commandLine.tolerance = std::strtod(value, nullptr);
+      } else {
+        ERRLOG("Unknown option ", arg);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool selected(const CommandLine& commandLine, const std::string& name) {
+    return commandLine.only.empty() || name.find(commandLine.only) != std::string::npos;
+  }
+
+  void logResult(const BenchResult& result) {
+    std::string line = result.name;
+    for (const auto& metric : result.metrics) {
+      line += " " + metric.first + "=" + std::to_string(metric.second);
+    }
+    LOG(line);
+  }
+}
+
+int main(int argc, char** argv) {
+  CommandLine commandLine;
+  if (!parseCommandLine(argc, argv, commandLine)) {
+    return 2;
+  }
+
+  JobSystem jobSystem(commandLine.options.workers);
+
+  BenchReport report;
+  report.kernel = getNarrowPhaseKernelName();
+  report.threads = jobSystem.getThreadCount();
+
+  auto record = [&](BenchResult&& result) {
+    logResult(result);
+    report.results.push_back(std::move(result));
+  };
+
+  for (auto& scene : createBenchScenes()) {
+    if (commandLine.options.quick && scene->isLarge()) continue;
+    if (!selected(commandLine, scene->getName())) continue;
+    record(runBenchScene(*scene, commandLine.options, jobSystem));
+  }
+
+  for (uint32_t count : {10000u, 100000u, 1000000u}) {
+    if (commandLine.options.quick && count >= 1000000u) continue;
+    if (!selected(commandLine, "spatial_hash")) break;
+    record(benchSpatialHash(count));
+  }
+  if (selected(commandLine, "job_overhead")) record(benchJobOverhead(jobSystem));
+  if (selected(commandLine, "circle_kernel")) record(benchCircleKernel());
+  if (selected(commandLine, "raycast")) record(benchRaycast(jobSystem));
+  if (selected(commandLine, "snapshot")) record(benchSnapshot(commandLine.options, jobSystem));
+  if (selected(commandLine, "body_reorder")) record(benchBodyReorder(commandLine.options, jobSystem));
+  for (uint32_t count : {100000u, 1000000u}) {
+    if (commandLine.options.quick && count >= 1000000u) continue;
+    if (!selected(commandLine, "particles")) break;
+    record(benchParticles(count, jobSystem));
+  }
+
+  if (!writeBenchReport(commandLine.outPath, report)) {
+    return 2;
+  }
+  LOG("Wrote ", report.results.size(), " results to ", commandLine.outPath);
+
+  if (!commandLine.baselinePath.empty()) {
+    BenchReport baseline;
+    if (!readBenchReport(commandLine.baselinePath, baseline)) {
+      return 2;
+    }
+
+    size_t regressions = compareBenchReports(report, baseline, commandLine.tolerance);
+    if (regressions > 0) {
+      ERRLOG(regressions, " metrics regressed by more than ", commandLine.tolerance * 100.0, "%");
+      return 1;
+    }
+    LOG("No regressions against ", commandLine.baselinePath);
+  }
+
+  return 0;
+}
@@ -0,0 +1,114 @@
+#include "Tests.hpp"
+#include "Physics/SweepAndPrune.hpp"
+#include "Physics/AABBTreeBroadPhase.hpp"
+#include "Physics/SpatialHash.hpp"
+
+namespace {
+  AABB boxAt(float x, float y) {
+    return AABB(glm::vec2(x - 1.0f, y - 1.0f), glm::vec2(x + 1.0f, y + 1.0f));
+  }
+
+  bool contains(const std::vector<BodyPair>& pairs, const BodyPair& pair) {
+    for (const BodyPair& entry : pairs) {
+      if (entry == pair) return true;
+    }
+    return false;
+  }
+
+  // Two bodies start apart, move into overlap and back out; each crossing
+  // is reported exactly once, as one begin and then one end.
+  void checkPairDeltas(BroadPhase& broadPhase) {
+    const CollisionFilter filter;
+    std::vector<BodyPair> pairs;
+    std::vector<BodyPair> begun;
+    std::vector<BodyPair> ended;
+
+    broadPhase.update(0, boxAt(0.0f, 0.0f), false, filter);
+    broadPhase.update(1, boxAt(500.0f, 0.0f), false, filter);
+    broadPhase.flush();
+    broadPhase.computePairs(pairs);
+    CHECK(broadPhase.getPairDeltas(begun, ended));
+    CHECK(pairs.empty());
+    CHECK(begun.empty());
+    CHECK(ended.empty());
+
+    broadPhase.update(1, boxAt(1.5f, 0.5f), false, filter);
+    broadPhase.flush();
+    broadPhase.computePairs(pairs);
+    broadPhase.getPairDeltas(begun, ended);
+    CHECK(pairs.size() == 1);
+    CHECK(begun.size() == 1 && contains(begun, BodyPair(0, 1)));
+    CHECK(ended.empty());
+
+    // Nothing moved, so nothing begins or ends.
+    broadPhase.flush();
+    broadPhase.computePairs(pairs);
+    broadPhase.getPairDeltas(begun, ended);
+    CHECK(pairs.size() == 1);
+    CHECK(begun.empty());
+    CHECK(ended.empty());
+
+    broadPhase.update(1, boxAt(500.0f, 0.0f), false, filter);
+    broadPhase.flush();
+    broadPhase.computePairs(pairs);
+    broadPhase.getPairDeltas(begun, ended);
+    CHECK(pairs.empty());
+    CHECK(begun.empty());
+    CHECK(ended.size() == 1 && contains(ended, BodyPair(0, 1)));
+  }
+
+  // Four far apart bodies from index 1 on are permuted; each is then found
+  // under its new index, and body 0 in front of the range keeps its own.
+  void checkPermuteBodies(BroadPhase& broadPhase) {
+    const CollisionFilter filter;
+    const float xs[5] = {0.0f, 1000.0f, 2000.0f, 3000.0f, 4000.0f};
+    for (uint32_t body = 0; body < 5; ++body) {
+      broadPhase.update(body, boxAt(xs[body], 0.0f), false, filter);
+    }
+    broadPhase.flush();
+
+    const std::vector<uint32_t> order = {2, 0, 3, 1};
+    broadPhase.permuteBodies(1, order);
+
+    std::vector<uint32_t> result;
+    broadPhase.query(boxAt(xs[0], 0.0f), result);
+    CHECK(result.size() == 1 && result[0] == 0);
+    for (uint32_t k = 0; k < order.size(); ++k) {
+      broadPhase.query(boxAt(xs[1 + order[k]], 0.0f), result);
+      CHECK(result.size() == 1 && result[0] == 1 + k);
+    }
+  }
+}
+
+TEST(sweepAndPrunePairDeltas) {
+  SweepAndPrune broadPhase;
+  checkPairDeltas(broadPhase);
+}
+
+TEST(aabbTreePairDeltas) {
+  AABBTreeBroadPhase broadPhase;
+  checkPairDeltas(broadPhase);
+}
+
+TEST(spatialHashHasNoPairDeltas) {
+  SpatialHash broadPhase;
+  std::vector<BodyPair> begun(1);
+  std::vector<BodyPair> ended(1);
+  CHECK(!broadPhase.getPairDeltas(begun, ended));
+  CHECK(begun.empty() && ended.empty());
+}
+
+TEST(sweepAndPrunePermuteBodies) {
+  SweepAndPrune broadPhase;
+  checkPermuteBodies(broadPhase);
+}
+
+TEST(aabbTreePermuteBodies) {
+  AABBTreeBroadPhase broadPhase;
+  checkPermuteBodies(broadPhase);
+}
+
+TEST(spatialHashPermuteBodies) {
+  SpatialHash broadPhase;
+  checkPermuteBodies(broadPhase);
+}
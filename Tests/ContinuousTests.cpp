@@ -0,0 +1,49 @@
+#include "Tests.hpp"
+#include "Physics/Physics.hpp"
+
+namespace {
+  // A bullet flies along +x while a circle crosses its path along -y. Both
+  // are clear of each other at the start and the end of the step, so only a
+  // sweep against the moving target catches the hit halfway through.
+  void checkBulletHitsMovingCircle(BroadPhaseType broadPhaseType) {
+    const float dt = 1.0f / 60.0f;
+    PhysicsEngine engine;
+    engine.setBroadPhase(broadPhaseType);
+    engine.setGravity(glm::vec2(0.0f));
+
+    RigidBody bullet = RigidBody::createCircle(BodyType::DYNAMIC, glm::vec2(0.0f, 0.0f), 2.0f);
+    bullet.bullet = true;
+    bullet.velocity = glm::vec2(3000.0f, 0.0f);
+    bullet.prevPosition = bullet.position - bullet.velocity * dt;
+    BodyHandle bulletHandle = engine.addBody(std::move(bullet));
+
+    RigidBody target = RigidBody::createCircle(BodyType::DYNAMIC, glm::vec2(25.0f, 25.0f), 5.0f);
+    target.velocity = glm::vec2(0.0f, -3000.0f);
+    target.prevPosition = target.position - target.velocity * dt;
+    BodyHandle targetHandle = engine.addBody(std::move(target));
+
+    engine.update(dt);
+
+    bool touched = false;
+    for (const ContactEvent& event : engine.getContactEvents()) {
+      bool pair = (event.bodyA == bulletHandle && event.bodyB == targetHandle) ||
+                  (event.bodyA == targetHandle && event.bodyB == bulletHandle);
+      touched |= pair && event.type == ContactEventType::BEGIN;
+    }
+    CHECK(touched);
+    CHECK(engine.getBody(bulletHandle).velocity().y < 0.0f);
+    CHECK(engine.getBody(targetHandle).velocity().x > 0.0f);
+  }
+}
+
+TEST(bulletHitsMovingCircleSpatialHash) {
+  checkBulletHitsMovingCircle(BroadPhaseType::SPATIAL_HASH);
+}
+
+TEST(bulletHitsMovingCircleSweepAndPrune) {
+  checkBulletHitsMovingCircle(BroadPhaseType::SWEEP_AND_PRUNE);
+}
+
+TEST(bulletHitsMovingCircleAABBTree) {
+  checkBulletHitsMovingCircle(BroadPhaseType::AABB_TREE);
+}
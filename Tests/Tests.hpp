@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Core/common.hpp"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Headless physics tests. Each test registers itself with TEST() and
+// reports failures through CHECK(); physim_tests runs them all and exits
+// with 1 when any check failed.
+struct TestCase {
+  const char* name;
+  std::function<void()> run;
+};
+
+std::vector<TestCase>& testRegistry();
+void reportCheckFailure(const char* file, int line, const char* expression);
+
+struct TestRegistrar {
+  TestRegistrar(const char* name, std::function<void()> run) {
+    testRegistry().push_back({name, std::move(run)});
+  }
+};
+
+#define TEST_CONCAT_INNER(a, b) a##b
+#define TEST_CONCAT(a, b) TEST_CONCAT_INNER(a, b)
+
+#define TEST(name) \
+  static void name(); \
+  static TestRegistrar TEST_CONCAT(g_register_, name)(#name, name); \
+  static void name()
+
+#define CHECK(expression) \
+  do { \
+    if (!(expression)) reportCheckFailure(__FILE__, __LINE__, #expression); \
+  } while (false)
@@ -0,0 +1,41 @@
+#include "Tests.hpp"
+#include <cstring>
+
+// Runs every registered test, or those whose name contains the first
+// argument.
+//
+//   physim_tests [<substring>]
+namespace {
+  uint32_t g_failures = 0;
+}
+
+std::vector<TestCase>& testRegistry() {
+  static std::vector<TestCase> registry;
+  return registry;
+}
+
+void reportCheckFailure(const char* file, int line, const char* expression) {
+  ERRLOG(file, ":", line, " check failed: ", expression);
+  g_failures++;
+}
+
+int main(int argc, char** argv) {
+  const char* only = argc > 1 ? argv[1] : nullptr;
+
+  uint32_t failedTests = 0;
+  uint32_t ranTests = 0;
+  for (const TestCase& test : testRegistry()) {
+    if (only && !std::strstr(test.name, only)) continue;
+
+    const uint32_t failuresBefore = g_failures;
+    test.run();
+    ranTests++;
+    if (g_failures != failuresBefore) {
+      ERRLOG(test.name, " failed");
+      failedTests++;
+    }
+  }
+
+  LOG(ranTests - failedTests, " of ", ranTests, " tests passed");
+  return failedTests == 0 ? 0 : 1;
+}
@@ -24,6 +24,28 @@ public:
     return nullptr;
   }
 
+  JobSystem* getJobSystem() {
+    if(m_coreEngine) {
+      return m_coreEngine->getJobSystem();
+    }
+    return nullptr;
+  }
+
+  PhysicsEngine* getPhysicsEngine() {
+    if(m_coreEngine) {
+      return m_coreEngine->getPhysicsEngine();
+    }
+    return nullptr;
+  }
+
+  // Loop settings, defaults before init().
+  GameLoopData getGameLoopData() const {
+    if(m_coreEngine) {
+      return m_coreEngine->getGameLoopData();
+    }
+    return GameLoopData();
+  }
+
   WindowData getWindowSize() const;
 
 private:
@@ -0,0 +1,211 @@
+#include "AABBTreeBroadPhase.hpp"
+#include <algorithm>
+
+AABBTreeBroadPhase::AABBTreeBroadPhase(float margin)
+  : m_dynamicTree(margin), m_staticTree(margin) {}
+
+uint32_t AABBTreeBroadPhase::createProxy(uint32_t body, const AABB& aabb, bool isStatic, const CollisionFilter& filter) {
+  uint32_t proxy;
+  if (!m_freeProxies.empty()) {
+    proxy = m_freeProxies.back();
+    m_freeProxies.pop_back();
+  } else {
+    proxy = static_cast<uint32_t>(m_proxies.size());
+    m_proxies.emplace_back();
+  }
+
+  Proxy& entry = m_proxies[proxy];
+  entry.body = body;
+  entry.isStatic = isStatic;
+  entry.moved = false;
+  entry.filter = filter;
+  entry.node = treeFor(entry).createProxy(aabb, proxy);
+
+  markMoved(proxy);
+  return proxy;
+}
+
+void AABBTreeBroadPhase::destroyProxy(uint32_t proxy) {
+  Proxy& entry = m_proxies[proxy];
+  treeFor(entry).destroyProxy(entry.node);
+
+  entry.node = DynamicTree::NULL_NODE;
+  entry.body = INVALID;
+  m_releasedProxies.push_back(proxy);
+}
+
+void AABBTreeBroadPhase::markMoved(uint32_t proxy) {
+  if (!m_proxies[proxy].moved) {
+    m_proxies[proxy].moved = true;
+    m_moveBuffer.push_back(proxy);
+  }
+}
+
+void AABBTreeBroadPhase::update(uint32_t body, const AABB& aabb, bool isStatic, const CollisionFilter& filter) {
+  if (body >= m_bodyToProxy.size()) {
+    m_bodyToProxy.resize(static_cast<size_t>(body) + 1, INVALID);
+  }
+
+  uint32_t proxy = m_bodyToProxy[body];
+  if (proxy != INVALID && (m_proxies[proxy].isStatic != isStatic || m_proxies[proxy].filter != filter)) {
+    destroyProxy(proxy);
+    proxy = INVALID;
+  }
+
+  if (proxy == INVALID) {
+    m_bodyToProxy[body] = createProxy(body, aabb, isStatic, filter);
+    return;
+  }
+
+  Proxy& entry = m_proxies[proxy];
+  if (treeFor(entry).moveProxy(entry.node, aabb)) {
+    markMoved(proxy);
+  }
+}
+
+void AABBTreeBroadPhase::remove(uint32_t body) {
+  if (body >= m_bodyToProxy.size() || m_bodyToProxy[body] == INVALID) return;
+
+  destroyProxy(m_bodyToProxy[body]);
+  m_bodyToProxy[body] = INVALID;
+}
+
+void AABBTreeBroadPhase::swapBodies(uint32_t a, uint32_t b) {
+  if (a == b) return;
+
+  size_t required = static_cast<size_t>(std::max(a, b)) + 1;
+  if (m_bodyToProxy.size() < required) {
+    m_bodyToProxy.resize(required, INVALID);
+  }
+
+  std::swap(m_bodyToProxy[a], m_bodyToProxy[b]);
+  if (m_bodyToProxy[a] != INVALID) m_proxies[m_bodyToProxy[a]].body = a;
+  if (m_bodyToProxy[b] != INVALID) m_proxies[m_bodyToProxy[b]].body = b;
+}
+
+void AABBTreeBroadPhase::permuteBodies(uint32_t begin, const std::vector<uint32_t>& order) {
+  const size_t count = order.size();
+  if (m_bodyToProxy.size() < begin + count) {
+    m_bodyToProxy.resize(begin + count, INVALID);
+  }
+
+  m_permutedProxies.resize(count);
+  for (size_t k = 0; k < count; ++k) {
+    m_permutedProxies[k] = m_bodyToProxy[begin + order[k]];
+  }
+  for (size_t k = 0; k < count; ++k) {
+    const uint32_t proxy = m_permutedProxies[k];
+    m_bodyToProxy[begin + k] = proxy;
+    if (proxy != INVALID) m_proxies[proxy].body = static_cast<uint32_t>(begin + k);
+  }
+}
+
+void AABBTreeBroadPhase::clear() {
+  m_dynamicTree.clear();
+  m_staticTree.clear();
+  m_proxies.clear();
+  m_freeProxies.clear();
+  m_releasedProxies.clear();
+  m_bodyToProxy.clear();
+  m_moveBuffer.clear();
+  m_pairs.clear();
+}
+
+void AABBTreeBroadPhase::query(const AABB& aabb, std::vector<uint32_t>& result) {
+  result.clear();
+
+  auto collect = [this, &aabb, &result](const DynamicTree& tree) {
+    tree.query(aabb, [this, &tree, &result](uint32_t node) {
+      result.push_back(m_proxies[tree.getUserData(node)].body);
+      return true;
+    });
+  };
+
+  collect(m_dynamicTree);
+  collect(m_staticTree);
+}
+
+void AABBTreeBroadPhase::queryAABB(const AABB& aabb, QueryCallback& callback) const {
+  bool running = true;
+  auto visit = [this, &callback, &running](const DynamicTree& tree, uint32_t node) {
+    running = callback.reportBody(m_proxies[tree.getUserData(node)].body);
+    return running;
+  };
+
+  m_dynamicTree.query(aabb, [&](uint32_t node) { return visit(m_dynamicTree, node); });
+  if (running) {
+    m_staticTree.query(aabb, [&](uint32_t node) { return visit(m_staticTree, node); });
+  }
+}
+
+// The static tree continues with the fraction the dynamic tree left, so a
+// hit on a moving body already prunes the static one.
+void AABBTreeBroadPhase::rayCast(const glm::vec2& from, const glm::vec2& to, RayCastCallback& callback) const {
+  float maxFraction = m_dynamicTree.rayCast(from, to, 1.0f, [this, &callback](uint32_t node) {
+    return callback.reportBody(m_proxies[m_dynamicTree.getUserData(node)].body);
+  });
+
+  m_staticTree.rayCast(from, to, maxFraction, [this, &callback](uint32_t node) {
+    return callback.reportBody(m_proxies[m_staticTree.getUserData(node)].body);
+  });
+}
+
+void AABBTreeBroadPhase::computePairs(std::vector<BodyPair>& pairs) {
+  m_pairs.resetDeltas();
+
+  if (!m_moveBuffer.empty() || !m_releasedProxies.empty()) {
+    m_stalePairs.clear();
+    m_pairs.forEachPair([this](uint32_t proxyA, uint32_t proxyB) {
+      const Proxy& a = m_proxies[proxyA];
+      const Proxy& b = m_proxies[proxyB];
+      if (!a.moved && !b.moved && a.node != DynamicTree::NULL_NODE && b.node != DynamicTree::NULL_NODE) {
+        return;
+      }
+
+      if (a.node == DynamicTree::NULL_NODE || b.node == DynamicTree::NULL_NODE ||
+          !fatAABB(a).overlaps(fatAABB(b))) {
+        m_stalePairs.emplace_back(proxyA, proxyB);
+      }
+    });
+
+    for (const BodyPair& stale : m_stalePairs) {
+      m_pairs.removePair(stale.a, stale.b);
+    }
+
+    for (uint32_t proxy : m_moveBuffer) {
+      Proxy& entry = m_proxies[proxy];
+      entry.moved = false;
+      if (entry.node == DynamicTree::NULL_NODE) continue;
+
+      const AABB& fat = fatAABB(entry);
+      auto addOverlaps = [this, proxy, &entry](uint32_t node, const DynamicTree& tree) {
+        uint32_t other = tree.getUserData(node);
+        if (other != proxy && entry.filter.shouldCollide(m_proxies[other].filter)) {
+          m_pairs.addPair(proxy, other);
+        }
+        return true;
+      };
+
+      m_dynamicTree.query(fat, [&](uint32_t node) { return addOverlaps(node, m_dynamicTree); });
+      if (!entry.isStatic) {
+        m_staticTree.query(fat, [&](uint32_t node) { return addOverlaps(node, m_staticTree); });
+      }
+    }
+    m_moveBuffer.clear();
+  }
+
+  m_pairs.finalize([this](uint32_t proxy) { return m_proxies[proxy].body; });
+  m_freeProxies.insert(m_freeProxies.end(), m_releasedProxies.begin(), m_releasedProxies.end());
+  m_releasedProxies.clear();
+
+  pairs.clear();
+  m_pairs.forEachPair([this, &pairs](uint32_t proxyA, uint32_t proxyB) {
+    pairs.emplace_back(m_proxies[proxyA].body, m_proxies[proxyB].body);
+  });
+}
+
+bool AABBTreeBroadPhase::getPairDeltas(std::vector<BodyPair>& begun, std::vector<BodyPair>& ended) const {
+  begun = m_pairs.getBegunPairs();
+  ended = m_pairs.getEndedPairs();
+  return true;
+}
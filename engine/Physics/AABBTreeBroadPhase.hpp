@@ -0,0 +1,70 @@
+#pragma once
+
+#include "BroadPhase.hpp"
+#include "DynamicTree.hpp"
+#include "PairManager.hpp"
+#include <vector>
+
+// Broad phase over two dynamic AABB trees: one for moving bodies and one
+// for static bodies. A body that stays inside its fat AABB is not touched
+// at all, and the static tree only changes when static bodies are added or
+// removed. New pairs are found by querying the leaves that were
+// re-inserted since the last step; pairs involving them are re-validated
+// against the fat AABBs.
+class AABBTreeBroadPhase : public BroadPhase {
+public:
+  explicit AABBTreeBroadPhase(float margin = 4.0f);
+  ~AABBTreeBroadPhase() override = default;
+
+  BroadPhaseType getType() const override { return BroadPhaseType::AABB_TREE; }
+
+  void update(uint32_t body, const AABB& aabb, bool isStatic, const CollisionFilter& filter) override;
+  void remove(uint32_t body) override;
+  void swapBodies(uint32_t a, uint32_t b) override;
+  void permuteBodies(uint32_t begin, const std::vector<uint32_t>& order) override;
+  void clear() override;
+
+  void query(const AABB& aabb, std::vector<uint32_t>& result) override;
+  void computePairs(std::vector<BodyPair>& pairs) override;
+
+  void queryAABB(const AABB& aabb, QueryCallback& callback) const override;
+  void rayCast(const glm::vec2& from, const glm::vec2& to, RayCastCallback& callback) const override;
+
+  bool getPairDeltas(std::vector<BodyPair>& begun, std::vector<BodyPair>& ended) const override;
+
+  const DynamicTree& getDynamicTree() const { return m_dynamicTree; }
+  const DynamicTree& getStaticTree() const { return m_staticTree; }
+
+private:
+  static constexpr uint32_t INVALID = 0xFFFFFFFFu;
+
+  struct Proxy {
+    uint32_t body = INVALID;
+    uint32_t node = DynamicTree::NULL_NODE;
+    bool isStatic = false;
+    bool moved = false;
+    CollisionFilter filter;
+  };
+
+  DynamicTree m_dynamicTree;
+  DynamicTree m_staticTree;
+
+  std::vector<Proxy> m_proxies;
+  std::vector<uint32_t> m_freeProxies;
+  std::vector<uint32_t> m_releasedProxies;
+  std::vector<uint32_t> m_bodyToProxy;
+  std::vector<uint32_t> m_permutedProxies;
+  std::vector<uint32_t> m_moveBuffer;
+  std::vector<BodyPair> m_stalePairs;
+
+  PairManager m_pairs;
+
+  DynamicTree& treeFor(const Proxy& proxy) { return proxy.isStatic ? m_staticTree : m_dynamicTree; }
+  const AABB& fatAABB(const Proxy& proxy) const {
+    return proxy.isStatic ? m_staticTree.getFatAABB(proxy.node) : m_dynamicTree.getFatAABB(proxy.node);
+  }
+
+  uint32_t createProxy(uint32_t body, const AABB& aabb, bool isStatic, const CollisionFilter& filter);
+  void destroyProxy(uint32_t proxy);
+  void markMoved(uint32_t proxy);
+};
@@ -0,0 +1,315 @@
+#include "BodyStorage.hpp"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+void BodyStorage::reserve(size_t count) {
+  forEachArray([count](auto& array) { array.reserve(count); });
+}
+
+void BodyStorage::clear() {
+  forEachArray([](auto& array) { array.clear(); });
+  m_slots.clear();
+  m_freeHead = BodyHandle::INVALID_INDEX;
+  m_staticBegin = 0;
+  m_activeEnd = 0;
+  m_partitionDirty = false;
+  m_layoutVersion++;
+  wokenBodies.clear();
+}
+
+BodyHandle BodyStorage::add(RigidBody&& body) {
+  ShapeType shapeType = body.shape ? body.shape->getType() : ShapeType::CIRCLE;
+  glm::vec2 extent = body.getShapeExtent();
+  uint32_t dense = static_cast<uint32_t>(positions.size());
+
+  uint32_t slot;
+  if (m_freeHead != BodyHandle::INVALID_INDEX) {
+    slot = m_freeHead;
+    m_freeHead = m_slots[slot].nextFree;
+  } else {
+    slot = static_cast<uint32_t>(m_slots.size());
+    m_slots.emplace_back();
+  }
+  m_slots[slot].dense = dense;
+  m_slots[slot].nextFree = BodyHandle::INVALID_INDEX;
+
+  positions.push_back(body.position);
+  prevPositions.push_back(body.prevPosition);
+  velocities.push_back(body.velocity);
+  forces.push_back(body.forceAccumulator);
+  invMasses.push_back(body.invMass);
+  aabbs.push_back(computeAABB(shapeType, extent, body.position, body.rotation));
+
+  rotations.push_back(body.rotation);
+  angularVelocities.push_back(body.angularVelocity);
+  torques.push_back(body.torqueAccumulator);
+  invInertias.push_back(body.invInertia);
+  types.push_back(body.type);
+  active.push_back(body.active ? 1 : 0);
+  awake.push_back(1);
+  bullets.push_back(body.bullet ? 1 : 0);
+  filters.push_back(body.filter);
+  sleepTimes.push_back(0.0f);
+  shapeTypes.push_back(shapeType);
+  shapeExtents.push_back(extent);
+  stepStartPositions.push_back(body.position);
+  stepStartRotations.push_back(body.rotation);
+
+  BodyColdData coldData;
+  coldData.id = std::move(body.id);
+  coldData.restitution = body.restitution;
+  coldData.friction = body.friction;
+  coldData.mass = body.mass;
+  coldData.inertia = body.inertia;
+  coldData.userData = body.userData;
+  cold.push_back(std::move(coldData));
+  denseToSlot.push_back(slot);
+  sleepIslands.push_back(BodyHandle::INVALID_INDEX);
+  m_layoutVersion++;
+
+  if (body.type != BodyType::STATIC) {
+    swap(dense, m_staticBegin);
+    dense = static_cast<uint32_t>(m_staticBegin++);
+
+    if (body.active) {
+      swap(dense, m_activeEnd);
+      m_activeEnd++;
+    }
+  }
+
+  return BodyHandle{slot, m_slots[slot].generation};
+}
+
+bool BodyStorage::remove(BodyHandle handle) {
+  if (!contains(handle)) return false;
+
+  Slot& slot = m_slots[handle.index];
+  size_t dense = slot.dense;
+  size_t last = positions.size() - 1;
+
+  if (dense < m_activeEnd) {
+    size_t lastActive = m_activeEnd - 1;
+    swap(dense, lastActive);
+    dense = lastActive;
+    m_activeEnd--;
+  }
+
+  if (dense < m_staticBegin) {
+    size_t lastDynamic = m_staticBegin - 1;
+    swap(dense, lastDynamic);
+    dense = lastDynamic;
+    m_staticBegin--;
+  }
+  swap(dense, last);
+
+  forEachArray([](auto& array) { array.pop_back(); });
+
+  slot.dense = BodyHandle::INVALID_INDEX;
+  slot.generation++;
+  slot.nextFree = m_freeHead;
+  m_freeHead = handle.index;
+  m_layoutVersion++;
+
+  return true;
+}
+
+void BodyStorage::swap(size_t a, size_t b) {
+  if (a == b) return;
+
+  forEachArray([a, b](auto& array) {
+    using std::swap;
+    swap(array[a], array[b]);
+  });
+
+  m_slots[denseToSlot[a]].dense = static_cast<uint32_t>(a);
+  m_slots[denseToSlot[b]].dense = static_cast<uint32_t>(b);
+
+  if (onSwap) {
+    onSwap(static_cast<uint32_t>(a), static_cast<uint32_t>(b));
+  }
+}
+
+void BodyStorage::setActive(size_t index, bool isActive) {
+  if ((active[index] != 0) == isActive) return;
+
+  active[index] = isActive ? 1 : 0;
+  if (!isActive) {
+    syncStepStart(index);
+  }
+  if (types[index] != BodyType::STATIC) {
+    m_partitionDirty = true;
+  }
+}
+
+void BodyStorage::setAwake(size_t index, bool isAwake) {
+  if (types[index] == BodyType::STATIC) return;
+
+  sleepTimes[index] = 0.0f;
+  if ((awake[index] != 0) == isAwake) return;
+
+  awake[index] = isAwake ? 1 : 0;
+  m_partitionDirty = true;
+  if (isAwake) {
+    wokenBodies.push_back(handleAt(index));
+  } else {
+    syncStepStart(index);
+  }
+}
+
+bool BodyStorage::partitionActive() {
+  if (!m_partitionDirty) return false;
+
+  size_t end = 0;
+  for (size_t i = 0; i < m_staticBegin; ++i) {
+    if (active[i] && awake[i]) {
+      swap(i, end);
+      end++;
+    }
+  }
+
+  m_activeEnd = end;
+  m_partitionDirty = false;
+  return true;
+}
+
+// Plain arrays are gathered through one byte buffer shared by all of them;
+// cold data holds strings and is moved through its own buffer.
+template<typename T>
+void BodyStorage::gather(std::vector<T>& array, size_t begin, const std::vector<uint32_t>& order) {
+  const size_t count = order.size();
+  if constexpr (std::is_trivially_copyable_v<T>) {
+    m_reorderScratch.resize(count * sizeof(T));
+    unsigned char* scratch = m_reorderScratch.data();
+    for (size_t k = 0; k < count; ++k) {
+      std::memcpy(scratch + k * sizeof(T), &array[begin + order[k]], sizeof(T));
+    }
+    std::memcpy(array.data() + begin, scratch, count * sizeof(T));
+  } else {
+    static_assert(std::is_same_v<T, BodyColdData>, "only cold data needs moving");
+    m_coldScratch.resize(count);
+    for (size_t k = 0; k < count; ++k) {
+      m_coldScratch[k] = std::move(array[begin + order[k]]);
+    }
+    std::move(m_coldScratch.begin(), m_coldScratch.end(), array.begin() + static_cast<std::ptrdiff_t>(begin));
+  }
+}
+
+// One sequential gather per array instead of a swap of every array per
+// moved body, then the slot map and onPermute owners are updated once.
+void BodyStorage::reorder(size_t begin, const std::vector<uint32_t>& order) {
+  if (order.empty()) return;
+
+  forEachArray([this, begin, &order](auto& array) {
+    gather(array, begin, order);
+  });
+
+  for (size_t i = begin; i < begin + order.size(); ++i) {
+    m_slots[denseToSlot[i]].dense = static_cast<uint32_t>(i);
+  }
+
+  if (onPermute) {
+    onPermute(static_cast<uint32_t>(begin), order);
+  }
+}
+
+void BodyStorage::saveState(SnapshotWriter& writer) const {
+  const size_t count = m_staticBegin;
+
+  writer.write(m_layoutVersion);
+  writer.write(static_cast<uint32_t>(size()));
+  writer.write(static_cast<uint32_t>(m_staticBegin));
+  writer.write(static_cast<uint32_t>(m_activeEnd));
+  writer.write(static_cast<uint8_t>(m_partitionDirty ? 1 : 0));
+
+  writer.writeArray(denseToSlot.data(), count);
+  forEachStateArray(*this, [&writer, count](const auto& array) {
+    writer.writeArray(array.data(), count);
+  });
+
+  writer.write(static_cast<uint32_t>(wokenBodies.size()));
+  writer.writeArray(wokenBodies.data(), wokenBodies.size());
+}
+
+bool BodyStorage::checkState(SnapshotReader& reader) {
+  uint32_t layoutVersion = 0;
+  uint32_t bodyCount = 0;
+  uint32_t staticBegin = 0;
+  uint32_t activeEnd = 0;
+  uint8_t partitionDirty = 0;
+  reader.read(layoutVersion);
+  reader.read(bodyCount);
+  reader.read(staticBegin);
+  reader.read(activeEnd);
+  if (!reader.read(partitionDirty)) return false;
+
+  if (layoutVersion != m_layoutVersion || bodyCount != size() || staticBegin != m_staticBegin ||
+      activeEnd > staticBegin) {
+    return false;
+  }
+  const size_t count = m_staticBegin;
+
+  // The saved order must be a permutation of the current dynamic bodies.
+  // Usually nothing has slept or woken since, and it is the current one.
+  m_restoreSlots.resize(count);
+  if (!reader.readArray(m_restoreSlots.data(), count)) return false;
+  m_restoreReordered = !std::equal(m_restoreSlots.begin(), m_restoreSlots.end(), denseToSlot.begin());
+  if (m_restoreReordered) {
+    m_restoreSeen.assign(count, 0);
+    for (uint32_t slot : m_restoreSlots) {
+      if (slot >= m_slots.size()) return false;
+      const uint32_t dense = m_slots[slot].dense;
+      if (dense >= count || m_restoreSeen[dense]) return false;
+      m_restoreSeen[dense] = 1;
+    }
+  }
+
+  bool fits = true;
+  forEachStateArray(*this, [&reader, &fits, count](auto& array) {
+    using Value = typename std::decay_t<decltype(array)>::value_type;
+    fits = fits && reader.skipArray<Value>(count);
+  });
+
+  uint32_t wokenCount = 0;
+  return fits && reader.read(wokenCount) && reader.skipArray<BodyHandle>(wokenCount);
+}
+
+void BodyStorage::restoreState(SnapshotReader& reader) {
+  uint32_t layoutVersion = 0;
+  uint32_t bodyCount = 0;
+  uint32_t staticBegin = 0;
+  uint32_t activeEnd = 0;
+  uint8_t partitionDirty = 0;
+  reader.read(layoutVersion);
+  reader.read(bodyCount);
+  reader.read(staticBegin);
+  reader.read(activeEnd);
+  reader.read(partitionDirty);
+  const size_t count = m_staticBegin;
+
+  // Same bodies, but sleeping and waking may have reordered the dynamic
+  // range since. Swap every body back to its saved dense index; once index
+  // i is settled it is never touched again, so one pass is enough.
+  reader.skipArray<uint32_t>(count);
+  if (m_restoreReordered) {
+    for (size_t i = 0; i < count; ++i) {
+      swap(i, m_slots[m_restoreSlots[i]].dense);
+    }
+  }
+
+  forEachStateArray(*this, [&reader, count](auto& array) {
+    reader.readArray(array.data(), count);
+  });
+  // A rollback is a jump; nothing to interpolate from.
+  std::copy_n(positions.begin(), count, stepStartPositions.begin());
+  std::copy_n(rotations.begin(), count, stepStartRotations.begin());
+
+  uint32_t wokenCount = 0;
+  reader.read(wokenCount);
+  wokenBodies.resize(wokenCount);
+  reader.readArray(wokenBodies.data(), wokenCount);
+
+  m_activeEnd = activeEnd;
+  m_partitionDirty = partitionDirty != 0;
+}
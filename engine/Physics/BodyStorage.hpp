@@ -0,0 +1,302 @@
+#pragma once
+
+#include "body.hpp"
+#include "Snapshot.hpp"
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+
+struct BodyColdData {
+  std::string id;
+  float restitution = 0.5f;
+  float friction = 0.2f;
+  float mass = 1.0f;
+  float inertia = 1.0f;
+  void* userData = nullptr;
+};
+
+// Structure-of-arrays body store. The arrays the integrator, AABB update and
+// broad phase stream every step are kept separate and contiguous; everything
+// that is only read on contact or by game code lives in `cold`.
+//
+// Dense arrays are addressed by a dense index that changes when bodies are
+// removed (swap-and-pop). BodyHandles go through a generational slot map and
+// stay stable for the lifetime of the body.
+//
+// The dense range is partitioned into simulated dynamic bodies
+// [0, activeCount()), inactive or sleeping dynamic bodies
+// [activeCount(), staticBegin()) and static bodies [staticBegin(), size()),
+// so per-step passes walk a prefix without per-body branches. A body is
+// simulated while it is both active and awake. setActive() and setAwake()
+// only flag the body; partitionActive() restores the layout. Every dense
+// swap is reported through onSwap, and every reorder() through onPermute,
+// so owners of per-body side structures can mirror them.
+struct BodyStorage {
+  // hot
+  std::vector<glm::vec2> positions;
+  std::vector<glm::vec2> prevPositions;
+  std::vector<glm::vec2> velocities;
+  std::vector<glm::vec2> forces;
+  std::vector<float> invMasses;
+  std::vector<AABB> aabbs;
+
+  // warm
+  std::vector<float> rotations;
+  std::vector<float> angularVelocities;
+  std::vector<float> torques;
+  std::vector<float> invInertias;
+  std::vector<BodyType> types;
+  std::vector<uint8_t> active;
+  std::vector<uint8_t> awake;
+  std::vector<uint8_t> bullets;
+  std::vector<CollisionFilter> filters;
+  std::vector<float> sleepTimes;
+  std::vector<ShapeType> shapeTypes;
+  std::vector<glm::vec2> shapeExtents;
+  // Transform at the start of the last step, for interpolated rendering.
+  // Bodies that stop being simulated are synced to their final transform.
+  std::vector<glm::vec2> stepStartPositions;
+  std::vector<float> stepStartRotations;
+
+  // cold
+  std::vector<BodyColdData> cold;
+  std::vector<uint32_t> denseToSlot;
+  // Sleeping island the body belongs to, or INVALID_INDEX while awake.
+  std::vector<uint32_t> sleepIslands;
+
+  std::function<void(uint32_t, uint32_t)> onSwap;
+  std::function<void(uint32_t, const std::vector<uint32_t>&)> onPermute;
+  // Bodies woken through setAwake(true) since the owner last drained this,
+  // so it can wake the rest of their island.
+  std::vector<BodyHandle> wokenBodies;
+
+  size_t size() const { return positions.size(); }
+  bool empty() const { return positions.empty(); }
+  size_t staticBegin() const { return m_staticBegin; }
+  size_t dynamicCount() const { return m_staticBegin; }
+  size_t activeCount() const { return m_activeEnd; }
+
+  void reserve(size_t count);
+  void clear();
+
+  BodyHandle add(RigidBody&& body);
+  bool remove(BodyHandle handle);
+  void swap(size_t a, size_t b);
+
+  void setActive(size_t index, bool isActive);
+  void setAwake(size_t index, bool isAwake);
+  // Returns true when bodies moved between regions.
+  bool partitionActive();
+  // Moves the body at begin + order[k] to begin + k. Handles follow and
+  // the permutation is reported once through onPermute. order must be a
+  // permutation of [0, order.size()) within one region.
+  void reorder(size_t begin, const std::vector<uint32_t>& order);
+
+  // Changes whenever a body is added or removed.
+  uint32_t layoutVersion() const { return m_layoutVersion; }
+  // Raw copy of the dynamic bodies' simulation state and dense order.
+  // Static bodies and per-body settings (shape, mass, material, filter) are
+  // not part of it. checkState() reads a saved state without applying it
+  // and fails unless the storage holds the same bodies as when it was
+  // saved. restoreState() applies the state checkState() last accepted and
+  // must be given a reader at the same position.
+  void saveState(SnapshotWriter& writer) const;
+  bool checkState(SnapshotReader& reader);
+  void restoreState(SnapshotReader& reader);
+
+  bool contains(BodyHandle handle) const {
+    return handle.index < m_slots.size() && m_slots[handle.index].generation == handle.generation &&
+           m_slots[handle.index].dense != BodyHandle::INVALID_INDEX;
+  }
+
+  uint32_t denseIndex(BodyHandle handle) const {
+    return contains(handle) ? m_slots[handle.index].dense : BodyHandle::INVALID_INDEX;
+  }
+
+  BodyHandle handleAt(size_t index) const {
+    uint32_t slot = denseToSlot[index];
+    return BodyHandle{slot, m_slots[slot].generation};
+  }
+
+  void updateAABB(size_t index) {
+    aabbs[index] = computeAABB(shapeTypes[index], shapeExtents[index], positions[index], rotations[index]);
+  }
+
+  void updateAABBs(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      updateAABB(i);
+    }
+  }
+
+  void updateActiveAABBs() { updateAABBs(0, m_activeEnd); }
+
+  // Remembers the simulated bodies' transforms before a step moves them.
+  void storeStepStart() {
+    std::copy_n(positions.begin(), m_activeEnd, stepStartPositions.begin());
+    std::copy_n(rotations.begin(), m_activeEnd, stepStartRotations.begin());
+  }
+
+  void syncStepStart(size_t index) {
+    stepStartPositions[index] = positions[index];
+    stepStartRotations[index] = rotations[index];
+  }
+
+private:
+  struct Slot {
+    uint32_t dense = BodyHandle::INVALID_INDEX;
+    uint32_t generation = 0;
+    uint32_t nextFree = BodyHandle::INVALID_INDEX;
+  };
+
+  std::vector<Slot> m_slots;
+  uint32_t m_freeHead = BodyHandle::INVALID_INDEX;
+  size_t m_staticBegin = 0;
+  size_t m_activeEnd = 0;
+  bool m_partitionDirty = false;
+  uint32_t m_layoutVersion = 0;
+  // Saved dense order read by checkState(), and which indices it claims.
+  std::vector<uint32_t> m_restoreSlots;
+  std::vector<uint8_t> m_restoreSeen;
+  bool m_restoreReordered = false;
+  // Gather buffers for reorder(), kept between calls.
+  std::vector<unsigned char> m_reorderScratch;
+  std::vector<BodyColdData> m_coldScratch;
+
+  template<typename T>
+  void gather(std::vector<T>& array, size_t begin, const std::vector<uint32_t>& order);
+
+  // The per-body arrays a snapshot carries, in saved order.
+  template<typename Self, typename F>
+  static void forEachStateArray(Self& self, F&& f) {
+    f(self.positions);
+    f(self.prevPositions);
+    f(self.velocities);
+    f(self.forces);
+    f(self.rotations);
+    f(self.angularVelocities);
+    f(self.torques);
+    f(self.active);
+    f(self.awake);
+    f(self.sleepTimes);
+    f(self.sleepIslands);
+  }
+
+  template<typename F>
+  void forEachArray(F&& f) {
+    f(positions);
+    f(prevPositions);
+    f(velocities);
+    f(forces);
+    f(invMasses);
+    f(aabbs);
+
+    f(rotations);
+    f(angularVelocities);
+    f(torques);
+    f(invInertias);
+    f(types);
+    f(active);
+    f(awake);
+    f(bullets);
+    f(filters);
+    f(sleepTimes);
+    f(shapeTypes);
+    f(shapeExtents);
+    f(stepStartPositions);
+    f(stepStartRotations);
+
+    f(cold);
+    f(denseToSlot);
+    f(sleepIslands);
+  }
+};
+
+// Lightweight view onto one body in a BodyStorage. Like a pointer into a
+// vector, it is only valid until the next add or remove on the storage.
+class BodyRef {
+public:
+  BodyRef() = default;
+  BodyRef(BodyStorage* storage, size_t index) : m_storage(storage), m_index(index) {}
+
+  explicit operator bool() const { return m_storage != nullptr; }
+  size_t index() const { return m_index; }
+
+  glm::vec2& position() const { return m_storage->positions[m_index]; }
+  glm::vec2& prevPosition() const { return m_storage->prevPositions[m_index]; }
+  glm::vec2& velocity() const { return m_storage->velocities[m_index]; }
+  float& rotation() const { return m_storage->rotations[m_index]; }
+  float& angularVelocity() const { return m_storage->angularVelocities[m_index]; }
+  const AABB& aabb() const { return m_storage->aabbs[m_index]; }
+
+  // Blend of the last step's start and end transforms. Render with the
+  // fixed step loop's leftover fraction, accumulator / fixedTimeStep.
+  glm::vec2 interpolatedPosition(float alpha) const {
+    const glm::vec2& from = m_storage->stepStartPositions[m_index];
+    return from + (m_storage->positions[m_index] - from) * alpha;
+  }
+
+  float interpolatedRotation(float alpha) const {
+    const float from = m_storage->stepStartRotations[m_index];
+    return from + (m_storage->rotations[m_index] - from) * alpha;
+  }
+
+  BodyType type() const { return m_storage->types[m_index]; }
+  ShapeType shapeType() const { return m_storage->shapeTypes[m_index]; }
+  const glm::vec2& shapeExtent() const { return m_storage->shapeExtents[m_index]; }
+
+  bool isActive() const { return m_storage->active[m_index] != 0; }
+  void setActive(bool active) const { m_storage->setActive(m_index, active); }
+  bool isBullet() const { return m_storage->bullets[m_index] != 0; }
+  void setBullet(bool bullet) const { m_storage->bullets[m_index] = bullet ? 1 : 0; }
+  bool isAwake() const { return m_storage->awake[m_index] != 0; }
+  void setAwake(bool awake) const { m_storage->setAwake(m_index, awake); }
+  // Change through PhysicsEngine::setCollisionFilter(), which re-files the
+  // body in the broad phase.
+  const CollisionFilter& filter() const { return m_storage->filters[m_index]; }
+
+  float mass() const { return m_storage->cold[m_index].mass; }
+  float invMass() const { return m_storage->invMasses[m_index]; }
+  const std::string& id() const { return m_storage->cold[m_index].id; }
+  float& restitution() const { return m_storage->cold[m_index].restitution; }
+  float& friction() const { return m_storage->cold[m_index].friction; }
+  void*& userData() const { return m_storage->cold[m_index].userData; }
+
+  // Teleporting and applying forces or impulses wake the body. Writing
+  // through position() or velocity() does not.
+  void teleport(const glm::vec2& position) const {
+    m_storage->positions[m_index] = position;
+    m_storage->prevPositions[m_index] = position;
+    m_storage->stepStartPositions[m_index] = position;
+    m_storage->updateAABB(m_index);
+    m_storage->setAwake(m_index, true);
+  }
+
+  void applyForce(const glm::vec2& force) const {
+    m_storage->forces[m_index] += force;
+    m_storage->setAwake(m_index, true);
+  }
+
+  void applyForceAtPoint(const glm::vec2& force, const glm::vec2& point) const {
+    m_storage->forces[m_index] += force;
+    m_storage->setAwake(m_index, true);
+
+    glm::vec2 arm = point - m_storage->positions[m_index];
+    m_storage->torques[m_index] += (arm.x * force.y - arm.y * force.x);
+  }
+
+  void applyImpulse(const glm::vec2& impulse, const glm::vec2& contactPoint) const {
+    if (m_storage->types[m_index] == BodyType::STATIC) return;
+
+    m_storage->setAwake(m_index, true);
+    m_storage->velocities[m_index] += impulse * m_storage->invMasses[m_index];
+
+    glm::vec2 arm = contactPoint - m_storage->positions[m_index];
+    float angularImpulse = arm.x * impulse.y - arm.y * impulse.x;
+    m_storage->angularVelocities[m_index] += angularImpulse * m_storage->invInertias[m_index];
+  }
+
+private:
+  BodyStorage* m_storage = nullptr;
+  size_t m_index = 0;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "body.hpp"
+#include <vector>
+
+enum class BroadPhaseType {
+  SPATIAL_HASH,
+  SWEEP_AND_PRUNE,
+  AABB_TREE
+};
+
+// Receivers for the read-only queries below.
+class QueryCallback {
+public:
+  // Returning false stops the query.
+  virtual bool reportBody(uint32_t body) = 0;
+
+protected:
+  ~QueryCallback() = default;
+};
+
+class RayCastCallback {
+public:
+  // Returns how much of the ray is still of interest as a fraction of
+  // from -> to: a hit's fraction clips the ray there, the previous value
+  // keeps it as it is and 0 stops the cast.
+  virtual float reportBody(uint32_t body) = 0;
+
+protected:
+  ~RayCastCallback() = default;
+};
+
+// Broad phases track bodies by dense index, the same index the BodyStorage
+// arrays use. PhysicsEngine mirrors every storage swap through swapBodies(),
+// and every reorder through permuteBodies(), so the two stay in step
+// without rebuilding. Pairs of two static bodies,
+// and pairs whose collision filters reject each other, are never reported.
+// A body whose filter changes is re-filed as if it were new.
+class BroadPhase {
+public:
+  virtual ~BroadPhase() = default;
+
+  virtual BroadPhaseType getType() const = 0;
+
+  virtual void update(uint32_t body, const AABB& aabb, bool isStatic, const CollisionFilter& filter) = 0;
+  virtual void remove(uint32_t body) = 0;
+  virtual void swapBodies(uint32_t a, uint32_t b) = 0;
+  // The body at begin + order[k] is now at begin + k.
+  virtual void permuteBodies(uint32_t begin, const std::vector<uint32_t>& order) = 0;
+  virtual void clear() = 0;
+
+  // Applies work a broad phase deferred from update() and remove(). The
+  // engine calls it after each batch of updates; query() and
+  // computePairs() see every earlier update without it.
+  virtual void flush() {}
+
+  virtual void query(const AABB& aabb, std::vector<uint32_t>& result) = 0;
+  virtual void computePairs(std::vector<BodyPair>& pairs) = 0;
+
+  // Scene queries. These only read the broad phase, so any number of them
+  // may run on different threads at once while it is not being updated.
+  // They see the updates up to the last flush().
+  // Bodies are reported by their broad-phase AABB, so the callback does
+  // the exact shape test. queryAABB() reports a body once; rayCast() may
+  // report it again from a later part of the ray.
+  virtual void queryAABB(const AABB& aabb, QueryCallback& callback) const = 0;
+  virtual void rayCast(const glm::vec2& from, const glm::vec2& to, RayCastCallback& callback) const = 0;
+
+  // Pairs that started or stopped overlapping between the previous
+  // computePairs() and the last one, as dense body indices. Pairs that lost
+  // a body to remove() end without an event. Only broad phases that track
+  // pairs persistently support this; the others leave both lists empty and
+  // return false.
+  virtual bool getPairDeltas(std::vector<BodyPair>& begun, std::vector<BodyPair>& ended) const {
+    begun.clear();
+    ended.clear();
+    return false;
+  }
+};
@@ -0,0 +1,323 @@
+#include "ContactSolver.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+  float cross(const glm::vec2& a, const glm::vec2& b) {
+    return a.x * b.y - a.y * b.x;
+  }
+
+  glm::vec2 cross(float w, const glm::vec2& r) {
+    return glm::vec2(-w * r.y, w * r.x);
+  }
+}
+
+void ContactSolver::prepare(const BodyStorage& bodies, const std::vector<Collision>& collisions) {
+  m_constraints.clear();
+  m_constraints.reserve(collisions.size());
+  m_cacheHits = 0;
+
+  const size_t activeCount = bodies.activeCount();
+  auto movable = [&bodies, activeCount](uint32_t body) {
+    return body < activeCount && bodies.types[body] == BodyType::DYNAMIC;
+  };
+  // Rectangles collide as axis-aligned boxes, so letting contacts spin them
+  // would feed rotation back in as sliding that no shape test accounts for.
+  auto inertia = [&bodies, &movable](uint32_t body) {
+    return movable(body) && bodies.shapeTypes[body] == ShapeType::CIRCLE ? bodies.invInertias[body] : 0.0f;
+  };
+
+  for (const Collision& collision : collisions) {
+    const uint32_t a = collision.bodyA;
+    const uint32_t b = collision.bodyB;
+    const bool worldB = b == BodyHandle::INVALID_INDEX;
+
+    ContactConstraint constraint;
+    constraint.bodyA = a;
+    constraint.bodyB = b;
+    constraint.invMassA = movable(a) ? bodies.invMasses[a] : 0.0f;
+    constraint.invInertiaA = inertia(a);
+    constraint.invMassB = !worldB && movable(b) ? bodies.invMasses[b] : 0.0f;
+    constraint.invInertiaB = worldB ? 0.0f : inertia(b);
+
+    if (constraint.invMassA + constraint.invMassB <= 0.0f) continue;
+
+    constraint.normal = collision.normal;
+    constraint.tangent = glm::vec2(-collision.normal.y, collision.normal.x);
+    constraint.originA = bodies.positions[a];
+    constraint.originB = worldB ? collision.contactPoint : bodies.positions[b];
+    constraint.armA = collision.contactPoint - constraint.originA;
+    constraint.armB = collision.contactPoint - constraint.originB;
+    constraint.penetration = collision.penetration;
+
+    float armNormalA = cross(constraint.armA, constraint.normal);
+    float armNormalB = cross(constraint.armB, constraint.normal);
+    float normalMass = constraint.invMassA + constraint.invMassB +
+                       constraint.invInertiaA * armNormalA * armNormalA +
+                       constraint.invInertiaB * armNormalB * armNormalB;
+    constraint.normalMass = normalMass > 0.0f ? 1.0f / normalMass : 0.0f;
+
+    float armTangentA = cross(constraint.armA, constraint.tangent);
+    float armTangentB = cross(constraint.armB, constraint.tangent);
+    float tangentMass = constraint.invMassA + constraint.invMassB +
+                        constraint.invInertiaA * armTangentA * armTangentA +
+                        constraint.invInertiaB * armTangentB * armTangentB;
+    constraint.tangentMass = tangentMass > 0.0f ? 1.0f / tangentMass : 0.0f;
+
+    const BodyColdData& coldA = bodies.cold[a];
+    float restitution = worldB ? coldA.restitution : std::min(coldA.restitution, bodies.cold[b].restitution);
+    constraint.friction = worldB ? coldA.friction : std::sqrt(coldA.friction * bodies.cold[b].friction);
+
+    // Restitution targets the closing speed at the start of the step, so
+    // gravity added by the integrator does not feed the bounce.
+    float normalVelocity = glm::dot(relativeVelocity(bodies, constraint), constraint.normal);
+    constraint.velocityBias = normalVelocity < -RESTITUTION_THRESHOLD ? -restitution * normalVelocity : 0.0f;
+
+    // Slots order the pair, not dense indices, so the key and the sign of
+    // the normal do not depend on where the partition put the bodies. The
+    // impulses are scalars along a normal that flips with the order, so
+    // they need no adjustment. World contacts use one key per plane.
+    const BodyHandle& handleA = collision.handleA;
+    const BodyHandle& handleB = collision.handleB;
+    uint32_t slotB = worldB ? BodyHandle::INVALID_INDEX - collision.feature : handleB.index;
+    bool swapped = !worldB && handleB.index < handleA.index;
+    constraint.cacheKey = BodyPair(handleA.index, slotB).key();
+    constraint.generationA = swapped ? handleB.generation : handleA.generation;
+    constraint.generationB = swapped ? handleA.generation : (worldB ? 0u : handleB.generation);
+    constraint.feature = collision.feature;
+
+    constraint.normalImpulse = 0.0f;
+    constraint.tangentImpulse = 0.0f;
+
+    const CachedImpulse* cached = m_cache.find(constraint.cacheKey);
+    if (cached && cached->generationA == constraint.generationA &&
+        cached->generationB == constraint.generationB && cached->feature == constraint.feature) {
+      constraint.normalImpulse = cached->normalImpulse;
+      constraint.tangentImpulse = cached->tangentImpulse;
+      m_cacheHits++;
+    }
+
+    m_constraints.push_back(constraint);
+  }
+}
+
+void ContactSolver::clear() {
+  m_constraints.clear();
+  m_cache.clear();
+  m_nextCache.clear();
+  m_cacheHits = 0;
+}
+
+float ContactSolver::getCacheHitRate() const {
+  if (m_constraints.empty()) return 0.0f;
+  return static_cast<float>(m_cacheHits) / static_cast<float>(m_constraints.size());
+}
+
+void ContactSolver::warmStart(BodyStorage& bodies, float dt) {
+  for (const ContactConstraint& constraint : m_constraints) {
+    if (constraint.normalImpulse == 0.0f && constraint.tangentImpulse == 0.0f) continue;
+
+    glm::vec2 impulse = constraint.normalImpulse * constraint.normal + constraint.tangentImpulse * constraint.tangent;
+    applyImpulse(bodies, constraint, impulse, dt);
+  }
+}
+
+// Rebuilt from scratch every step, so pairs that stopped touching drop out.
+void ContactSolver::storeImpulses() {
+  m_nextCache.clear();
+  for (const ContactConstraint& constraint : m_constraints) {
+    CachedImpulse& cached = m_nextCache.insert(constraint.cacheKey);
+    cached.generationA = constraint.generationA;
+    cached.generationB = constraint.generationB;
+    cached.feature = constraint.feature;
+    cached.normalImpulse = constraint.normalImpulse;
+    cached.tangentImpulse = constraint.tangentImpulse;
+  }
+  std::swap(m_cache, m_nextCache);
+}
+
+void ContactSolver::solveVelocities(BodyStorage& bodies, int iterations, float dt) {
+  warmStart(bodies, dt);
+
+  for (int iteration = 0; iteration < iterations; ++iteration) {
+    for (ContactConstraint& constraint : m_constraints) {
+      // Friction first: its bound depends on the normal impulse, which the
+      // normal row below then gets the final word on.
+      glm::vec2 velocity = relativeVelocity(bodies, constraint);
+      float lambda = -constraint.tangentMass * glm::dot(velocity, constraint.tangent);
+      float maxFriction = constraint.friction * constraint.normalImpulse;
+      float tangentImpulse = glm::clamp(constraint.tangentImpulse + lambda, -maxFriction, maxFriction);
+      lambda = tangentImpulse - constraint.tangentImpulse;
+      constraint.tangentImpulse = tangentImpulse;
+      applyImpulse(bodies, constraint, lambda * constraint.tangent, dt);
+
+      velocity = relativeVelocity(bodies, constraint);
+      lambda = -constraint.normalMass * (glm::dot(velocity, constraint.normal) - constraint.velocityBias);
+      float normalImpulse = std::max(constraint.normalImpulse + lambda, 0.0f);
+      lambda = normalImpulse - constraint.normalImpulse;
+      constraint.normalImpulse = normalImpulse;
+      applyImpulse(bodies, constraint, lambda * constraint.normal, dt);
+    }
+  }
+
+  storeImpulses();
+}
+
+// Nonlinear Gauss-Seidel on the penetration depth. The depth is tracked
+// from the narrow phase result by how far both centres moved since, so no
+// shape test runs here. Rotation is ignored: shapes collide unrotated.
+void ContactSolver::solvePositions(BodyStorage& bodies, int iterations) {
+  const uint32_t world = BodyHandle::INVALID_INDEX;
+
+  for (int iteration = 0; iteration < iterations; ++iteration) {
+    for (const ContactConstraint& constraint : m_constraints) {
+      glm::vec2 movedA = bodies.positions[constraint.bodyA] - constraint.originA;
+      glm::vec2 movedB = constraint.bodyB == world ? glm::vec2(0.0f) : bodies.positions[constraint.bodyB] - constraint.originB;
+      float separation = glm::dot(movedB - movedA, constraint.normal) - constraint.penetration;
+
+      float error = std::min(BAUMGARTE * (separation + LINEAR_SLOP), 0.0f);
+      if (error >= 0.0f) continue;
+
+      glm::vec2 correction = (-error / (constraint.invMassA + constraint.invMassB)) * constraint.normal;
+      if (constraint.invMassA > 0.0f) {
+        bodies.positions[constraint.bodyA] -= correction * constraint.invMassA;
+        bodies.prevPositions[constraint.bodyA] -= correction * constraint.invMassA;
+      }
+      if (constraint.invMassB > 0.0f) {
+        bodies.positions[constraint.bodyB] += correction * constraint.invMassB;
+        bodies.prevPositions[constraint.bodyB] += correction * constraint.invMassB;
+      }
+    }
+  }
+}
+
+void ContactSolver::projectContacts(BodyStorage& bodies, const std::vector<Collision>& collisions) {
+  m_constraints.clear();
+  m_cacheHits = 0;
+
+  const size_t activeCount = bodies.activeCount();
+  const uint32_t world = BodyHandle::INVALID_INDEX;
+
+  for (const Collision& collision : collisions) {
+    const uint32_t a = collision.bodyA;
+    const uint32_t b = collision.bodyB;
+    const bool worldB = b == world;
+
+    ContactConstraint constraint = {};
+    constraint.bodyA = a;
+    constraint.bodyB = b;
+    constraint.invMassA = a < activeCount ? bodies.invMasses[a] : 0.0f;
+    constraint.invMassB = !worldB && b < activeCount ? bodies.invMasses[b] : 0.0f;
+
+    const float invMassSum = constraint.invMassA + constraint.invMassB;
+    if (invMassSum <= 0.0f) continue;
+
+    constraint.normal = collision.normal;
+    constraint.tangent = glm::vec2(-collision.normal.y, collision.normal.x);
+    constraint.originA = bodies.positions[a];
+    constraint.originB = worldB ? collision.contactPoint : bodies.positions[b];
+    constraint.penetration = collision.penetration;
+
+    const BodyColdData& coldA = bodies.cold[a];
+    float restitution = worldB ? coldA.restitution : std::min(coldA.restitution, bodies.cold[b].restitution);
+    constraint.friction = worldB ? coldA.friction : std::sqrt(coldA.friction * bodies.cold[b].friction);
+
+    float normalVelocity = glm::dot(relativeVelocity(bodies, constraint), constraint.normal);
+    constraint.velocityBias = normalVelocity < -RESTITUTION_THRESHOLD ? -restitution * normalVelocity : 0.0f;
+
+    // Earlier projections this substep may already have separated the pair.
+    glm::vec2 movedA = bodies.positions[a] - constraint.originA;
+    glm::vec2 movedB = worldB ? glm::vec2(0.0f) : bodies.positions[b] - constraint.originB;
+    float depth = constraint.penetration - glm::dot(movedB - movedA, constraint.normal);
+    if (depth <= 0.0f) continue;
+
+    float lambda = depth / invMassSum;
+    constraint.normalImpulse = lambda;
+    bodies.positions[a] -= constraint.normal * (lambda * constraint.invMassA);
+    if (!worldB) {
+      bodies.positions[b] += constraint.normal * (lambda * constraint.invMassB);
+    }
+
+    glm::vec2 slipA = bodies.positions[a] - bodies.prevPositions[a];
+    glm::vec2 slipB = worldB ? glm::vec2(0.0f) : bodies.positions[b] - bodies.prevPositions[b];
+    float tangentLambda = glm::dot(slipA - slipB, constraint.tangent) / invMassSum;
+    if (std::abs(tangentLambda) < constraint.friction * lambda) {
+      constraint.tangentImpulse = tangentLambda;
+      bodies.positions[a] -= constraint.tangent * (tangentLambda * constraint.invMassA);
+      if (!worldB) {
+        bodies.positions[b] += constraint.tangent * (tangentLambda * constraint.invMassB);
+      }
+    }
+
+    m_constraints.push_back(constraint);
+  }
+}
+
+void ContactSolver::solveContactVelocities(BodyStorage& bodies, float dt) {
+  for (const ContactConstraint& constraint : m_constraints) {
+    const uint32_t a = constraint.bodyA;
+    const uint32_t b = constraint.bodyB;
+    const bool worldB = b == BodyHandle::INVALID_INDEX;
+
+    glm::vec2 velocity = (worldB ? glm::vec2(0.0f) : bodies.velocities[b]) - bodies.velocities[a];
+    float normalVelocity = glm::dot(velocity, constraint.normal);
+    glm::vec2 tangentVelocity = velocity - constraint.normal * normalVelocity;
+    float tangentSpeed = glm::length(tangentVelocity);
+
+    glm::vec2 deltaVelocity(0.0f);
+    if (tangentSpeed > 0.0f) {
+      // Normal force of the projection is lambda / dt^2; friction may take
+      // away at most dt * mu * force of the sliding speed.
+      float normalForce = constraint.normalImpulse / (dt * dt);
+      deltaVelocity -= tangentVelocity * (std::min(dt * constraint.friction * normalForce, tangentSpeed) / tangentSpeed);
+    }
+    if (normalVelocity < constraint.velocityBias) {
+      deltaVelocity += constraint.normal * (constraint.velocityBias - normalVelocity);
+    }
+
+    glm::vec2 impulse = deltaVelocity / (constraint.invMassA + constraint.invMassB);
+    bodies.velocities[a] -= impulse * constraint.invMassA;
+    if (!worldB) {
+      bodies.velocities[b] += impulse * constraint.invMassB;
+    }
+  }
+}
+
+glm::vec2 ContactSolver::relativeVelocity(const BodyStorage& bodies, const ContactConstraint& constraint) {
+  const uint32_t a = constraint.bodyA;
+  const uint32_t b = constraint.bodyB;
+
+  glm::vec2 velocityA = bodies.velocities[a];
+  if (constraint.invInertiaA > 0.0f) {
+    velocityA += cross(bodies.angularVelocities[a], constraint.armA);
+  }
+  if (b == BodyHandle::INVALID_INDEX) {
+    return -velocityA;
+  }
+
+  glm::vec2 velocityB = bodies.velocities[b];
+  if (constraint.invInertiaB > 0.0f) {
+    velocityB += cross(bodies.angularVelocities[b], constraint.armB);
+  }
+  return velocityB - velocityA;
+}
+
+void ContactSolver::applyImpulse(BodyStorage& bodies, const ContactConstraint& constraint, const glm::vec2& impulse, float dt) {
+  if (constraint.invMassA > 0.0f) {
+    glm::vec2 deltaVelocity = impulse * constraint.invMassA;
+    float deltaAngular = constraint.invInertiaA * cross(constraint.armA, impulse);
+    bodies.velocities[constraint.bodyA] -= deltaVelocity;
+    bodies.positions[constraint.bodyA] -= deltaVelocity * dt;
+    bodies.angularVelocities[constraint.bodyA] -= deltaAngular;
+    bodies.rotations[constraint.bodyA] -= deltaAngular * dt;
+  }
+
+  if (constraint.invMassB > 0.0f) {
+    glm::vec2 deltaVelocity = impulse * constraint.invMassB;
+    float deltaAngular = constraint.invInertiaB * cross(constraint.armB, impulse);
+    bodies.velocities[constraint.bodyB] += deltaVelocity;
+    bodies.positions[constraint.bodyB] += deltaVelocity * dt;
+    bodies.angularVelocities[constraint.bodyB] += deltaAngular;
+    bodies.rotations[constraint.bodyB] += deltaAngular * dt;
+  }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "BodyStorage.hpp"
+#include "PairTable.hpp"
+#include <vector>
+
+// One contact point between two bodies, or between a body and the world
+// when bodyB is BodyHandle::INVALID_INDEX. Masses of bodies the solver may
+// not move (static, inactive, world) are zero.
+struct ContactConstraint {
+  uint32_t bodyA;
+  uint32_t bodyB;
+  glm::vec2 normal;
+  glm::vec2 tangent;
+  glm::vec2 armA;
+  glm::vec2 armB;
+  glm::vec2 originA;
+  glm::vec2 originB;
+  float penetration;
+  float invMassA;
+  float invMassB;
+  float invInertiaA;
+  float invInertiaB;
+  float normalMass;
+  float tangentMass;
+  float friction;
+  float velocityBias;
+  float normalImpulse;
+  float tangentImpulse;
+  uint64_t cacheKey;
+  uint32_t generationA;
+  uint32_t generationB;
+  uint32_t feature;
+};
+
+// Sequential impulse contact solver. prepare() runs on the contacts found
+// at the start of the step, before the integrator; the two solve phases run
+// after it. Impulses change velocities and move the already integrated
+// positions by dv * dt, and position corrections move prevPositions along
+// with positions, so Verlet and leapfrog bodies respond the same way.
+//
+// Accumulated impulses are cached per body pair between steps, keyed by
+// handle slot so partition swaps do not break the match. A contact that
+// reappears with the same generations and feature starts from last step's
+// impulses (warm starting), which lets resting contacts converge in one or
+// two iterations.
+class ContactSolver {
+public:
+  static constexpr float BAUMGARTE = 0.2f;
+  static constexpr float LINEAR_SLOP = 0.01f;
+  static constexpr float RESTITUTION_THRESHOLD = 1.0f;
+
+  void prepare(const BodyStorage& bodies, const std::vector<Collision>& collisions);
+  void solveVelocities(BodyStorage& bodies, int iterations, float dt);
+  void solvePositions(BodyStorage& bodies, int iterations);
+
+  // XPBD substep: projectContacts() rebuilds the constraints from this
+  // substep's contacts and moves bodies out of each other (rigid contacts,
+  // zero compliance), with static friction undoing tangential slip since
+  // prevPositions. After the velocities were derived from the positions,
+  // solveContactVelocities() applies restitution and dynamic friction.
+  // Both are linear only and do not touch the impulse cache.
+  void projectContacts(BodyStorage& bodies, const std::vector<Collision>& collisions);
+  void solveContactVelocities(BodyStorage& bodies, float dt);
+  void clear();
+
+  const std::vector<ContactConstraint>& getConstraints() const { return m_constraints; }
+  // Fraction of this step's contacts that were warm started.
+  float getCacheHitRate() const;
+
+  // The impulse cache is the only solver state that outlives a step.
+  void saveCache(SnapshotWriter& writer) const { m_cache.saveState(writer); }
+  static bool checkCache(SnapshotReader& reader) { return PairTable<CachedImpulse>::checkState(reader); }
+  void restoreCache(SnapshotReader& reader) { m_cache.restoreState(reader); }
+
+private:
+  struct CachedImpulse {
+    uint32_t generationA = 0;
+    uint32_t generationB = 0;
+    uint32_t feature = 0;
+    float normalImpulse = 0.0f;
+    float tangentImpulse = 0.0f;
+  };
+
+  std::vector<ContactConstraint> m_constraints;
+  PairTable<CachedImpulse> m_cache;
+  PairTable<CachedImpulse> m_nextCache;
+  size_t m_cacheHits = 0;
+
+  void warmStart(BodyStorage& bodies, float dt);
+  void storeImpulses();
+
+  static glm::vec2 relativeVelocity(const BodyStorage& bodies, const ContactConstraint& constraint);
+  static void applyImpulse(BodyStorage& bodies, const ContactConstraint& constraint, const glm::vec2& impulse, float dt);
+};
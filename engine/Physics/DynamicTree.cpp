@@ -0,0 +1,239 @@
+#include "DynamicTree.hpp"
+#include <algorithm>
+
+DynamicTree::DynamicTree(float margin) : m_margin(margin) {}
+
+uint32_t DynamicTree::allocateNode() {
+  if (m_freeList != NULL_NODE) {
+    uint32_t node = m_freeList;
+    m_freeList = m_nodes[node].parent;
+    m_nodes[node] = Node();
+    return node;
+  }
+
+  m_nodes.emplace_back();
+  return static_cast<uint32_t>(m_nodes.size() - 1);
+}
+
+void DynamicTree::freeNode(uint32_t node) {
+  m_nodes[node].parent = m_freeList;
+  m_nodes[node].height = -1;
+  m_freeList = node;
+}
+
+uint32_t DynamicTree::createProxy(const AABB& aabb, uint32_t userData) {
+  uint32_t proxy = allocateNode();
+
+  glm::vec2 margin(m_margin);
+  m_nodes[proxy].aabb = AABB(aabb.min - margin, aabb.max + margin);
+  m_nodes[proxy].userData = userData;
+  m_nodes[proxy].height = 0;
+
+  insertLeaf(proxy);
+  m_proxyCount++;
+
+  return proxy;
+}
+
+void DynamicTree::destroyProxy(uint32_t proxy) {
+  removeLeaf(proxy);
+  freeNode(proxy);
+  m_proxyCount--;
+}
+
+bool DynamicTree::moveProxy(uint32_t proxy, const AABB& aabb) {
+  if (contains(m_nodes[proxy].aabb, aabb)) {
+    return false;
+  }
+
+  removeLeaf(proxy);
+
+  glm::vec2 margin(m_margin);
+  m_nodes[proxy].aabb = AABB(aabb.min - margin, aabb.max + margin);
+
+  insertLeaf(proxy);
+  return true;
+}
+
+void DynamicTree::clear() {
+  m_nodes.clear();
+  m_root = NULL_NODE;
+  m_freeList = NULL_NODE;
+  m_proxyCount = 0;
+}
+
+// Descends towards the sibling that minimises the perimeter growth of the
+// tree (surface area heuristic in 2D), then splices in a new parent.
+void DynamicTree::insertLeaf(uint32_t leaf) {
+  if (m_root == NULL_NODE) {
+    m_root = leaf;
+    m_nodes[leaf].parent = NULL_NODE;
+    return;
+  }
+
+  AABB leafAABB = m_nodes[leaf].aabb;
+  uint32_t index = m_root;
+
+  while (!m_nodes[index].isLeaf()) {
+    const Node& node = m_nodes[index];
+    uint32_t child1 = node.child1;
+    uint32_t child2 = node.child2;
+
+    float area = perimeter(node.aabb);
+    float combinedArea = perimeter(combine(node.aabb, leafAABB));
+
+    float cost = 2.0f * combinedArea;
+    float inheritanceCost = 2.0f * (combinedArea - area);
+
+    auto descendCost = [&](uint32_t child) {
+      AABB combined = combine(leafAABB, m_nodes[child].aabb);
+      if (m_nodes[child].isLeaf()) {
+        return perimeter(combined) + inheritanceCost;
+      }
+      return perimeter(combined) - perimeter(m_nodes[child].aabb) + inheritanceCost;
+    };
+
+    float cost1 = descendCost(child1);
+    float cost2 = descendCost(child2);
+
+    if (cost < cost1 && cost < cost2) {
+      break;
+    }
+
+    index = cost1 < cost2 ? child1 : child2;
+  }
+
+  uint32_t sibling = index;
+  uint32_t oldParent = m_nodes[sibling].parent;
+  uint32_t newParent = allocateNode();
+
+  m_nodes[newParent].parent = oldParent;
+  m_nodes[newParent].aabb = combine(leafAABB, m_nodes[sibling].aabb);
+  m_nodes[newParent].height = m_nodes[sibling].height + 1;
+  m_nodes[newParent].child1 = sibling;
+  m_nodes[newParent].child2 = leaf;
+  m_nodes[sibling].parent = newParent;
+  m_nodes[leaf].parent = newParent;
+
+  if (oldParent != NULL_NODE) {
+    if (m_nodes[oldParent].child1 == sibling) {
+      m_nodes[oldParent].child1 = newParent;
+    } else {
+      m_nodes[oldParent].child2 = newParent;
+    }
+  } else {
+    m_root = newParent;
+  }
+
+  refit(newParent);
+}
+
+void DynamicTree::removeLeaf(uint32_t leaf) {
+  if (leaf == m_root) {
+    m_root = NULL_NODE;
+    return;
+  }
+
+  uint32_t parent = m_nodes[leaf].parent;
+  uint32_t grandParent = m_nodes[parent].parent;
+  uint32_t sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+  if (grandParent != NULL_NODE) {
+    if (m_nodes[grandParent].child1 == parent) {
+      m_nodes[grandParent].child1 = sibling;
+    } else {
+      m_nodes[grandParent].child2 = sibling;
+    }
+    m_nodes[sibling].parent = grandParent;
+    freeNode(parent);
+
+    refit(grandParent);
+  } else {
+    m_root = sibling;
+    m_nodes[sibling].parent = NULL_NODE;
+    freeNode(parent);
+  }
+}
+
+void DynamicTree::refit(uint32_t index) {
+  while (index != NULL_NODE) {
+    index = balance(index);
+
+    Node& node = m_nodes[index];
+    const Node& child1 = m_nodes[node.child1];
+    const Node& child2 = m_nodes[node.child2];
+
+    node.height = 1 + std::max(child1.height, child2.height);
+    node.aabb = combine(child1.aabb, child2.aabb);
+
+    index = node.parent;
+  }
+}
+
+// Rotates the taller grandchild subtree up when the children of a differ in
+// height by more than one. Returns the node now at a's position.
+uint32_t DynamicTree::balance(uint32_t iA) {
+  Node& A = m_nodes[iA];
+  if (A.isLeaf() || A.height < 2) {
+    return iA;
+  }
+
+  uint32_t iB = A.child1;
+  uint32_t iC = A.child2;
+  Node& B = m_nodes[iB];
+  Node& C = m_nodes[iC];
+
+  int32_t heightDiff = C.height - B.height;
+
+  auto rotateUp = [this, iA](uint32_t iUp, uint32_t iOther, bool upIsChild2) {
+    Node& nodeA = m_nodes[iA];
+    Node& up = m_nodes[iUp];
+    uint32_t iF = up.child1;
+    uint32_t iG = up.child2;
+    Node& F = m_nodes[iF];
+    Node& G = m_nodes[iG];
+
+    up.child1 = iA;
+    up.parent = nodeA.parent;
+    nodeA.parent = iUp;
+
+    if (up.parent != NULL_NODE) {
+      if (m_nodes[up.parent].child1 == iA) {
+        m_nodes[up.parent].child1 = iUp;
+      } else {
+        m_nodes[up.parent].child2 = iUp;
+      }
+    } else {
+      m_root = iUp;
+    }
+
+    const Node& other = m_nodes[iOther];
+    uint32_t iKeep = F.height > G.height ? iF : iG;
+    uint32_t iMove = F.height > G.height ? iG : iF;
+
+    up.child2 = iKeep;
+    if (upIsChild2) {
+      nodeA.child2 = iMove;
+    } else {
+      nodeA.child1 = iMove;
+    }
+    m_nodes[iMove].parent = iA;
+
+    nodeA.aabb = combine(other.aabb, m_nodes[iMove].aabb);
+    up.aabb = combine(nodeA.aabb, m_nodes[iKeep].aabb);
+    nodeA.height = 1 + std::max(other.height, m_nodes[iMove].height);
+    up.height = 1 + std::max(nodeA.height, m_nodes[iKeep].height);
+  };
+
+  if (heightDiff > 1) {
+    rotateUp(iC, iB, true);
+    return iC;
+  }
+
+  if (heightDiff < -1) {
+    rotateUp(iB, iC, false);
+    return iB;
+  }
+
+  return iA;
+}
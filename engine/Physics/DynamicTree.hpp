@@ -0,0 +1,177 @@
+#pragma once
+
+#include "body.hpp"
+#include <vector>
+
+// Bounding volume hierarchy over enlarged ("fat") leaf AABBs. A leaf is only
+// re-inserted when the tight AABB leaves its fat AABB, and insertions keep
+// the tree height-balanced with AVL-style rotations.
+class DynamicTree {
+public:
+  static constexpr uint32_t NULL_NODE = 0xFFFFFFFFu;
+
+  explicit DynamicTree(float margin = 4.0f);
+
+  uint32_t createProxy(const AABB& aabb, uint32_t userData);
+  void destroyProxy(uint32_t proxy);
+  bool moveProxy(uint32_t proxy, const AABB& aabb);
+
+  const AABB& getFatAABB(uint32_t proxy) const { return m_nodes[proxy].aabb; }
+  uint32_t getUserData(uint32_t proxy) const { return m_nodes[proxy].userData; }
+  void setUserData(uint32_t proxy, uint32_t userData) { m_nodes[proxy].userData = userData; }
+
+  int getHeight() const { return m_root == NULL_NODE ? 0 : m_nodes[m_root].height; }
+  size_t getProxyCount() const { return m_proxyCount; }
+  float getMargin() const { return m_margin; }
+
+  void clear();
+
+  // callback(proxy) is called for every leaf whose fat AABB overlaps aabb;
+  // returning false stops the query.
+  template<typename F>
+  void query(const AABB& aabb, F&& callback) const {
+    if (m_root == NULL_NODE) return;
+
+    TraversalStack<uint32_t> stack;
+    stack.push(m_root);
+
+    while (!stack.empty()) {
+      uint32_t nodeId = stack.pop();
+      const Node& node = m_nodes[nodeId];
+
+      if (!node.aabb.overlaps(aabb)) continue;
+
+      if (node.isLeaf()) {
+        if (!callback(nodeId)) return;
+      } else {
+        stack.push(node.child1);
+        stack.push(node.child2);
+      }
+    }
+  }
+
+  // callback(proxy) is called for every leaf whose fat AABB the segment
+  // from -> to crosses before maxFraction and returns the new maxFraction
+  // (0 stops the cast). Children are visited nearer first, so early hits
+  // prune the rest. Returns the final maxFraction.
+  template<typename F>
+  float rayCast(const glm::vec2& from, const glm::vec2& to, float maxFraction, F&& callback) const {
+    const glm::vec2 delta = to - from;
+    float enter;
+    if (m_root == NULL_NODE || !m_nodes[m_root].aabb.intersectsSegment(from, delta, maxFraction, enter)) {
+      return maxFraction;
+    }
+
+    struct Entry {
+      uint32_t node;
+      float enter;
+    };
+    TraversalStack<Entry> stack;
+    stack.push({m_root, enter});
+
+    while (!stack.empty()) {
+      Entry entry = stack.pop();
+      if (entry.enter > maxFraction) continue;
+
+      const Node& node = m_nodes[entry.node];
+      if (node.isLeaf()) {
+        maxFraction = callback(entry.node);
+        if (maxFraction <= 0.0f) return 0.0f;
+        continue;
+      }
+
+      float enter1;
+      float enter2;
+      bool hit1 = m_nodes[node.child1].aabb.intersectsSegment(from, delta, maxFraction, enter1);
+      bool hit2 = m_nodes[node.child2].aabb.intersectsSegment(from, delta, maxFraction, enter2);
+
+      if (hit1 && hit2) {
+        bool firstNearer = enter1 <= enter2;
+        stack.push(firstNearer ? Entry{node.child2, enter2} : Entry{node.child1, enter1});
+        stack.push(firstNearer ? Entry{node.child1, enter1} : Entry{node.child2, enter2});
+      } else if (hit1) {
+        stack.push({node.child1, enter1});
+      } else if (hit2) {
+        stack.push({node.child2, enter2});
+      }
+    }
+
+    return maxFraction;
+  }
+
+private:
+  // Traversal stack for the queries above. The tree is kept balanced, so
+  // the inline entries cover any depth it normally reaches; a degenerate
+  // tree spills into a heap vector instead of dropping nodes. The queries
+  // may run on several threads at once, so the stack is per call rather
+  // than a shared member.
+  template<typename T>
+  class TraversalStack {
+  public:
+    bool empty() const { return m_count == 0; }
+
+    void push(const T& value) {
+      if (m_count < INLINE_SIZE) {
+        m_inline[m_count] = value;
+      } else {
+        m_overflow.push_back(value);
+      }
+      m_count++;
+    }
+
+    T pop() {
+      m_count--;
+      if (m_count < INLINE_SIZE) return m_inline[m_count];
+
+      T value = m_overflow.back();
+      m_overflow.pop_back();
+      return value;
+    }
+
+  private:
+    static constexpr size_t INLINE_SIZE = 256;
+
+    T m_inline[INLINE_SIZE];
+    std::vector<T> m_overflow;
+    size_t m_count = 0;
+  };
+
+  struct Node {
+    AABB aabb;
+    uint32_t parent = NULL_NODE;
+    uint32_t child1 = NULL_NODE;
+    uint32_t child2 = NULL_NODE;
+    int32_t height = -1;
+    uint32_t userData = NULL_NODE;
+
+    bool isLeaf() const { return child1 == NULL_NODE; }
+  };
+
+  std::vector<Node> m_nodes;
+  uint32_t m_root = NULL_NODE;
+  uint32_t m_freeList = NULL_NODE;
+  size_t m_proxyCount = 0;
+  float m_margin;
+
+  uint32_t allocateNode();
+  void freeNode(uint32_t node);
+
+  void insertLeaf(uint32_t leaf);
+  void removeLeaf(uint32_t leaf);
+  uint32_t balance(uint32_t node);
+  void refit(uint32_t node);
+
+  static AABB combine(const AABB& a, const AABB& b) {
+    return AABB(glm::min(a.min, b.min), glm::max(a.max, b.max));
+  }
+
+  static float perimeter(const AABB& aabb) {
+    glm::vec2 size = aabb.max - aabb.min;
+    return 2.0f * (size.x + size.y);
+  }
+
+  static bool contains(const AABB& outer, const AABB& inner) {
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y &&
+           inner.max.x <= outer.max.x && inner.max.y <= outer.max.y;
+  }
+};
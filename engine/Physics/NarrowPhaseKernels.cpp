@@ -0,0 +1,92 @@
+#include "NarrowPhaseKernels.hpp"
+#include "BodyStorage.hpp"
+#include "Simd.hpp"
+
+namespace {
+  void collideCirclePair(const float* positions, const float* extents, const CirclePairBatch& batch, uint32_t i,
+                         CircleContactBatch& contacts) {
+    const size_t a = batch.bodyA[i];
+    const size_t b = batch.bodyB[i];
+    float dx = positions[2 * b] - positions[2 * a];
+    float dy = positions[2 * b + 1] - positions[2 * a + 1];
+    float distanceSquared = dx * dx + dy * dy;
+    float radiusSum = extents[2 * a] + extents[2 * b];
+
+    if (distanceSquared > radiusSum * radiusSum) {
+      return;
+    }
+
+    float distance = std::sqrt(distanceSquared);
+    uint32_t out = contacts.count++;
+    contacts.nx[out] = distance > 0.0f ? dx / distance : 1.0f;
+    contacts.ny[out] = distance > 0.0f ? dy / distance : 0.0f;
+    contacts.penetration[out] = radiusSum - distance;
+    contacts.pair[out] = i;
+  }
+}
+
+uint32_t collideCircleBatch(const BodyStorage& bodies, const CirclePairBatch& batch, CircleContactBatch& contacts) {
+  using L = SimdLanes;
+
+  const float* positions = reinterpret_cast<const float*>(bodies.positions.data());
+  const float* extents = reinterpret_cast<const float*>(bodies.shapeExtents.data());
+
+  contacts.count = 0;
+  const uint32_t count = static_cast<uint32_t>(batch.count);
+
+  uint32_t i = 0;
+  if (L::WIDTH > 1) {
+    const L::Float zero = L::set(0.0f);
+    const L::Float one = L::set(1.0f);
+
+    float nx[L::WIDTH];
+    float ny[L::WIDTH];
+    float penetration[L::WIDTH];
+
+    // Bodies are gathered straight into registers. Copying them into SoA
+    // arrays first costs more stores per pair than the whole scalar test.
+    for (; i + L::WIDTH <= count; i += L::WIDTH) {
+      L::Float ax, ay, bx, by;
+      L::gatherPairs(positions, batch.bodyA + i, ax, ay);
+      L::gatherPairs(positions, batch.bodyB + i, bx, by);
+      L::Float dx = L::sub(bx, ax);
+      L::Float dy = L::sub(by, ay);
+      L::Float distanceSquared = L::add(L::mul(dx, dx), L::mul(dy, dy));
+      L::Float radiusSum = L::add(L::gatherX(extents, batch.bodyA + i), L::gatherX(extents, batch.bodyB + i));
+
+      uint32_t hits = L::mask(L::lessEqual(distanceSquared, L::mul(radiusSum, radiusSum)));
+      if (hits == 0) continue;
+
+      // Coincident centres take the scalar path's fallback normal (1, 0);
+      // the division result for those lanes is discarded.
+      L::Float distance = L::sqrt(distanceSquared);
+      L::Float separated = L::greater(distance, zero);
+      L::store(nx, L::select(separated, L::div(dx, distance), one));
+      L::store(ny, L::select(separated, L::div(dy, distance), zero));
+      L::store(penetration, L::sub(radiusSum, distance));
+
+      // Masked compress: every lane is written at the current end of the
+      // output and only hits advance it. contacts.count never exceeds i,
+      // so the lanes past the end stay inside the arrays.
+      uint32_t out = contacts.count;
+      for (uint32_t lane = 0; lane < L::WIDTH; ++lane) {
+        contacts.nx[out] = nx[lane];
+        contacts.ny[out] = ny[lane];
+        contacts.penetration[out] = penetration[lane];
+        contacts.pair[out] = i + lane;
+        out += (hits >> lane) & 1u;
+      }
+      contacts.count = out;
+    }
+  }
+
+  for (; i < count; ++i) {
+    collideCirclePair(positions, extents, batch, i, contacts);
+  }
+
+  return contacts.count;
+}
+
+const char* getNarrowPhaseKernelName() {
+  return SimdLanes::NAME;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct BodyStorage;
+
+// Circle pairs queued as dense body indices. collideCircleBatch() gathers
+// their positions and radii from the body storage straight into vector
+// registers, so the narrow phase only writes two indices per pair and no
+// per-pair copy of the body data is made.
+struct CirclePairBatch {
+  static constexpr uint32_t CAPACITY = 256;
+
+  uint32_t bodyA[CAPACITY];
+  uint32_t bodyB[CAPACITY];
+  size_t count = 0;
+
+  bool full() const { return count == CAPACITY; }
+  void clear() { count = 0; }
+
+  void push(uint32_t a, uint32_t b) {
+    bodyA[count] = a;
+    bodyB[count] = b;
+    count++;
+  }
+};
+
+// Compacted output: only overlapping pairs are written, in batch order.
+// pair[] indexes back into the CirclePairBatch.
+struct CircleContactBatch {
+  float nx[CirclePairBatch::CAPACITY];
+  float ny[CirclePairBatch::CAPACITY];
+  float penetration[CirclePairBatch::CAPACITY];
+  uint32_t pair[CirclePairBatch::CAPACITY];
+  uint32_t count = 0;
+};
+
+// Same results as circleVsCircle() for every pair, computed
+// SimdLanes::WIDTH pairs at a time. Returns the number of contacts.
+uint32_t collideCircleBatch(const BodyStorage& bodies, const CirclePairBatch& batch, CircleContactBatch& contacts);
+
+const char* getNarrowPhaseKernelName();
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "body.hpp"
+#include "PairTable.hpp"
+#include <vector>
+
+// Persistent set of overlapping proxy pairs for broad phases that find
+// pairs incrementally. Additions and removals are staged until finalize(),
+// which applies them and appends the net begin/end deltas to the lists
+// collected since the last resetDeltas().
+class PairManager {
+public:
+  static constexpr uint32_t INVALID = 0xFFFFFFFFu;
+
+  void addPair(uint32_t proxyA, uint32_t proxyB) {
+    uint64_t key = BodyPair(proxyA, proxyB).key();
+
+    bool inserted = false;
+    PairState& state = m_pairs.insert(key, &inserted);
+    if (inserted) {
+      state = PairState::PENDING_ADD;
+      m_touchedPairs.push_back(key);
+    } else if (state == PairState::PENDING_REMOVE) {
+      state = PairState::ACTIVE;
+    }
+  }
+
+  void removePair(uint32_t proxyA, uint32_t proxyB) {
+    uint64_t key = BodyPair(proxyA, proxyB).key();
+
+    PairState* state = m_pairs.find(key);
+    if (!state) return;
+
+    if (*state == PairState::ACTIVE) {
+      *state = PairState::PENDING_REMOVE;
+      m_touchedPairs.push_back(key);
+    } else if (*state == PairState::PENDING_ADD) {
+      m_pairs.erase(key);
+    }
+  }
+
+  // bodyOf maps a proxy id to its dense body index, or INVALID once the
+  // proxy has been destroyed. Pairs that lost a body are dropped without an
+  // end event because the index no longer names a body.
+  template<typename F>
+  void finalize(F&& bodyOf) {
+    for (uint64_t key : m_touchedPairs) {
+      PairState* state = m_pairs.find(key);
+      if (!state) continue;
+
+      uint32_t bodyA = bodyOf(static_cast<uint32_t>(key >> 32));
+      uint32_t bodyB = bodyOf(static_cast<uint32_t>(key & 0xFFFFFFFFu));
+
+      if (*state == PairState::PENDING_ADD) {
+        *state = PairState::ACTIVE;
+        m_begunPairs.emplace_back(bodyA, bodyB);
+      } else if (*state == PairState::PENDING_REMOVE) {
+        m_pairs.erase(key);
+        if (bodyA != INVALID && bodyB != INVALID) {
+          m_endedPairs.emplace_back(bodyA, bodyB);
+        }
+      }
+    }
+
+    m_touchedPairs.clear();
+  }
+
+  void resetDeltas() {
+    m_begunPairs.clear();
+    m_endedPairs.clear();
+  }
+
+  // f(proxyA, proxyB) for every pair, staged or not. Pairs must not be
+  // added or removed while this runs.
+  template<typename F>
+  void forEachPair(F&& f) const {
+    m_pairs.forEach([&f](uint64_t key, PairState) {
+      f(static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key & 0xFFFFFFFFu));
+    });
+  }
+
+  const std::vector<BodyPair>& getBegunPairs() const { return m_begunPairs; }
+  const std::vector<BodyPair>& getEndedPairs() const { return m_endedPairs; }
+  size_t size() const { return m_pairs.size(); }
+
+  void clear() {
+    m_pairs.clear();
+    m_touchedPairs.clear();
+    m_begunPairs.clear();
+    m_endedPairs.clear();
+  }
+
+private:
+  enum class PairState : uint8_t {
+    ACTIVE,
+    PENDING_ADD,
+    PENDING_REMOVE
+  };
+
+  PairTable<PairState> m_pairs;
+  std::vector<uint64_t> m_touchedPairs;
+  std::vector<BodyPair> m_begunPairs;
+  std::vector<BodyPair> m_endedPairs;
+};
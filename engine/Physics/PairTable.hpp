@@ -0,0 +1,222 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+#include "Snapshot.hpp"
+
+// Open-addressed map from BodyPair::key() style 64-bit keys to a small value.
+// Linear probing with backward-shift deletion, so there are no tombstones
+// and storage is reused across clear().
+template<typename T>
+class PairTable {
+public:
+  PairTable() {
+    m_entries.resize(MIN_CAPACITY);
+    m_used.resize(MIN_CAPACITY, 0);
+  }
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  T* find(uint64_t key) {
+    const size_t mask = m_entries.size() - 1;
+    size_t slot = hashKey(key) & mask;
+
+    while (m_used[slot]) {
+      if (m_entries[slot].key == key) {
+        return &m_entries[slot].value;
+      }
+      slot = (slot + 1) & mask;
+    }
+
+    return nullptr;
+  }
+
+  const T* find(uint64_t key) const {
+    return const_cast<PairTable*>(this)->find(key);
+  }
+
+  T& insert(uint64_t key, bool* inserted = nullptr) {
+    if ((m_size + 1) * 2 > m_entries.size()) {
+      grow();
+    }
+
+    const size_t mask = m_entries.size() - 1;
+    size_t slot = hashKey(key) & mask;
+
+    while (m_used[slot]) {
+      if (m_entries[slot].key == key) {
+        if (inserted) *inserted = false;
+        return m_entries[slot].value;
+      }
+      slot = (slot + 1) & mask;
+    }
+
+    m_used[slot] = 1;
+    m_entries[slot].key = key;
+    m_entries[slot].value = T();
+    m_size++;
+
+    if (inserted) *inserted = true;
+    return m_entries[slot].value;
+  }
+
+  bool erase(uint64_t key) {
+    const size_t mask = m_entries.size() - 1;
+    size_t slot = hashKey(key) & mask;
+
+    while (m_used[slot] && m_entries[slot].key != key) {
+      slot = (slot + 1) & mask;
+    }
+
+    if (!m_used[slot]) {
+      return false;
+    }
+
+    size_t hole = slot;
+    size_t next = slot;
+    while (true) {
+      next = (next + 1) & mask;
+      if (!m_used[next]) break;
+
+      size_t home = hashKey(m_entries[next].key) & mask;
+      bool between = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+      if (!between) {
+        m_entries[hole] = m_entries[next];
+        hole = next;
+      }
+    }
+
+    m_used[hole] = 0;
+    m_size--;
+    return true;
+  }
+
+  // Only the occupancy bytes are reset; entries are overwritten on insert.
+  // A table that was mostly empty halves, so after a burst of pairs the
+  // capacity that clear(), forEach() and snapshots walk follows the live
+  // count back down. The storage is kept for the next burst.
+  void clear() {
+    if (m_entries.size() > MIN_CAPACITY && m_size * 8 < m_entries.size()) {
+      m_entries.resize(m_entries.size() / 2);
+      m_used.resize(m_used.size() / 2);
+    }
+    std::fill(m_used.begin(), m_used.end(), 0);
+    m_size = 0;
+  }
+
+  // Only used entries are saved: their slots in ascending order, then the
+  // entries themselves, so restoring puts them back without rehashing.
+  void saveState(SnapshotWriter& writer) const {
+    writer.write(static_cast<uint64_t>(m_entries.size()));
+    writer.write(static_cast<uint64_t>(m_size));
+    if (writer.counting()) {
+      writer.skip(m_size * (sizeof(uint32_t) + sizeof(Entry)));
+      return;
+    }
+    for (size_t slot = 0; slot < m_used.size(); ++slot) {
+      if (m_used[slot]) writer.write(static_cast<uint32_t>(slot));
+    }
+    for (size_t slot = 0; slot < m_used.size(); ++slot) {
+      if (m_used[slot]) writer.write(m_entries[slot]);
+    }
+  }
+
+  // Walks a saved table without loading it.
+  static bool checkState(SnapshotReader& reader) {
+    uint64_t capacity = 0;
+    uint64_t size = 0;
+    if (!reader.read(capacity) || !reader.read(size)) return false;
+    if (capacity < MIN_CAPACITY || capacity > 0x80000000ull || (capacity & (capacity - 1)) != 0 ||
+        size > capacity / 2) {
+      return false;
+    }
+
+    uint64_t minSlot = 0;
+    for (uint64_t i = 0; i < size; ++i) {
+      uint32_t slot = 0;
+      if (!reader.read(slot) || slot < minSlot || slot >= capacity) return false;
+      minSlot = static_cast<uint64_t>(slot) + 1;
+    }
+    return reader.skipArray<Entry>(static_cast<size_t>(size));
+  }
+
+  // Loads a table that checkState() accepted.
+  void restoreState(SnapshotReader& reader) {
+    uint64_t capacity = 0;
+    uint64_t size = 0;
+    reader.read(capacity);
+    reader.read(size);
+    m_entries.resize(static_cast<size_t>(capacity));
+    m_used.assign(static_cast<size_t>(capacity), 0);
+
+    SnapshotReader entries = reader;
+    entries.skipArray<uint32_t>(static_cast<size_t>(size));
+    for (uint64_t i = 0; i < size; ++i) {
+      uint32_t slot = 0;
+      reader.read(slot);
+      entries.read(m_entries[slot]);
+      m_used[slot] = 1;
+    }
+    reader = entries;
+    m_size = static_cast<size_t>(size);
+  }
+
+  template<typename F>
+  void forEach(F&& f) {
+    for (size_t slot = 0; slot < m_entries.size(); ++slot) {
+      if (m_used[slot]) f(m_entries[slot].key, m_entries[slot].value);
+    }
+  }
+
+  template<typename F>
+  void forEach(F&& f) const {
+    for (size_t slot = 0; slot < m_entries.size(); ++slot) {
+      if (m_used[slot]) f(m_entries[slot].key, m_entries[slot].value);
+    }
+  }
+
+private:
+  static constexpr size_t MIN_CAPACITY = 64;
+
+  struct Entry {
+    uint64_t key = 0;
+    T value = T();
+  };
+
+  // Occupancy lives apart from the entries, so clearing and scanning the
+  // table only touch one byte per slot.
+  std::vector<Entry> m_entries;
+  std::vector<uint8_t> m_used;
+  std::vector<Entry> m_scratch;
+  std::vector<uint8_t> m_scratchUsed;
+  size_t m_size = 0;
+
+  static size_t hashKey(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDull;
+    key ^= key >> 33;
+    return static_cast<size_t>(key);
+  }
+
+  void grow() {
+    m_scratch.swap(m_entries);
+    m_scratchUsed.swap(m_used);
+    m_entries.assign(m_scratch.size() * 2, Entry());
+    m_used.assign(m_scratch.size() * 2, 0);
+
+    const size_t mask = m_entries.size() - 1;
+    for (size_t i = 0; i < m_scratch.size(); ++i) {
+      if (!m_scratchUsed[i]) continue;
+
+      size_t slot = hashKey(m_scratch[i].key) & mask;
+      while (m_used[slot]) {
+        slot = (slot + 1) & mask;
+      }
+      m_entries[slot] = m_scratch[i];
+      m_used[slot] = 1;
+    }
+  }
+};
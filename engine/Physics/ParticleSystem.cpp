@@ -0,0 +1,511 @@
+#include "ParticleSystem.hpp"
+#include "Physics.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+ParticleSystem::ParticleSystem(float radius) : m_radius(radius) {
+  if (m_radius <= 0.0f) {
+    WARLOG("Particle radius must be positive, using 1");
+    m_radius = 1.0f;
+  }
+}
+
+void ParticleSystem::addParticle(const glm::vec2& position, const glm::vec2& velocity) {
+  m_positions.push_back(position);
+  m_velocities.push_back(velocity);
+  m_stepStart.push_back(position);
+}
+
+void ParticleSystem::reserve(size_t count) {
+  m_positions.reserve(count);
+  m_velocities.reserve(count);
+  m_stepStart.reserve(count);
+}
+
+void ParticleSystem::clear() {
+  m_positions.clear();
+  m_velocities.clear();
+  m_stepStart.clear();
+  m_cellCount = 0;
+  m_contactCount = 0;
+}
+
+void ParticleSystem::addBoundaryPlane(const glm::vec2& normal, float offset) {
+  float length = glm::length(normal);
+  if (length <= 0.0f) {
+    WARLOG("Ignoring boundary plane with zero normal");
+    return;
+  }
+
+  m_boundaryPlanes.push_back({normal / length, offset / length});
+}
+
+void ParticleSystem::clearBoundaryPlanes() {
+  m_boundaryPlanes.clear();
+}
+
+void ParticleSystem::setSubstepCount(int substeps) {
+  m_config.substeps = std::max(1, substeps);
+}
+
+void ParticleSystem::setRestitution(float restitution) {
+  m_config.restitution = std::clamp(restitution, 0.0f, 1.0f);
+}
+
+void ParticleSystem::setFriction(float friction) {
+  m_config.friction = std::clamp(friction, 0.0f, 1.0f);
+}
+
+void ParticleSystem::setDamping(float damping) {
+  m_config.damping = std::clamp(damping, 0.0f, 1.0f);
+}
+
+template<typename F>
+void ParticleSystem::parallelFor(uint32_t count, uint32_t grainSize, const F& function) {
+  if (count == 0) return;
+  if (!m_jobSystem || count <= grainSize) {
+    function(0, count, 0);
+    return;
+  }
+  m_jobSystem->parallelFor(count, grainSize, function);
+}
+
+void ParticleSystem::update(float dt) {
+  if (dt <= 0.0f || m_positions.empty()) return;
+
+  const uint32_t count = static_cast<uint32_t>(m_positions.size());
+  m_nextPositions.resize(count);
+  m_nextVelocities.resize(count);
+  m_particleCells.resize(count);
+  m_sortedCells.resize(count);
+  m_order.resize(count);
+
+  gatherColliders();
+  buildGrid(dt);
+
+  // Unit mass particles: the stiffness makes a contact last CONTACT_SUBSTEPS
+  // substeps, and the damping gives the configured restitution.
+  const float h = dt / static_cast<float>(m_config.substeps);
+  const float frequency = 3.14159265f / (static_cast<float>(CONTACT_SUBSTEPS) * h);
+  const float logRestitution = std::log(std::max(m_config.restitution, 1e-4f));
+  const float dampingRatio = -logRestitution / std::sqrt(9.8696044f + logRestitution * logRestitution);
+  m_stiffness = frequency * frequency;
+  m_contactDamping = 2.0f * dampingRatio * frequency;
+
+  m_substepDamping = std::pow(m_config.damping, h);
+  m_neighbourHorizon = dt;
+  if (m_config.substeps > 1) {
+    m_neighbourCounts.resize(count);
+    m_neighbours.resize(static_cast<size_t>(count) * MAX_NEIGHBOURS);
+  }
+
+  // The first substep scans the grid and keeps each particle's near
+  // neighbours; the others only walk those lists.
+  const size_t threadCount = m_jobSystem ? m_jobSystem->getThreadCount() : 1;
+  m_threadContacts.assign(threadCount, 0);
+  for (int substep = 0; substep < m_config.substeps; ++substep) {
+    if (substep == 0) {
+      const bool keepNeighbours = m_config.substeps > 1;
+      parallelFor(count, PARTICLE_GRAIN_SIZE, [this, h, keepNeighbours](uint32_t begin, uint32_t end, uint32_t thread) {
+        uint32_t contacts = 0;
+        solveGridContacts(begin, end, h, keepNeighbours, contacts);
+        m_threadContacts[thread] += contacts;
+      });
+    } else {
+      parallelFor(count, PARTICLE_GRAIN_SIZE, [this, h](uint32_t begin, uint32_t end, uint32_t) {
+        solveNeighbourContacts(begin, end, h);
+      });
+    }
+    m_positions.swap(m_nextPositions);
+    m_velocities.swap(m_nextVelocities);
+    solveColliders();
+  }
+
+  m_contactCount = 0;
+  for (uint32_t contacts : m_threadContacts) {
+    m_contactCount += contacts;
+  }
+  m_contactCount /= 2;
+}
+
+void ParticleSystem::gatherColliders() {
+  m_colliders.clear();
+  if (!m_world) return;
+
+  const BodyStorage& bodies = m_world->getBodyStorage();
+  for (size_t i = bodies.staticBegin(); i < bodies.size(); ++i) {
+    if (!bodies.active[i]) continue;
+
+    Collider collider;
+    collider.shapeType = bodies.shapeTypes[i];
+    collider.position = bodies.positions[i];
+    collider.extent = bodies.shapeExtents[i];
+    collider.axis = {std::cos(bodies.rotations[i]), std::sin(bodies.rotations[i])};
+    collider.aabb = bodies.aabbs[i];
+    m_colliders.push_back(collider);
+  }
+}
+
+// Counting sort by the cell of each particle's position halfway through the
+// step, extrapolated from its velocity, so the grid fits the substeps that
+// follow: count per cell, prefix sum into cell starts, scatter. Scattering
+// with atomic cursors leaves each cell's particles in arbitrary order, so
+// every cell is then sorted by the particles' previous index. Particles
+// mostly stay in their cell from one step to the next, so those runs are
+// short and nearly sorted already.
+void ParticleSystem::buildGrid(float dt) {
+  const uint32_t count = static_cast<uint32_t>(m_positions.size());
+  const size_t threadCount = m_jobSystem ? m_jobSystem->getThreadCount() : 1;
+
+  // The extrapolated positions go into m_nextPositions until the sort.
+  const float infinity = std::numeric_limits<float>::max();
+  m_threadBounds.assign(threadCount, Bounds{glm::vec2(infinity), glm::vec2(-infinity)});
+  parallelFor(count, PARTICLE_GRAIN_SIZE, [this, dt](uint32_t begin, uint32_t end, uint32_t thread) {
+    Bounds bounds = m_threadBounds[thread];
+    for (uint32_t i = begin; i < end; ++i) {
+      const glm::vec2 predicted = m_positions[i] + m_velocities[i] * (0.5f * dt);
+      m_nextPositions[i] = predicted;
+      bounds.min = glm::min(bounds.min, predicted);
+      bounds.max = glm::max(bounds.max, predicted);
+    }
+    m_threadBounds[thread] = bounds;
+  });
+
+  Bounds bounds = m_threadBounds[0];
+  for (const Bounds& threadBounds : m_threadBounds) {
+    bounds.min = glm::min(bounds.min, threadBounds.min);
+    bounds.max = glm::max(bounds.max, threadBounds.max);
+  }
+
+  // Cells are one diameter wide unless scattered particles would need far
+  // more cells than particles; wider cells stay correct, only slower.
+  const glm::vec2 span = bounds.max - bounds.min;
+  const float cellLimit = 4.0f * static_cast<float>(count) + 4096.0f;
+  m_cellSize = 2.0f * m_radius;
+  while ((span.x / m_cellSize + 4.0f) * (span.y / m_cellSize + 4.0f) > cellLimit) {
+    m_cellSize *= 1.5f;
+  }
+  // A cell and a half of padding keeps rounding far from the origin from
+  // putting a particle into the border.
+  m_inverseCellSize = 1.0f / m_cellSize;
+  m_gridOrigin = bounds.min - glm::vec2(1.5f * m_cellSize);
+  m_gridWidth = static_cast<uint32_t>(span.x * m_inverseCellSize) + 4;
+  m_gridHeight = static_cast<uint32_t>(span.y * m_inverseCellSize) + 4;
+  m_cellCount = static_cast<size_t>(m_gridWidth) * m_gridHeight;
+
+  const uint32_t cellCount = static_cast<uint32_t>(m_cellCount);
+  if (m_cellCursorCapacity < m_cellCount) {
+    m_cellCursorCapacity = m_cellCount + m_cellCount / 2;
+    m_cellCursors.reset(new std::atomic<uint32_t>[m_cellCursorCapacity]);
+  }
+  m_cellStarts.resize(m_cellCount + 1);
+
+  parallelFor(cellCount, CELL_GRAIN_SIZE, [this](uint32_t begin, uint32_t end, uint32_t) {
+    for (uint32_t c = begin; c < end; ++c) {
+      m_cellCursors[c].store(0, std::memory_order_relaxed);
+    }
+  });
+
+  parallelFor(count, PARTICLE_GRAIN_SIZE, [this](uint32_t begin, uint32_t end, uint32_t) {
+    for (uint32_t i = begin; i < end; ++i) {
+      const uint32_t cell = cellY(m_nextPositions[i].y) * m_gridWidth + cellX(m_nextPositions[i].x);
+      m_particleCells[i] = cell;
+      m_cellCursors[cell].fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+
+  // Exclusive prefix sum in blocks: block totals, a serial scan over the
+  // few totals, then each block scans its own cells.
+  const uint32_t blockCount = (cellCount + CELL_GRAIN_SIZE - 1) / CELL_GRAIN_SIZE;
+  m_blockSums.resize(blockCount);
+  parallelFor(blockCount, 1, [this, cellCount](uint32_t begin, uint32_t end, uint32_t) {
+    for (uint32_t block = begin; block < end; ++block) {
+      const uint32_t last = std::min(cellCount, (block + 1) * CELL_GRAIN_SIZE);
+      uint32_t sum = 0;
+      for (uint32_t c = block * CELL_GRAIN_SIZE; c < last; ++c) {
+        sum += m_cellCursors[c].load(std::memory_order_relaxed);
+      }
+      m_blockSums[block] = sum;
+    }
+  });
+
+  uint32_t offset = 0;
+  for (uint32_t& sum : m_blockSums) {
+    const uint32_t blockSum = sum;
+    sum = offset;
+    offset += blockSum;
+  }
+
+  parallelFor(blockCount, 1, [this, cellCount](uint32_t begin, uint32_t end, uint32_t) {
+    for (uint32_t block = begin; block < end; ++block) {
+      const uint32_t last = std::min(cellCount, (block + 1) * CELL_GRAIN_SIZE);
+      uint32_t start = m_blockSums[block];
+      for (uint32_t c = block * CELL_GRAIN_SIZE; c < last; ++c) {
+        const uint32_t cellParticles = m_cellCursors[c].load(std::memory_order_relaxed);
+        m_cellStarts[c] = start;
+        m_cellCursors[c].store(start, std::memory_order_relaxed);
+        start += cellParticles;
+      }
+    }
+  });
+  m_cellStarts[cellCount] = count;
+
+  parallelFor(count, PARTICLE_GRAIN_SIZE, [this](uint32_t begin, uint32_t end, uint32_t) {
+    for (uint32_t i = begin; i < end; ++i) {
+      m_order[m_cellCursors[m_particleCells[i]].fetch_add(1, std::memory_order_relaxed)] = i;
+    }
+  });
+
+  parallelFor(cellCount, CELL_GRAIN_SIZE, [this](uint32_t begin, uint32_t end, uint32_t) {
+    for (uint32_t c = begin; c < end; ++c) {
+      const uint32_t first = m_cellStarts[c];
+      const uint32_t last = m_cellStarts[c + 1];
+      for (uint32_t k = first + 1; k < last; ++k) {
+        const uint32_t particle = m_order[k];
+        uint32_t j = k;
+        for (; j > first && m_order[j - 1] > particle; --j) {
+          m_order[j] = m_order[j - 1];
+        }
+        m_order[j] = particle;
+      }
+    }
+  });
+
+  parallelFor(count, PARTICLE_GRAIN_SIZE, [this](uint32_t begin, uint32_t end, uint32_t) {
+    for (uint32_t k = begin; k < end; ++k) {
+      const uint32_t i = m_order[k];
+      m_stepStart[k] = m_positions[i];
+      m_nextVelocities[k] = m_velocities[i];
+      m_sortedCells[k] = m_particleCells[i];
+    }
+  });
+  m_positions.swap(m_stepStart);
+  m_velocities.swap(m_nextVelocities);
+  m_particleCells.swap(m_sortedCells);
+  std::copy(m_positions.begin(), m_positions.end(), m_stepStart.begin());
+}
+
+// Spring-damper contact force on particle i from particle j, if they
+// overlap and are not already separating fast enough to cancel the spring.
+// Friction opposes the tangential relative velocity, capped at friction
+// times the normal force.
+bool ParticleSystem::contactAcceleration(uint32_t i, uint32_t j, const glm::vec2& offset, float distanceSquared,
+                                         glm::vec2& acceleration) const {
+  const float diameter = 2.0f * m_radius;
+  glm::vec2 normal;
+  const float distance = std::sqrt(distanceSquared);
+  if (distance > 0.0f) {
+    normal = offset / distance;
+  } else {
+    // Coincident particles separate vertically, by index.
+    normal = glm::vec2(0.0f, i < j ? -1.0f : 1.0f);
+  }
+
+  const glm::vec2 relativeVelocity = m_velocities[i] - m_velocities[j];
+  const float normalSpeed = glm::dot(relativeVelocity, normal);
+  const float normalForce = m_stiffness * (diameter - distance) - m_contactDamping * normalSpeed;
+  if (normalForce <= 0.0f) return false;
+
+  acceleration += normal * normalForce;
+  const glm::vec2 tangentVelocity = relativeVelocity - normal * normalSpeed;
+  const float tangentSpeed = glm::length(tangentVelocity);
+  if (m_config.friction > 0.0f && tangentSpeed > 0.0f) {
+    acceleration -= tangentVelocity * (std::min(m_config.friction * normalForce, m_contactDamping * tangentSpeed) / tangentSpeed);
+  }
+  return true;
+}
+
+// Contacts of particles [begin, end) gathered from the three row spans
+// around each particle's cell. Only the particle's own next state is
+// written, so ranges run in parallel and the result does not depend on how
+// the particles were split. With keepNeighbours, every particle whose gap
+// could close within the step at the current relative speed, plus
+// NEIGHBOUR_SLACK, goes into the neighbour list for the later substeps.
+// A particle with more than MAX_NEIGHBOURS of them is marked to scan the
+// grid again instead.
+void ParticleSystem::solveGridContacts(uint32_t begin, uint32_t end, float h, bool keepNeighbours, uint32_t& contacts) {
+  const float diameter = 2.0f * m_radius;
+  const float diameterSquared = diameter * diameter;
+  const float baseReach = diameter + NEIGHBOUR_SLACK * m_radius;
+
+  for (uint32_t i = begin; i < end; ++i) {
+    const glm::vec2 position = m_positions[i];
+    const glm::vec2 velocity = m_velocities[i];
+    const uint32_t cell = m_particleCells[i];
+    // Every candidate is written and only the near ones are counted, which
+    // costs less than a branch that goes either way.
+    uint32_t neighbours[MAX_NEIGHBOURS + 1] = {};
+    uint32_t neighbourCount = 0;
+
+    glm::vec2 acceleration = m_config.gravity;
+    for (uint32_t row = cell - m_gridWidth; row <= cell + m_gridWidth; row += m_gridWidth) {
+      const uint32_t last = m_cellStarts[row + 2];
+      for (uint32_t j = m_cellStarts[row - 1]; j < last; ++j) {
+        if (j == i) continue;
+        const glm::vec2 offset = position - m_positions[j];
+        const float distanceSquared = glm::dot(offset, offset);
+
+        if (keepNeighbours) {
+          const float reach = baseReach + glm::length(velocity - m_velocities[j]) * m_neighbourHorizon;
+          neighbours[std::min(neighbourCount, MAX_NEIGHBOURS)] = j;
+          neighbourCount += distanceSquared < reach * reach ? 1 : 0;
+        }
+
+        if (distanceSquared < diameterSquared && contactAcceleration(i, j, offset, distanceSquared, acceleration)) {
+          contacts++;
+        }
+      }
+    }
+
+    if (keepNeighbours) {
+      std::copy_n(neighbours, MAX_NEIGHBOURS, &m_neighbours[static_cast<size_t>(i) * MAX_NEIGHBOURS]);
+      m_neighbourCounts[i] = static_cast<uint8_t>(std::min(neighbourCount, MAX_NEIGHBOURS + 1));
+    }
+    advance(i, acceleration, h);
+  }
+}
+
+void ParticleSystem::solveNeighbourContacts(uint32_t begin, uint32_t end, float h) {
+  const float diameterSquared = 4.0f * m_radius * m_radius;
+
+  for (uint32_t i = begin; i < end; ++i) {
+    const uint32_t neighbourCount = m_neighbourCounts[i];
+    if (neighbourCount > MAX_NEIGHBOURS) {
+      uint32_t contacts = 0;
+      solveGridContacts(i, i + 1, h, false, contacts);
+      continue;
+    }
+
+    const glm::vec2 position = m_positions[i];
+    const uint32_t* neighbours = &m_neighbours[static_cast<size_t>(i) * MAX_NEIGHBOURS];
+    glm::vec2 acceleration = m_config.gravity;
+    for (uint32_t k = 0; k < neighbourCount; ++k) {
+      const uint32_t j = neighbours[k];
+      const glm::vec2 offset = position - m_positions[j];
+      const float distanceSquared = glm::dot(offset, offset);
+      if (distanceSquared < diameterSquared) {
+        contactAcceleration(i, j, offset, distanceSquared, acceleration);
+      }
+    }
+    advance(i, acceleration, h);
+  }
+}
+
+// Writes particle i's state after a substep into the next buffers: damped
+// velocity, position, and the boundary planes.
+void ParticleSystem::advance(uint32_t i, const glm::vec2& acceleration, float h) {
+  glm::vec2 velocity = (m_velocities[i] + acceleration * h) * m_substepDamping;
+  glm::vec2 position = m_positions[i] + velocity * h;
+
+  for (const BoundaryPlane& plane : m_boundaryPlanes) {
+    const float distance = glm::dot(plane.normal, position) - plane.offset - m_radius;
+    if (distance < 0.0f) {
+      resolveStatic(position, velocity, plane.normal, -distance);
+    }
+  }
+
+  m_nextPositions[i] = position;
+  m_nextVelocities[i] = velocity;
+}
+
+// Pushes a particle out along normal by depth and takes out its velocity
+// into the surface, keeping restitution of it and losing tangential speed
+// in proportion to the normal impulse.
+void ParticleSystem::resolveStatic(glm::vec2& position, glm::vec2& velocity, const glm::vec2& normal, float depth) {
+  position += normal * depth;
+
+  const float normalSpeed = glm::dot(velocity, normal);
+  if (normalSpeed >= 0.0f) return;
+
+  const glm::vec2 tangentVelocity = velocity - normal * normalSpeed;
+  const float tangentSpeed = glm::length(tangentVelocity);
+  velocity = -normal * (normalSpeed * m_config.restitution);
+  if (tangentSpeed > 0.0f) {
+    const float kept = std::max(0.0f, 1.0f + m_config.friction * normalSpeed * (1.0f + m_config.restitution) / tangentSpeed);
+    velocity += tangentVelocity * kept;
+  }
+}
+
+// Colliders push particles out directly after each substep. Only the grid
+// rows and columns around a collider are visited, with a one-cell margin
+// for particles that moved since they were binned. Each particle belongs to
+// one row, so rows are processed in parallel; colliders one after another.
+void ParticleSystem::solveColliders() {
+  const float margin = m_radius + m_cellSize;
+  const float maxX = static_cast<float>(m_gridWidth - 1);
+  const float maxY = static_cast<float>(m_gridHeight - 1);
+
+  for (const Collider& collider : m_colliders) {
+    const float x0 = std::floor((collider.aabb.min.x - margin - m_gridOrigin.x) * m_inverseCellSize);
+    const float x1 = std::floor((collider.aabb.max.x + margin - m_gridOrigin.x) * m_inverseCellSize);
+    const float y0 = std::floor((collider.aabb.min.y - margin - m_gridOrigin.y) * m_inverseCellSize);
+    const float y1 = std::floor((collider.aabb.max.y + margin - m_gridOrigin.y) * m_inverseCellSize);
+    if (x1 < 0.0f || y1 < 0.0f || x0 > maxX || y0 > maxY) continue;
+
+    const uint32_t columnBegin = static_cast<uint32_t>(std::max(x0, 0.0f));
+    const uint32_t columnEnd = static_cast<uint32_t>(std::min(x1, maxX)) + 1;
+    const uint32_t rowBegin = static_cast<uint32_t>(std::max(y0, 0.0f));
+    const uint32_t rowEnd = static_cast<uint32_t>(std::min(y1, maxY)) + 1;
+
+    parallelFor(rowEnd - rowBegin, ROW_GRAIN_SIZE, [this, &collider, rowBegin, columnBegin, columnEnd](uint32_t begin, uint32_t end, uint32_t) {
+      solveCollider(collider, rowBegin + begin, rowBegin + end, columnBegin, columnEnd);
+    });
+  }
+}
+
+void ParticleSystem::solveCollider(const Collider& collider, uint32_t rowBegin, uint32_t rowEnd, uint32_t columnBegin, uint32_t columnEnd) {
+  const float radius = m_radius;
+
+  for (uint32_t row = rowBegin; row < rowEnd; ++row) {
+    const uint32_t first = m_cellStarts[row * m_gridWidth + columnBegin];
+    const uint32_t last = m_cellStarts[row * m_gridWidth + columnEnd];
+    for (uint32_t i = first; i < last; ++i) {
+      const glm::vec2 position = m_positions[i];
+      if (position.x + radius < collider.aabb.min.x || position.x - radius > collider.aabb.max.x ||
+          position.y + radius < collider.aabb.min.y || position.y - radius > collider.aabb.max.y) {
+        continue;
+      }
+
+      const glm::vec2 offset = position - collider.position;
+      glm::vec2 resolved;
+      if (collider.shapeType == ShapeType::CIRCLE) {
+        const float reach = collider.extent.x + radius;
+        const float distanceSquared = glm::dot(offset, offset);
+        if (distanceSquared >= reach * reach) continue;
+
+        const float distance = std::sqrt(distanceSquared);
+        resolved = collider.position + (distance > 0.0f ? offset / distance : glm::vec2(0.0f, -1.0f)) * reach;
+      } else {
+        const glm::vec2& axis = collider.axis;
+        const glm::vec2& half = collider.extent;
+        glm::vec2 local(offset.x * axis.x + offset.y * axis.y, -offset.x * axis.y + offset.y * axis.x);
+        const glm::vec2 closest = glm::clamp(local, -half, half);
+
+        if (closest == local) {
+          // Inside: out through the nearest face.
+          const float depthX = half.x - std::abs(local.x);
+          const float depthY = half.y - std::abs(local.y);
+          if (depthX < depthY) {
+            local.x = std::copysign(half.x + radius, local.x);
+          } else {
+            local.y = std::copysign(half.y + radius, local.y);
+          }
+        } else {
+          const glm::vec2 outside = local - closest;
+          const float distanceSquared = glm::dot(outside, outside);
+          if (distanceSquared >= radius * radius) continue;
+          local = closest + outside * (radius / std::sqrt(distanceSquared));
+        }
+
+        resolved = collider.position + glm::vec2(local.x * axis.x - local.y * axis.y, local.x * axis.y + local.y * axis.x);
+      }
+
+      const glm::vec2 push = resolved - position;
+      const float depth = glm::length(push);
+      if (depth > 0.0f) {
+        resolveStatic(m_positions[i], m_velocities[i], push / depth, depth);
+      }
+    }
+  }
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "BodyStorage.hpp"
+#include "Core/JobSystem.hpp"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class PhysicsEngine;
+
+// Equal-radius circle particles for granular and fluid-like scenes with far
+// more bodies than RigidBody can carry. Particles have no identity: they are
+// plain structure-of-arrays positions and velocities, and every step
+// reorders them by grid cell so that neighbours sit next to each other in
+// memory. Indices are only meaningful until the next update().
+//
+// A step bins the particles into a uniform grid of particle-diameter cells
+// with a parallel counting sort, then runs a few substeps of soft
+// spring-damper contacts. The first substep reads the three row spans of
+// the 3x3 cells around a particle and keeps the few neighbours it could
+// touch during the step; later substeps only visit those. Each substep
+// writes a particle's next position and velocity into second buffers, so
+// particles are processed in parallel without locks and results do not
+// depend on the thread count. The contact stiffness follows the
+// substep length, so a pile's overlap under its own weight shrinks with the
+// square of the substep count.
+//
+// Particles collide with the active static bodies of an optional
+// PhysicsEngine and with their own boundary planes. They do not push
+// dynamic bodies.
+class ParticleSystem {
+public:
+  explicit ParticleSystem(float radius);
+
+  ParticleSystem(const ParticleSystem&) = delete;
+  ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+  void addParticle(const glm::vec2& position, const glm::vec2& velocity = glm::vec2(0.0f));
+  void reserve(size_t count);
+  void clear();
+  size_t size() const { return m_positions.size(); }
+  float getRadius() const { return m_radius; }
+
+  const std::vector<glm::vec2>& getPositions() const { return m_positions; }
+  const std::vector<glm::vec2>& getVelocities() const { return m_velocities; }
+  // Positions at the start of the last step, in the same order as
+  // getPositions(), for interpolated rendering.
+  const std::vector<glm::vec2>& getStepStartPositions() const { return m_stepStart; }
+
+  // Static bodies of world are re-read every step. Not owned.
+  void setWorld(const PhysicsEngine* world) { m_world = world; }
+  // Keeps particles on the side where dot(normal, p) >= offset.
+  void addBoundaryPlane(const glm::vec2& normal, float offset);
+  void clearBoundaryPlanes();
+
+  void setGravity(const glm::vec2& gravity) { m_config.gravity = gravity; }
+  // The grid is built once per update() for all substeps.
+  void setSubstepCount(int substeps);
+  void setRestitution(float restitution);
+  // Coulomb coefficient for particle and collider contacts.
+  void setFriction(float friction);
+  // Fraction of the velocity kept per second.
+  void setDamping(float damping);
+  // Not owned. Without a job system the step runs on the calling thread.
+  void setJobSystem(JobSystem* jobSystem) { m_jobSystem = jobSystem; }
+
+  void update(float dt);
+
+  size_t getCellCount() const { return m_cellCount; }
+  // Overlapping particle pairs found in the first substep of the last step.
+  size_t getContactCount() const { return m_contactCount; }
+
+private:
+  struct Config {
+    glm::vec2 gravity = {0.0f, 9.81f};
+    int substeps = 4;
+    float restitution = 0.1f;
+    float friction = 0.3f;
+    float damping = 0.99f;
+  };
+
+  struct BoundaryPlane {
+    glm::vec2 normal;
+    float offset;
+  };
+
+  struct Collider {
+    ShapeType shapeType;
+    glm::vec2 position;
+    glm::vec2 extent;
+    glm::vec2 axis;  // cos and sin of the rotation
+    AABB aabb;
+  };
+
+  struct Bounds {
+    glm::vec2 min;
+    glm::vec2 max;
+  };
+
+  static constexpr uint32_t PARTICLE_GRAIN_SIZE = 8192;
+  static constexpr uint32_t CELL_GRAIN_SIZE = 16384;
+  static constexpr uint32_t ROW_GRAIN_SIZE = 4;
+  static constexpr int CONTACT_SUBSTEPS = 8;
+  static constexpr uint32_t MAX_NEIGHBOURS = 8;
+  // Extra reach of the neighbour lists, in radii, for contacts that start
+  // from velocity picked up during the step.
+  static constexpr float NEIGHBOUR_SLACK = 0.5f;
+
+  template<typename F>
+  void parallelFor(uint32_t count, uint32_t grainSize, const F& function);
+
+  void gatherColliders();
+  void buildGrid(float dt);
+  bool contactAcceleration(uint32_t i, uint32_t j, const glm::vec2& offset, float distanceSquared,
+                           glm::vec2& acceleration) const;
+  void solveGridContacts(uint32_t begin, uint32_t end, float h, bool keepNeighbours, uint32_t& contacts);
+  void solveNeighbourContacts(uint32_t begin, uint32_t end, float h);
+  void advance(uint32_t i, const glm::vec2& acceleration, float h);
+  void solveColliders();
+  void solveCollider(const Collider& collider, uint32_t rowBegin, uint32_t rowEnd, uint32_t columnBegin, uint32_t columnEnd);
+  void resolveStatic(glm::vec2& position, glm::vec2& velocity, const glm::vec2& normal, float depth);
+
+  uint32_t cellX(float x) const { return static_cast<uint32_t>((x - m_gridOrigin.x) * m_inverseCellSize); }
+  uint32_t cellY(float y) const { return static_cast<uint32_t>((y - m_gridOrigin.y) * m_inverseCellSize); }
+
+  float m_radius;
+  Config m_config;
+  JobSystem* m_jobSystem = nullptr;
+  const PhysicsEngine* m_world = nullptr;
+
+  std::vector<glm::vec2> m_positions;
+  std::vector<glm::vec2> m_velocities;
+  std::vector<glm::vec2> m_stepStart;
+  // Substep output and sort scratch.
+  std::vector<glm::vec2> m_nextVelocities;
+  std::vector<glm::vec2> m_nextPositions;
+  float m_stiffness = 0.0f;
+  float m_contactDamping = 0.0f;
+  float m_substepDamping = 1.0f;
+  float m_neighbourHorizon = 0.0f;
+  // MAX_NEIGHBOURS slots per particle, filled by the first substep. A count
+  // above MAX_NEIGHBOURS means the list overflowed.
+  std::vector<uint32_t> m_neighbours;
+  std::vector<uint8_t> m_neighbourCounts;
+
+  std::vector<BoundaryPlane> m_boundaryPlanes;
+  std::vector<Collider> m_colliders;
+
+  // Grid with a border of empty cells around the particles, so the 3x3 block
+  // of every occupied cell is inside it. Cell c holds the particles
+  // [m_cellStarts[c], m_cellStarts[c + 1]); a row of adjacent cells is one
+  // contiguous span.
+  glm::vec2 m_gridOrigin = glm::vec2(0.0f);
+  float m_cellSize = 0.0f;
+  float m_inverseCellSize = 0.0f;
+  uint32_t m_gridWidth = 0;
+  uint32_t m_gridHeight = 0;
+  size_t m_cellCount = 0;
+  std::vector<uint32_t> m_cellStarts;
+  std::vector<uint32_t> m_particleCells;
+  std::vector<uint32_t> m_sortedCells;
+  std::vector<uint32_t> m_order;
+  std::unique_ptr<std::atomic<uint32_t>[]> m_cellCursors;
+  size_t m_cellCursorCapacity = 0;
+  std::vector<uint32_t> m_blockSums;
+  std::vector<Bounds> m_threadBounds;
+  std::vector<uint32_t> m_threadContacts;
+  size_t m_contactCount = 0;
+};
@@ -1,66 +1,230 @@
 #include "Physics.hpp"
+#include "Simd.hpp"
+#include <algorithm>
+#include <chrono>
 
-void VerletSolver::integrate(std::vector<RigidBody>& bodies, float dt) {
-  for(auto& body : bodies) {
-    if(body.type == BodyType::STATIC || !body.active) continue;
+// Integrators run over a range of active, non-static bodies; BodyStorage
+// keeps those in a dense prefix. The linear part streams the interleaved
+// vec2 arrays SimdLanes::WIDTH / 2 bodies per vector and the angular part
+// the float arrays SimdLanes::WIDTH bodies per vector. The scalar tails use
+// the same operation order, so results do not depend on how the range was
+// split.
+//
+// Verlet derives velocity from the position update so that the contact
+// solver and game code read the speed the body actually moved at.
+void VerletSolver::integrate(BodyStorage& bodies, size_t begin, size_t end, float dt) {
+  using L = SimdLanes;
 
-    body.applyForce(body.mass * m_gravity);
+  float* positions = reinterpret_cast<float*>(bodies.positions.data());
+  float* prevPositions = reinterpret_cast<float*>(bodies.prevPositions.data());
+  float* velocities = reinterpret_cast<float*>(bodies.velocities.data());
+  float* forces = reinterpret_cast<float*>(bodies.forces.data());
+  const float* invMasses = bodies.invMasses.data();
+  float* rotations = bodies.rotations.data();
+  float* angularVelocities = bodies.angularVelocities.data();
+  float* torques = bodies.torques.data();
+  const float* invInertias = bodies.invInertias.data();
 
-    glm::vec2 oldPosition = body.position;
+  size_t i = begin;
+  size_t j = begin;
+  if (L::WIDTH > 1) {
+    const L::Float gravity = L::setPair(m_gravity.x, m_gravity.y);
+    const L::Float step = L::set(dt);
+    const L::Float two = L::set(2.0f);
+    const L::Float zero = L::set(0.0f);
 
-    glm::vec2 acceleration = body.forceAccumulator * body.invMass;
-    body.velocity += acceleration * dt;
+    for (; i + L::WIDTH / 2 <= end; i += L::WIDTH / 2) {
+      const size_t f = 2 * i;
+      L::Float position = L::load(positions + f);
+      L::Float acceleration = L::add(L::mul(L::load(forces + f), L::loadPairs(invMasses + i)), gravity);
 
-    body.position = 2.0f * body.position - body.prevPosition + acceleration * dt * dt;
-    body.prevPosition = oldPosition;
+      L::Float next = L::add(L::sub(L::mul(two, position), L::load(prevPositions + f)),
+                             L::mul(L::mul(acceleration, step), step));
 
-    float angularVelocity = body.torqueAccumulator * body.invInertia;
-    body.angularVelocity += angularVelocity * dt;
-    body.rotation += angularVelocity * dt;
+      L::store(velocities + f, L::div(L::sub(next, position), step));
+      L::store(positions + f, next);
+      L::store(prevPositions + f, position);
+      L::store(forces + f, zero);
+    }
+
+    for (; j + L::WIDTH <= end; j += L::WIDTH) {
+      L::Float angularVelocity = L::mul(L::load(torques + j), L::load(invInertias + j));
+      L::store(angularVelocities + j, L::add(L::load(angularVelocities + j), L::mul(angularVelocity, step)));
+      L::store(rotations + j, L::add(L::load(rotations + j), L::mul(angularVelocity, step)));
+      L::store(torques + j, zero);
+    }
+  }
+
+  for (; i < end; ++i) {
+    glm::vec2& position = bodies.positions[i];
+    glm::vec2 oldPosition = position;
+
+    glm::vec2 acceleration = bodies.forces[i] * invMasses[i] + m_gravity;
+    position = 2.0f * position - bodies.prevPositions[i] + acceleration * dt * dt;
+
+    bodies.velocities[i] = (position - oldPosition) / dt;
+    bodies.prevPositions[i] = oldPosition;
+    bodies.forces[i] = glm::vec2(0.0f);
+  }
 
-    body.clearForces();
+  for (; j < end; ++j) {
+    float angularVelocity = torques[j] * invInertias[j];
+    angularVelocities[j] += angularVelocity * dt;
+    rotations[j] += angularVelocity * dt;
+    torques[j] = 0.0f;
   }
 }
 
-void LeapFrogSolver::integrate(std::vector<RigidBody>& bodies, float dt) {
-  for (auto& body : bodies) {
-    if (body.type == BodyType::STATIC || !body.active) continue;
-    body.applyForce(body.mass * m_gravity);
-    
-    glm::vec2 acceleration = body.forceAccumulator * body.invMass;
-    
-    body.velocity += acceleration * (dt * 0.5f);
-    body.position += body.velocity * dt;
-    body.velocity += acceleration * (dt * 0.5f);
-    
-    float angularAcceleration = body.torqueAccumulator * body.invInertia;
-    body.angularVelocity += angularAcceleration * dt;
-    body.rotation += body.angularVelocity * dt;
-    
-    body.clearForces(); 
+void LeapFrogSolver::integrate(BodyStorage& bodies, size_t begin, size_t end, float dt) {
+  using L = SimdLanes;
+
+  float* positions = reinterpret_cast<float*>(bodies.positions.data());
+  float* velocities = reinterpret_cast<float*>(bodies.velocities.data());
+  float* forces = reinterpret_cast<float*>(bodies.forces.data());
+  const float* invMasses = bodies.invMasses.data();
+  float* rotations = bodies.rotations.data();
+  float* angularVelocities = bodies.angularVelocities.data();
+  float* torques = bodies.torques.data();
+  const float* invInertias = bodies.invInertias.data();
+
+  const float halfDt = dt * 0.5f;
+
+  size_t i = begin;
+  size_t j = begin;
+  if (L::WIDTH > 1) {
+    const L::Float gravity = L::setPair(m_gravity.x, m_gravity.y);
+    const L::Float step = L::set(dt);
+    const L::Float halfStep = L::set(halfDt);
+    const L::Float zero = L::set(0.0f);
+
+    for (; i + L::WIDTH / 2 <= end; i += L::WIDTH / 2) {
+      const size_t f = 2 * i;
+      L::Float acceleration = L::add(L::mul(L::load(forces + f), L::loadPairs(invMasses + i)), gravity);
+      L::Float halfKick = L::mul(acceleration, halfStep);
+
+      L::Float velocity = L::add(L::load(velocities + f), halfKick);
+      L::store(positions + f, L::add(L::load(positions + f), L::mul(velocity, step)));
+      L::store(velocities + f, L::add(velocity, halfKick));
+      L::store(forces + f, zero);
+    }
+
+    for (; j + L::WIDTH <= end; j += L::WIDTH) {
+      L::Float angularAcceleration = L::mul(L::load(torques + j), L::load(invInertias + j));
+      L::Float angularVelocity = L::add(L::load(angularVelocities + j), L::mul(angularAcceleration, step));
+      L::store(angularVelocities + j, angularVelocity);
+      L::store(rotations + j, L::add(L::load(rotations + j), L::mul(angularVelocity, step)));
+      L::store(torques + j, zero);
+    }
+  }
+
+  for (; i < end; ++i) {
+    glm::vec2 acceleration = bodies.forces[i] * invMasses[i] + m_gravity;
+
+    bodies.velocities[i] += acceleration * halfDt;
+    bodies.positions[i] += bodies.velocities[i] * dt;
+    bodies.velocities[i] += acceleration * halfDt;
+    bodies.forces[i] = glm::vec2(0.0f);
+  }
+
+  for (; j < end; ++j) {
+    float angularAcceleration = torques[j] * invInertias[j];
+    angularVelocities[j] += angularAcceleration * dt;
+    rotations[j] += angularVelocities[j] * dt;
+    torques[j] = 0.0f;
   }
 }
 
-bool detectCollision(const RigidBody& bodyA, const RigidBody& bodyB, Collision& collision) {
-  if (!bodyA.shape || !bodyB.shape) {
-    return false;
+void XPBDSolver::integrate(BodyStorage& bodies, size_t begin, size_t end, float dt) {
+  using L = SimdLanes;
+
+  float* positions = reinterpret_cast<float*>(bodies.positions.data());
+  float* prevPositions = reinterpret_cast<float*>(bodies.prevPositions.data());
+  float* velocities = reinterpret_cast<float*>(bodies.velocities.data());
+  const float* forces = reinterpret_cast<const float*>(bodies.forces.data());
+  const float* invMasses = bodies.invMasses.data();
+  float* rotations = bodies.rotations.data();
+  float* angularVelocities = bodies.angularVelocities.data();
+  const float* torques = bodies.torques.data();
+  const float* invInertias = bodies.invInertias.data();
+
+  size_t i = begin;
+  size_t j = begin;
+  if (L::WIDTH > 1) {
+    const L::Float gravity = L::setPair(m_gravity.x, m_gravity.y);
+    const L::Float step = L::set(dt);
+
+    for (; i + L::WIDTH / 2 <= end; i += L::WIDTH / 2) {
+      const size_t f = 2 * i;
+      L::Float position = L::load(positions + f);
+      L::Float acceleration = L::add(L::mul(L::load(forces + f), L::loadPairs(invMasses + i)), gravity);
+      L::Float velocity = L::add(L::load(velocities + f), L::mul(acceleration, step));
+
+      L::store(prevPositions + f, position);
+      L::store(velocities + f, velocity);
+      L::store(positions + f, L::add(position, L::mul(velocity, step)));
+    }
+
+    for (; j + L::WIDTH <= end; j += L::WIDTH) {
+      L::Float angularAcceleration = L::mul(L::load(torques + j), L::load(invInertias + j));
+      L::Float angularVelocity = L::add(L::load(angularVelocities + j), L::mul(angularAcceleration, step));
+      L::store(angularVelocities + j, angularVelocity);
+      L::store(rotations + j, L::add(L::load(rotations + j), L::mul(angularVelocity, step)));
+    }
   }
-  
-  if (!bodyA.aabb.overlaps(bodyB.aabb)) {
+
+  for (; i < end; ++i) {
+    glm::vec2 acceleration = bodies.forces[i] * invMasses[i] + m_gravity;
+
+    bodies.prevPositions[i] = bodies.positions[i];
+    bodies.velocities[i] += acceleration * dt;
+    bodies.positions[i] += bodies.velocities[i] * dt;
+  }
+
+  for (; j < end; ++j) {
+    float angularAcceleration = torques[j] * invInertias[j];
+    angularVelocities[j] += angularAcceleration * dt;
+    rotations[j] += angularVelocities[j] * dt;
+  }
+}
+
+void XPBDSolver::updateVelocities(BodyStorage& bodies, size_t begin, size_t end, float dt) {
+  using L = SimdLanes;
+
+  const float* positions = reinterpret_cast<const float*>(bodies.positions.data());
+  const float* prevPositions = reinterpret_cast<const float*>(bodies.prevPositions.data());
+  float* velocities = reinterpret_cast<float*>(bodies.velocities.data());
+
+  size_t i = begin;
+  if (L::WIDTH > 1) {
+    const L::Float step = L::set(dt);
+
+    for (; i + L::WIDTH / 2 <= end; i += L::WIDTH / 2) {
+      const size_t f = 2 * i;
+      L::store(velocities + f, L::div(L::sub(L::load(positions + f), L::load(prevPositions + f)), step));
+    }
+  }
+
+  for (; i < end; ++i) {
+    bodies.velocities[i] = (bodies.positions[i] - bodies.prevPositions[i]) / dt;
+  }
+}
+
+bool detectCollision(const BodyStorage& bodies, uint32_t bodyA, uint32_t bodyB, Collision& collision) {
+  if (!bodies.aabbs[bodyA].overlaps(bodies.aabbs[bodyB])) {
     return false;
   }
   
-  ShapeType typeA = bodyA.shape->getType();
-  ShapeType typeB = bodyB.shape->getType();
+  ShapeType typeA = bodies.shapeTypes[bodyA];
+  ShapeType typeB = bodies.shapeTypes[bodyB];
   
   if (typeA == ShapeType::CIRCLE && typeB == ShapeType::CIRCLE) {
-    return circleVsCircle(bodyA, bodyB, collision);
+    return circleVsCircle(bodies, bodyA, bodyB, collision);
   } else if (typeA == ShapeType::RECTANGLE && typeB == ShapeType::RECTANGLE) {
-    return rectangleVsRectangle(bodyA, bodyB, collision);
+    return rectangleVsRectangle(bodies, bodyA, bodyB, collision);
   } else if (typeA == ShapeType::CIRCLE && typeB == ShapeType::RECTANGLE) {
-    return circleVsRectangle(bodyA, bodyB, collision);
+    return circleVsRectangle(bodies, bodyA, bodyB, collision);
   } else if (typeA == ShapeType::RECTANGLE && typeB == ShapeType::CIRCLE) {
-    bool result = circleVsRectangle(bodyB, bodyA, collision);
+    bool result = circleVsRectangle(bodies, bodyB, bodyA, collision);
     if (result) {
       std::swap(collision.bodyA, collision.bodyB);
       collision.normal = -collision.normal;
@@ -71,14 +235,15 @@ bool detectCollision(const RigidBody& bodyA, const RigidBody& bodyB, Collision&
   return false;
 }
 
-bool circleVsCircle(const RigidBody& bodyA, const RigidBody& bodyB, Collision& collision) {
-  const CircleShape* circleA = static_cast<const CircleShape*>(bodyA.shape.get());
-  const CircleShape* circleB = static_cast<const CircleShape*>(bodyB.shape.get());
+bool circleVsCircle(const BodyStorage& bodies, uint32_t bodyA, uint32_t bodyB, Collision& collision) {
+  float radiusA = bodies.shapeExtents[bodyA].x;
+  float radiusB = bodies.shapeExtents[bodyB].x;
+  const glm::vec2& positionA = bodies.positions[bodyA];
   
-  glm::vec2 direction = bodyB.position - bodyA.position;
+  glm::vec2 direction = bodies.positions[bodyB] - positionA;
   float distanceSquared = glm::dot(direction, direction);
   
-  float radiusSum = circleA->radius + circleB->radius;
+  float radiusSum = radiusA + radiusB;
   
   if (distanceSquared > radiusSum * radiusSum) {
     return false;
@@ -86,8 +251,8 @@ bool circleVsCircle(const RigidBody& bodyA, const RigidBody& bodyB, Collision& c
   
   float distance = std::sqrt(distanceSquared);
   
-  collision.bodyA = const_cast<RigidBody*>(&bodyA);
-  collision.bodyB = const_cast<RigidBody*>(&bodyB);
+  collision.bodyA = bodyA;
+  collision.bodyB = bodyB;
   
   if (distance > 0.0f) {
     collision.normal = direction / distance; 
@@ -96,20 +261,18 @@ bool circleVsCircle(const RigidBody& bodyA, const RigidBody& bodyB, Collision& c
   }
   
   collision.penetration = radiusSum - distance;
-  collision.contactPoint = bodyA.position + collision.normal * circleA->radius;
+  collision.contactPoint = positionA + collision.normal * radiusA;
   collision.hasCollision = true;
   
   return true;
 }
 
-bool rectangleVsRectangle(const RigidBody& bodyA, const RigidBody& bodyB, Collision& collision) {
-  const RectangleShape* rectA = static_cast<const RectangleShape*>(bodyA.shape.get());
-  const RectangleShape* rectB = static_cast<const RectangleShape*>(bodyB.shape.get());
-  
-  glm::vec2 halfSizeA = rectA->size * 0.5f;
-  glm::vec2 halfSizeB = rectB->size * 0.5f;
+bool rectangleVsRectangle(const BodyStorage& bodies, uint32_t bodyA, uint32_t bodyB, Collision& collision) {
+  const glm::vec2& halfSizeA = bodies.shapeExtents[bodyA];
+  const glm::vec2& halfSizeB = bodies.shapeExtents[bodyB];
+  const glm::vec2& positionA = bodies.positions[bodyA];
   
-  glm::vec2 diff = bodyB.position - bodyA.position;
+  glm::vec2 diff = bodies.positions[bodyB] - positionA;
   
   float overlapX = halfSizeA.x + halfSizeB.x - std::abs(diff.x);
   float overlapY = halfSizeA.y + halfSizeB.y - std::abs(diff.y);
@@ -118,34 +281,34 @@ bool rectangleVsRectangle(const RigidBody& bodyA, const RigidBody& bodyB, Collis
     return false;
   }
   
-  collision.bodyA = const_cast<RigidBody*>(&bodyA);
-  collision.bodyB = const_cast<RigidBody*>(&bodyB);
+  collision.bodyA = bodyA;
+  collision.bodyB = bodyB;
   
   if (overlapX < overlapY) {
     collision.penetration = overlapX;
     collision.normal = glm::vec2(diff.x < 0 ? -1.0f : 1.0f, 0.0f);
+    collision.feature = 0;
   } else {
     collision.penetration = overlapY;
     collision.normal = glm::vec2(0.0f, diff.y < 0 ? -1.0f : 1.0f);
+    collision.feature = 1;
   }
   
-  glm::vec2 contactDir = glm::vec2(
-    diff.x < 0 ? -halfSizeA.x : halfSizeA.x,
-    diff.y < 0 ? -halfSizeA.y : halfSizeA.y
-  );
-  collision.contactPoint = bodyA.position + contactDir;
+  // Centre of the overlap region, so a resting box is not pushed at a corner.
+  glm::vec2 overlapMin = glm::max(positionA - halfSizeA, bodies.positions[bodyB] - halfSizeB);
+  glm::vec2 overlapMax = glm::min(positionA + halfSizeA, bodies.positions[bodyB] + halfSizeB);
+  collision.contactPoint = (overlapMin + overlapMax) * 0.5f;
   collision.hasCollision = true;
   
   return true;
 }
 
-bool circleVsRectangle(const RigidBody& circle, const RigidBody& rectangle, Collision& collision) {
-  const CircleShape* circleShape = static_cast<const CircleShape*>(circle.shape.get());
-  const RectangleShape* rectShape = static_cast<const RectangleShape*>(rectangle.shape.get());
-  
-  glm::vec2 circlePos = circle.position - rectangle.position;
+bool circleVsRectangle(const BodyStorage& bodies, uint32_t circle, uint32_t rectangle, Collision& collision) {
+  float radius = bodies.shapeExtents[circle].x;
+  const glm::vec2& halfSize = bodies.shapeExtents[rectangle];
+  const glm::vec2& circlePosition = bodies.positions[circle];
   
-  glm::vec2 halfSize = rectShape->size * 0.5f;
+  glm::vec2 circlePos = circlePosition - bodies.positions[rectangle];
   
   glm::vec2 closest = glm::vec2(
     glm::clamp(circlePos.x, -halfSize.x, halfSize.x),
@@ -155,60 +318,347 @@ bool circleVsRectangle(const RigidBody& circle, const RigidBody& rectangle, Coll
   glm::vec2 toCircle = circlePos - closest;
   float distanceSquared = glm::dot(toCircle, toCircle);
   
-  if (distanceSquared > circleShape->radius * circleShape->radius) {
+  if (distanceSquared > radius * radius) {
     return false;
   }
   
   float distance = std::sqrt(distanceSquared);
   
-  collision.bodyA = const_cast<RigidBody*>(&circle);
-  collision.bodyB = const_cast<RigidBody*>(&rectangle);
+  collision.bodyA = circle;
+  collision.bodyB = rectangle;
   
   if (distance > 0.0f) {
-    collision.normal = toCircle / distance; 
+    collision.normal = -toCircle / distance; 
   } else {
     float overlapX = halfSize.x - std::abs(circlePos.x);
     float overlapY = halfSize.y - std::abs(circlePos.y);
     
     if (overlapX < overlapY) {
-      collision.normal = glm::vec2(circlePos.x < 0 ? -1.0f : 1.0f, 0.0f);
+      collision.normal = glm::vec2(circlePos.x < 0 ? 1.0f : -1.0f, 0.0f);
     } else {
-      collision.normal = glm::vec2(0.0f, circlePos.y < 0 ? -1.0f : 1.0f);
+      collision.normal = glm::vec2(0.0f, circlePos.y < 0 ? 1.0f : -1.0f);
     }
   }
   
-  collision.penetration = circleShape->radius - distance;
-  collision.contactPoint = circle.position - collision.normal * circleShape->radius;
+  // Voronoi region of the rectangle holding the circle centre: 0 inside,
+  // otherwise a face or corner.
+  uint32_t regionX = circlePos.x < -halfSize.x ? 1u : (circlePos.x > halfSize.x ? 2u : 0u);
+  uint32_t regionY = circlePos.y < -halfSize.y ? 1u : (circlePos.y > halfSize.y ? 2u : 0u);
+  collision.feature = regionX | (regionY << 2);
+  
+  collision.penetration = radius - distance;
+  collision.contactPoint = circlePosition + collision.normal * radius;
   collision.hasCollision = true;
   
   return true;
 }
 
-PhysicsEngine::PhysicsEngine() 
-  : m_spatialHash(m_config.spatialHashCellSize) {
+bool sweepCircleVsCircle(const glm::vec2& start, const glm::vec2& end, float radius,
+                         const glm::vec2& center, float targetRadius, float& toi, glm::vec2& normal) {
+  glm::vec2 offset = start - center;
+  glm::vec2 motion = end - start;
+  float radiusSum = radius + targetRadius;
+
+  float c = glm::dot(offset, offset) - radiusSum * radiusSum;
+  if (c <= 0.0f) return false;
+
+  float a = glm::dot(motion, motion);
+  float b = glm::dot(offset, motion);
+  if (a <= 0.0f || b >= 0.0f) return false;
+
+  float discriminant = b * b - a * c;
+  if (discriminant < 0.0f) return false;
+
+  float t = (-b - std::sqrt(discriminant)) / a;
+  if (t > 1.0f) return false;
+
+  toi = std::max(t, 0.0f);
+  normal = -(offset + motion * toi) / radiusSum;
+  return true;
+}
+
+// Ray against the rectangle grown by the radius. Hits that land beyond a
+// face's extent are on a rounded corner and are redone against a circle of
+// the moving radius around that corner.
+bool sweepCircleVsRectangle(const glm::vec2& start, const glm::vec2& end, float radius,
+                            const glm::vec2& center, const glm::vec2& halfSize, float& toi, glm::vec2& normal) {
+  glm::vec2 local = start - center;
+  glm::vec2 motion = end - start;
+
+  glm::vec2 closest = glm::clamp(local, -halfSize, halfSize);
+  glm::vec2 away = local - closest;
+  if (glm::dot(away, away) <= radius * radius) return false;
+
+  glm::vec2 grown = halfSize + glm::vec2(radius);
+  float enter = 0.0f;
+  float exit = 1.0f;
+  int axis = -1;
+  for (int i = 0; i < 2; ++i) {
+    if (motion[i] == 0.0f) {
+      if (local[i] < -grown[i] || local[i] > grown[i]) return false;
+      continue;
+    }
+
+    float t0 = (-grown[i] - local[i]) / motion[i];
+    float t1 = (grown[i] - local[i]) / motion[i];
+    if (t0 > t1) std::swap(t0, t1);
+    if (t0 > enter) {
+      enter = t0;
+      axis = i;
+    }
+    exit = std::min(exit, t1);
+    if (enter > exit) return false;
+  }
+
+  glm::vec2 hit = local + motion * enter;
+  bool faceX = std::abs(hit.x) <= halfSize.x;
+  bool faceY = std::abs(hit.y) <= halfSize.y;
+  if (axis >= 0 && (faceX || faceY)) {
+    toi = enter;
+    normal = glm::vec2(0.0f);
+    normal[axis] = hit[axis] < 0.0f ? 1.0f : -1.0f;
+    return true;
+  }
+
+  glm::vec2 corner(hit.x < 0.0f ? -halfSize.x : halfSize.x, hit.y < 0.0f ? -halfSize.y : halfSize.y);
+  return sweepCircleVsCircle(start, end, radius, center + corner, 0.0f, toi, normal);
+}
+
+namespace {
+  // Adds the time until it goes out of scope to one phase. Does nothing,
+  // not even read the clock, without stats.
+  class ScopedPhaseTimer {
+  public:
+    ScopedPhaseTimer(PhysicsStats* stats, PhysicsPhase phase) : m_stats(stats), m_phase(phase) {
+      if (m_stats) m_start = std::chrono::steady_clock::now();
+    }
+
+    ~ScopedPhaseTimer() {
+      if (!m_stats) return;
+      auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start);
+      m_stats->phaseNs[static_cast<size_t>(m_phase)] += static_cast<uint64_t>(elapsed.count());
+    }
+
+    ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+    ScopedPhaseTimer& operator=(const ScopedPhaseTimer&) = delete;
+
+  private:
+    PhysicsStats* m_stats;
+    PhysicsPhase m_phase;
+    std::chrono::steady_clock::time_point m_start;
+  };
+
+  uint32_t spreadBits(uint32_t value) {
+    value &= 0x0000FFFFu;
+    value = (value | (value << 8)) & 0x00FF00FFu;
+    value = (value | (value << 4)) & 0x0F0F0F0Fu;
+    value = (value | (value << 2)) & 0x33333333u;
+    value = (value | (value << 1)) & 0x55555555u;
+    return value;
+  }
+
+  // Interleaves the low 16 bits of x and y.
+  uint64_t mortonCode(uint32_t x, uint32_t y) {
+    return static_cast<uint64_t>(spreadBits(x) | (spreadBits(y) << 1));
+  }
+
+  // Exact ray tests use the swept-circle tests with a zero radius, which
+  // already ignore shapes the ray starts inside of.
+  struct ClosestRayHit final : RayCastCallback {
+    const BodyStorage& bodies;
+    const Ray& ray;
+    uint32_t body = BodyHandle::INVALID_INDEX;
+    glm::vec2 normal = glm::vec2(0.0f);
+    float fraction = 1.0f;
+
+    ClosestRayHit(const BodyStorage& storage, const Ray& query) : bodies(storage), ray(query) {}
+
+    float reportBody(uint32_t candidate) override {
+      if (!bodies.active[candidate]) return fraction;
+
+      float toi;
+      glm::vec2 into;
+      bool hit = bodies.shapeTypes[candidate] == ShapeType::CIRCLE
+        ? sweepCircleVsCircle(ray.from, ray.to, 0.0f, bodies.positions[candidate], bodies.shapeExtents[candidate].x, toi, into)
+        : sweepCircleVsRectangle(ray.from, ray.to, 0.0f, bodies.positions[candidate], bodies.shapeExtents[candidate], toi, into);
+      if (hit && toi < fraction) {
+        fraction = toi;
+        normal = -into;
+        body = candidate;
+      }
+      return fraction;
+    }
+  };
+
+  struct OverlapCollector final : QueryCallback {
+    const BodyStorage& bodies;
+    const AABB& aabb;
+    BodyHandle* results;
+    size_t capacity;
+    size_t count = 0;
+
+    OverlapCollector(const BodyStorage& storage, const AABB& bounds, BodyHandle* output, size_t outputCapacity)
+      : bodies(storage), aabb(bounds), results(output), capacity(outputCapacity) {}
+
+    bool reportBody(uint32_t candidate) override {
+      if (!bodies.active[candidate]) return true;
+
+      bool overlaps;
+      if (bodies.shapeTypes[candidate] == ShapeType::CIRCLE) {
+        const glm::vec2& center = bodies.positions[candidate];
+        glm::vec2 away = center - glm::clamp(center, aabb.min, aabb.max);
+        float radius = bodies.shapeExtents[candidate].x;
+        overlaps = glm::dot(away, away) <= radius * radius;
+      } else {
+        overlaps = bodies.aabbs[candidate].overlaps(aabb);
+      }
+
+      if (overlaps) {
+        if (count < capacity) {
+          results[count] = bodies.handleAt(candidate);
+        }
+        count++;
+      }
+      return true;
+    }
+  };
+}
+
+PhysicsEngine::PhysicsEngine() {
   m_solver = std::make_unique<VerletSolver>();
+  m_broadPhase = std::make_unique<SpatialHash>(m_config.spatialHashCellSize);
+  m_bodies.onSwap = [this](uint32_t a, uint32_t b) {
+    m_broadPhase->swapBodies(a, b);
+  };
+  m_bodies.onPermute = [this](uint32_t begin, const std::vector<uint32_t>& order) {
+    m_broadPhase->permuteBodies(begin, order);
+  };
 }
 
 PhysicsEngine::~PhysicsEngine() {
 
 }
 
-size_t PhysicsEngine::addBody(RigidBody&& body) {
-  m_bodies.push_back(std::move(body));
-  return m_bodies.size() - 1;
+BodyHandle PhysicsEngine::addBody(RigidBody&& body) {
+  bool isStatic = body.type == BodyType::STATIC;
+  BodyHandle handle = m_bodies.add(std::move(body));
+  m_queriesDirty = true;
+  if (isStatic) {
+    m_dirtyStatics.push_back(handle);
+  }
+  return handle;
 }
 
-void PhysicsEngine::removeBody(size_t index) {
-  if (index < m_bodies.size()) {
-    m_bodies.erase(m_bodies.begin() + index);
+void PhysicsEngine::addBodies(std::vector<RigidBody>&& bodies, std::vector<BodyHandle>* outHandles) {
+  m_bodies.reserve(m_bodies.size() + bodies.size());
+  if (outHandles) {
+    outHandles->reserve(outHandles->size() + bodies.size());
   }
+
+  for (auto& body : bodies) {
+    BodyHandle handle = addBody(std::move(body));
+    if (outHandles) {
+      outHandles->push_back(handle);
+    }
+  }
+
+  bodies.clear();
 }
 
-RigidBody* PhysicsEngine::getBody(size_t index) {
-  if (index < m_bodies.size()) {
-    return &m_bodies[index];
+void PhysicsEngine::removeBody(BodyHandle handle) {
+  if (m_stepping) {
+    m_pendingRemovals.push_back(handle);
+    return;
   }
-  return nullptr;
+
+  destroyBody(handle);
+}
+
+void PhysicsEngine::removeBodies(const std::vector<BodyHandle>& handles) {
+  if (m_stepping) {
+    m_pendingRemovals.insert(m_pendingRemovals.end(), handles.begin(), handles.end());
+    return;
+  }
+
+  for (BodyHandle handle : handles) {
+    destroyBody(handle);
+  }
+}
+
+void PhysicsEngine::destroyBody(BodyHandle handle) {
+  if (!m_bodies.contains(handle)) {
+    return;
+  }
+
+  // BodyStorage reports its swaps through onSwap, so by the time remove()
+  // returns the broad phase has the removed body at the old last index.
+  // A sleeping island that loses a body may have lost a support.
+  uint32_t island = m_bodies.sleepIslands[m_bodies.denseIndex(handle)];
+  if (island != BodyHandle::INVALID_INDEX) {
+    wakeIsland(island);
+  }
+
+  uint32_t last = static_cast<uint32_t>(m_bodies.size() - 1);
+  m_bodies.remove(handle);
+  m_broadPhase->remove(last);
+  m_queriesDirty = true;
+}
+
+void PhysicsEngine::updateStaticBody(BodyHandle handle) {
+  uint32_t index = m_bodies.denseIndex(handle);
+  if (index == BodyHandle::INVALID_INDEX || m_bodies.types[index] != BodyType::STATIC) {
+    return;
+  }
+
+  m_dirtyStatics.push_back(handle);
+
+  // The broad phase never pairs statics with sleeping bodies, so wake
+  // whatever the moved body now overlaps.
+  m_bodies.updateAABB(index);
+  m_broadPhase->query(m_bodies.aabbs[index], m_staticOverlaps);
+  for (uint32_t body : m_staticOverlaps) {
+    if (m_bodies.sleepIslands[body] != BodyHandle::INVALID_INDEX) {
+      wakeIsland(m_bodies.sleepIslands[body]);
+    }
+  }
+}
+
+void PhysicsEngine::setCollisionFilter(BodyHandle handle, const CollisionFilter& filter) {
+  uint32_t index = m_bodies.denseIndex(handle);
+  if (index == BodyHandle::INVALID_INDEX || m_bodies.filters[index] == filter) {
+    return;
+  }
+
+  // Simulated bodies are re-synced every step anyway; sleeping and static
+  // ones go through the dirty list.
+  m_bodies.filters[index] = filter;
+  m_dirtyStatics.push_back(handle);
+}
+
+void PhysicsEngine::addBoundaryPlane(const glm::vec2& normal, float offset) {
+  float length = glm::length(normal);
+  if (length <= 0.0f) {
+    WARLOG("Ignoring boundary plane with zero normal");
+    return;
+  }
+
+  m_boundaryPlanes.push_back({normal / length, offset / length});
+}
+
+void PhysicsEngine::clearBoundaryPlanes() {
+  m_boundaryPlanes.clear();
+}
+
+BodyRef PhysicsEngine::getBody(BodyHandle handle) {
+  uint32_t index = m_bodies.denseIndex(handle);
+  if (index != BodyHandle::INVALID_INDEX) {
+    return BodyRef(&m_bodies, index);
+  }
+  return BodyRef();
+}
+
+void PhysicsEngine::reserveBodies(size_t count) {
+  m_bodies.reserve(count);
 }
 
 void PhysicsEngine::setIntegrationMethod(IntegrationMethod method) {
@@ -225,16 +675,62 @@ void PhysicsEngine::setIntegrationMethod(IntegrationMethod method) {
     case IntegrationMethod::LEAPFROG:
       m_solver = std::make_unique<LeapFrogSolver>();
       break;
+    case IntegrationMethod::XPBD:
+      m_solver = std::make_unique<XPBDSolver>();
+      break;
   }
+  m_solver->setGravity(m_config.gravityVec);
 }
 
 void PhysicsEngine::setGravity(const glm::vec2& gravity) {
   m_config.gravityVec = gravity;
+  m_solver->setGravity(gravity);
 }
 
 void PhysicsEngine::setSpatialHashCellSize(float cellSize) {
   m_config.spatialHashCellSize = cellSize;
-  m_spatialHash = SpatialHash(cellSize);
+  
+  if (m_broadPhase->getType() == BroadPhaseType::SPATIAL_HASH) {
+    m_broadPhase = std::make_unique<SpatialHash>(cellSize);
+    m_staticsDirty = true;
+  }
+}
+
+void PhysicsEngine::setSolverIterations(int velocityIterations, int positionIterations) {
+  m_config.velocityIterations = std::max(velocityIterations, 0);
+  m_config.positionIterations = std::max(positionIterations, 0);
+}
+
+void PhysicsEngine::setSleepEnabled(bool enabled) {
+  m_config.allowSleep = enabled;
+  if (enabled) return;
+
+  for (uint32_t island = 0; island < m_sleepingIslands.size(); ++island) {
+    wakeIsland(island);
+  }
+}
+
+void PhysicsEngine::setSubstepCount(int substeps) {
+  m_config.substeps = std::max(substeps, 1);
+}
+
+void PhysicsEngine::setBroadPhase(BroadPhaseType type) {
+  if (m_broadPhase->getType() == type) {
+    return;
+  }
+  
+  switch (type) {
+    case BroadPhaseType::SPATIAL_HASH:
+      m_broadPhase = std::make_unique<SpatialHash>(m_config.spatialHashCellSize);
+      break;
+    case BroadPhaseType::SWEEP_AND_PRUNE:
+      m_broadPhase = std::make_unique<SweepAndPrune>();
+      break;
+    case BroadPhaseType::AABB_TREE:
+      m_broadPhase = std::make_unique<AABBTreeBroadPhase>(m_config.aabbTreeMargin);
+      break;
+  }
+  m_staticsDirty = true;
 }
 
 void PhysicsEngine::update(float dt) {
@@ -245,21 +741,252 @@ void PhysicsEngine::update(float dt) {
     dt = maxDt;
   }
   
-  updateAABBs();
+  m_stepping = true;
+  const auto stepStart = m_profiling ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+  if (m_profiling) {
+    m_stats = PhysicsStats();
+  }
   
-  updateSpatialHash();
+  beginContactEvents();
+  m_reordered = false;
+  {
+    ScopedPhaseTimer timer(profile(), PhysicsPhase::BROAD_PHASE_UPDATE);
+    wakeRequestedIslands();
+    m_partitionChanged = m_bodies.partitionActive();
+    if (reorderDue()) {
+      reorderBodies();
+    }
+    updateAABBs();
+  }
+  {
+    ScopedPhaseTimer timer(profile(), PhysicsPhase::INTEGRATION);
+    m_bodies.storeStepStart();
+  }
+  {
+    ScopedPhaseTimer timer(profile(), PhysicsPhase::CONTINUOUS);
+    prepareContinuous(dt);
+  }
+  {
+    ScopedPhaseTimer timer(profile(), PhysicsPhase::BROAD_PHASE_UPDATE);
+    updateBroadPhase();
+  }
+  {
+    ScopedPhaseTimer timer(profile(), PhysicsPhase::PAIR_FINDING);
+    broadPhaseCollision();
+    if (m_reorderThreshold > 0.0f || m_profiling) {
+      measurePairSpan();
+    }
+  }
   
-  broadPhaseCollision();
+  if (m_integrationMethod == IntegrationMethod::XPBD) {
+    substep(dt);
+  } else {
+    {
+      ScopedPhaseTimer timer(profile(), PhysicsPhase::NARROW_PHASE);
+      narrowPhaseCollision();
+      boundaryCollision();
+      recordContacts();
+    }
+    {
+      ScopedPhaseTimer timer(profile(), PhysicsPhase::CONTACT_SOLVER);
+      m_contactSolver.prepare(m_bodies, m_collisions);
+    }
+    {
+      ScopedPhaseTimer timer(profile(), PhysicsPhase::INTEGRATION);
+      integrate(dt);
+    }
+    {
+      ScopedPhaseTimer timer(profile(), PhysicsPhase::CONTACT_SOLVER);
+      resolveCollisions(dt);
+    }
+  }
   
-  narrowPhaseCollision();
+  {
+    ScopedPhaseTimer timer(profile(), PhysicsPhase::CONTINUOUS);
+    solveContinuous(dt);
+  }
+  {
+    ScopedPhaseTimer timer(profile(), PhysicsPhase::SLEEP);
+    updateSleep(dt);
+  }
+  {
+    ScopedPhaseTimer timer(profile(), PhysicsPhase::NARROW_PHASE);
+    finishContactEvents();
+  }
   
-  m_solver->integrate(m_bodies, dt);
+  if (m_profiling) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - stepStart);
+    m_stats.stepNs = static_cast<uint64_t>(elapsed.count());
+    collectStats();
+  }
   
-  resolveCollisions();
+  m_stepping = false;
+  m_queriesDirty = true;
+  m_stepsSinceReorder++;
+  flushPendingRemovals();
+}
+
+void PhysicsEngine::setProfilingEnabled(bool enabled) {
+  m_profiling = enabled;
+  m_stats = PhysicsStats();
+}
+
+void PhysicsEngine::collectStats() {
+  const size_t activeCount = m_bodies.activeCount();
+  const size_t dynamicCount = m_bodies.dynamicCount();
+
+  uint32_t sleeping = 0;
+  for (size_t i = activeCount; i < dynamicCount; ++i) {
+    sleeping += m_bodies.awake[i] ? 0u : 1u;
+  }
+
+  m_stats.bodies = static_cast<uint32_t>(m_bodies.size());
+  m_stats.activeBodies = static_cast<uint32_t>(activeCount);
+  m_stats.sleepingBodies = sleeping;
+  m_stats.cellsUsed = m_broadPhase->getType() == BroadPhaseType::SPATIAL_HASH
+    ? static_cast<uint32_t>(static_cast<const SpatialHash&>(*m_broadPhase).getUsedCellCount()) : 0;
+  m_stats.candidatePairs = static_cast<uint32_t>(m_potentialCollisions.size());
+  m_stats.contacts = static_cast<uint32_t>(m_collisions.size());
+  m_stats.solverIterations = m_integrationMethod == IntegrationMethod::XPBD
+    ? static_cast<uint32_t>(std::max(m_config.substeps, 1))
+    : static_cast<uint32_t>(m_config.velocityIterations + m_config.positionIterations);
+  m_stats.cacheHitRate = m_contactSolver.getCacheHitRate();
+  m_stats.pairSpan = m_pairSpan;
+  m_stats.reordered = m_reordered;
+}
+
+const char* PhysicsStats::getPhaseName(PhysicsPhase phase) {
+  switch (phase) {
+    case PhysicsPhase::BROAD_PHASE_UPDATE: return "broad_phase_update";
+    case PhysicsPhase::PAIR_FINDING: return "pair_finding";
+    case PhysicsPhase::NARROW_PHASE: return "narrow_phase";
+    case PhysicsPhase::INTEGRATION: return "integration";
+    case PhysicsPhase::CONTACT_SOLVER: return "contact_solver";
+    case PhysicsPhase::CONTINUOUS: return "continuous";
+    case PhysicsPhase::SLEEP: return "sleep";
+    case PhysicsPhase::COUNT: break;
+  }
+  return "unknown";
+}
+
+void PhysicsEngine::flushPendingRemovals() {
+  for (BodyHandle handle : m_pendingRemovals) {
+    destroyBody(handle);
+  }
+  m_pendingRemovals.clear();
+}
+
+// A snapshot is a flat sequence of raw array copies, written in one pass
+// after a counting pass sized the buffer. Everything is read back in place:
+// restoring allocates nothing once the tables reached their saved size.
+void PhysicsEngine::saveSnapshot(std::vector<uint8_t>& buffer) const {
+  SnapshotWriter measure;
+  writeSnapshot(measure, 0);
+  buffer.resize(measure.size());
+
+  SnapshotWriter writer(buffer.data());
+  writeSnapshot(writer, buffer.size());
+}
+
+void PhysicsEngine::writeSnapshot(SnapshotWriter& writer, uint64_t size) const {
+  writer.write(SNAPSHOT_MAGIC);
+  writer.write(SNAPSHOT_VERSION);
+  writer.write(size);
+
+  m_bodies.saveState(writer);
+
+  writer.write(static_cast<uint32_t>(m_sleepingIslands.size()));
+  for (const std::vector<BodyHandle>& island : m_sleepingIslands) {
+    writer.write(static_cast<uint32_t>(island.size()));
+    writer.writeArray(island.data(), island.size());
+  }
+  writer.write(static_cast<uint32_t>(m_freeIslands.size()));
+  writer.writeArray(m_freeIslands.data(), m_freeIslands.size());
+
+  m_contactSolver.saveCache(writer);
+  m_contacts.saveState(writer);
 }
 
-void PhysicsEngine::setCollisionCallback(CollisionCallback callback) {
-  m_collisionCallback = callback;
+bool PhysicsEngine::restoreSnapshot(const std::vector<uint8_t>& buffer) {
+  if (m_stepping) {
+    WARLOG("Cannot restore a physics snapshot during a step");
+    return false;
+  }
+
+  SnapshotReader reader(buffer.data(), buffer.size());
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  uint64_t size = 0;
+  reader.read(magic);
+  reader.read(version);
+  reader.read(size);
+  if (magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION || size != buffer.size()) {
+    WARLOG("Ignoring invalid physics snapshot");
+    return false;
+  }
+
+  // Walk the whole snapshot before applying any of it, so a short or
+  // corrupt buffer is rejected with the engine untouched.
+  SnapshotReader check = reader;
+  if (!m_bodies.checkState(check)) {
+    WARLOG("Physics snapshot does not match the current bodies");
+    return false;
+  }
+  if (!checkIslands(check) || !ContactSolver::checkCache(check) ||
+      !PairTable<ContactEvent>::checkState(check) || check.remaining() != 0) {
+    WARLOG("Ignoring invalid physics snapshot");
+    return false;
+  }
+
+  m_bodies.restoreState(reader);
+
+  uint32_t islandCount = 0;
+  reader.read(islandCount);
+  m_sleepingIslands.resize(islandCount);
+  for (std::vector<BodyHandle>& island : m_sleepingIslands) {
+    uint32_t islandSize = 0;
+    reader.read(islandSize);
+    island.resize(islandSize);
+    reader.readArray(island.data(), islandSize);
+  }
+  uint32_t freeCount = 0;
+  reader.read(freeCount);
+  m_freeIslands.resize(freeCount);
+  reader.readArray(m_freeIslands.data(), freeCount);
+
+  m_contactSolver.restoreCache(reader);
+  m_contacts.restoreState(reader);
+  m_contactEvents.clear();
+
+  // Simulated bodies are re-synced with the broad phase by the next step
+  // or query. Sleeping and inactive ones only are when the partition
+  // changes, so bring them to their restored positions here.
+  const uint32_t activeCount = static_cast<uint32_t>(m_bodies.activeCount());
+  const uint32_t dynamicCount = static_cast<uint32_t>(m_bodies.dynamicCount());
+  for (uint32_t i = activeCount; i < dynamicCount; ++i) {
+    m_bodies.updateAABB(i);
+    syncBroadPhase(i, true);
+  }
+  m_queriesDirty = true;
+
+  return true;
+}
+
+bool PhysicsEngine::checkIslands(SnapshotReader& reader) {
+  uint32_t islandCount = 0;
+  if (!reader.read(islandCount)) return false;
+  for (uint32_t i = 0; i < islandCount; ++i) {
+    uint32_t islandSize = 0;
+    if (!reader.read(islandSize) || !reader.skipArray<BodyHandle>(islandSize)) return false;
+  }
+
+  uint32_t freeCount = 0;
+  if (!reader.read(freeCount) || freeCount > islandCount) return false;
+  for (uint32_t i = 0; i < freeCount; ++i) {
+    uint32_t island = 0;
+    if (!reader.read(island) || island >= islandCount) return false;
+  }
+  return true;
 }
 
 void PhysicsEngine::debugDraw() {
@@ -267,99 +994,783 @@ void PhysicsEngine::debugDraw() {
 }
 
 void PhysicsEngine::updateAABBs() {
-  for (auto& body : m_bodies) {
-    body.updateAABB();
+  if (!m_jobSystem) {
+    m_bodies.updateActiveAABBs();
+    return;
   }
+
+  const uint32_t count = static_cast<uint32_t>(m_bodies.activeCount());
+  m_jobSystem->parallelFor(count, AABB_GRAIN_SIZE, [this](uint32_t begin, uint32_t end, uint32_t) {
+    m_bodies.updateAABBs(begin, end);
+  });
 }
 
-void PhysicsEngine::updateSpatialHash() {
-  m_spatialHash.clear();
-  
-  for (auto& body : m_bodies) {
-    if (body.active) {
-      m_spatialHash.insert(&body);
+void PhysicsEngine::integrate(float dt) {
+  const uint32_t count = static_cast<uint32_t>(m_bodies.activeCount());
+  if (!m_jobSystem) {
+    m_solver->integrate(m_bodies, 0, count, dt);
+    return;
+  }
+
+  m_jobSystem->parallelFor(count, INTEGRATE_GRAIN_SIZE, [this, dt](uint32_t begin, uint32_t end, uint32_t) {
+    m_solver->integrate(m_bodies, begin, end, dt);
+  });
+}
+
+// Sweeps AABBs by velocity * dt before they reach the broad phase: every
+// body in XPBD mode, which finds pairs once for all substeps, and bullets
+// otherwise. Also records where each bullet starts the step.
+void PhysicsEngine::prepareContinuous(float dt) {
+  const bool xpbd = m_integrationMethod == IntegrationMethod::XPBD;
+  const uint32_t count = static_cast<uint32_t>(m_bodies.activeCount());
+
+  m_bulletStarts.clear();
+  for (uint32_t i = 0; i < count; ++i) {
+    bool bullet = m_bodies.bullets[i] && m_bodies.shapeTypes[i] == ShapeType::CIRCLE;
+    if (!bullet && !xpbd) continue;
+
+    AABB& aabb = m_bodies.aabbs[i];
+    glm::vec2 motion = m_bodies.velocities[i] * dt;
+    aabb.min = glm::min(aabb.min, aabb.min + motion);
+    aabb.max = glm::max(aabb.max, aabb.max + motion);
+
+    if (bullet) {
+      m_bulletStarts.push_back({i, m_bodies.positions[i]});
     }
   }
 }
 
-void PhysicsEngine::broadPhaseCollision() {
-    m_potentialCollisions = m_spatialHash.queryAllPotentialCollisions();
+// The broad phase still holds the boxes from before integration, so a body
+// that moved into a bullet's path this step would not be found. Each moving
+// body's box is swept back over its motion and synced again before the
+// continuous pass queries it.
+void PhysicsEngine::sweepMovedAABBs() {
+  const uint32_t count = static_cast<uint32_t>(m_bodies.activeCount());
+  for (uint32_t i = 0; i < count; ++i) {
+    m_bodies.updateAABB(i);
+    AABB& aabb = m_bodies.aabbs[i];
+    glm::vec2 back = m_bodies.stepStartPositions[i] - m_bodies.positions[i];
+    aabb.min = glm::min(aabb.min, aabb.min + back);
+    aabb.max = glm::max(aabb.max, aabb.max + back);
+    syncBroadPhase(i, false);
+  }
+  m_broadPhase->flush();
 }
 
-void PhysicsEngine::narrowPhaseCollision() {
-  m_collisions.clear();
-  
-  for (const auto& pair : m_potentialCollisions) {
-    RigidBody* bodyA = pair.first;
-    RigidBody* bodyB = pair.second;
-    
-    if (!bodyA->active || !bodyB->active) {
-      continue;
+// Time of impact sub-stepping for bullets. The discrete solve already ran,
+// so each bullet's motion over the step is known; it is swept against the
+// bodies the broad phase finds along the way and the boundary planes.
+// Targets move linearly from their step start to their end position, so
+// each sweep runs in the target's frame. At the first hit the bullet stops
+// just short of the target, exchanges a restitution impulse with it and
+// moves on with its new velocity for the rest of the step, up to
+// MAX_TOI_ITERATIONS times.
+void PhysicsEngine::solveContinuous(float dt) {
+  if (m_bulletStarts.empty()) return;
+
+  sweepMovedAABBs();
+  const uint32_t activeCount = static_cast<uint32_t>(m_bodies.activeCount());
+
+  for (const BulletStart& bullet : m_bulletStarts) {
+    const uint32_t body = bullet.body;
+    const float radius = m_bodies.shapeExtents[body].x;
+
+    glm::vec2 start = bullet.position;
+    glm::vec2 end = m_bodies.positions[body];
+    float remaining = dt;
+
+    for (int iteration = 0; iteration < MAX_TOI_ITERATIONS; ++iteration) {
+      if (start == end) break;
+
+      AABB sweep;
+      sweep.min = glm::min(start, end) - glm::vec2(radius);
+      sweep.max = glm::max(start, end) + glm::vec2(radius);
+      m_broadPhase->query(sweep, m_toiCandidates);
+
+      float toi = 1.0f;
+      glm::vec2 normal(0.0f);
+      uint32_t target = BodyHandle::INVALID_INDEX;
+      uint32_t feature = 0;
+
+      for (uint32_t candidate : m_toiCandidates) {
+        if (candidate == body || !m_bodies.active[candidate]) continue;
+        if (!m_bodies.filters[body].shouldCollide(m_bodies.filters[candidate])) continue;
+
+        // Relative to the target's end position the bullet starts offset by
+        // the part of the target's motion still ahead in this step.
+        glm::vec2 relativeStart = start;
+        if (candidate < activeCount) {
+          glm::vec2 motion = m_bodies.positions[candidate] - m_bodies.stepStartPositions[candidate];
+          relativeStart += motion * (remaining / dt);
+        }
+
+        float candidateToi;
+        glm::vec2 candidateNormal;
+        bool hit = m_bodies.shapeTypes[candidate] == ShapeType::CIRCLE
+          ? sweepCircleVsCircle(relativeStart, end, radius, m_bodies.positions[candidate],
+                                m_bodies.shapeExtents[candidate].x, candidateToi, candidateNormal)
+          : sweepCircleVsRectangle(relativeStart, end, radius, m_bodies.positions[candidate],
+                                   m_bodies.shapeExtents[candidate], candidateToi, candidateNormal);
+        if (hit && candidateToi < toi) {
+          toi = candidateToi;
+          normal = candidateNormal;
+          target = candidate;
+        }
+      }
+
+      for (uint32_t p = 0; p < m_boundaryPlanes.size(); ++p) {
+        const BoundaryPlane& plane = m_boundaryPlanes[p];
+        float startDistance = glm::dot(plane.normal, start) - plane.offset - radius;
+        float endDistance = glm::dot(plane.normal, end) - plane.offset - radius;
+        if (startDistance < 0.0f || endDistance >= 0.0f) continue;
+
+        float planeToi = startDistance / (startDistance - endDistance);
+        if (planeToi < toi) {
+          toi = planeToi;
+          normal = -plane.normal;
+          target = BodyHandle::INVALID_INDEX;
+          feature = p;
+        }
+      }
+
+      if (toi >= 1.0f) break;
+
+      const bool worldTarget = target == BodyHandle::INVALID_INDEX;
+      glm::vec2 contact = start + (end - start) * toi - normal * ContactSolver::LINEAR_SLOP;
+
+      float invMassA = m_bodies.invMasses[body];
+      bool movableB = !worldTarget && target < m_bodies.activeCount();
+      float invMassB = movableB ? m_bodies.invMasses[target] : 0.0f;
+      glm::vec2& velocityA = m_bodies.velocities[body];
+      glm::vec2 velocityB = movableB ? m_bodies.velocities[target] : glm::vec2(0.0f);
+
+      float normalVelocity = glm::dot(velocityB - velocityA, normal);
+      if (normalVelocity < 0.0f && invMassA + invMassB > 0.0f) {
+        float restitutionA = m_bodies.cold[body].restitution;
+        float restitution = worldTarget ? restitutionA : std::min(restitutionA, m_bodies.cold[target].restitution);
+        float impulse = -(1.0f + restitution) * normalVelocity / (invMassA + invMassB);
+        velocityA -= normal * (impulse * invMassA);
+        if (movableB) {
+          m_bodies.velocities[target] += normal * (impulse * invMassB);
+        }
+      }
+
+      if (!worldTarget && m_bodies.sleepIslands[target] != BodyHandle::INVALID_INDEX) {
+        wakeIsland(m_bodies.sleepIslands[target]);
+      }
+
+      Collision collision;
+      collision.bodyA = body;
+      collision.bodyB = target;
+      collision.handleA = m_bodies.handleAt(body);
+      if (!worldTarget) {
+        collision.handleB = m_bodies.handleAt(target);
+      }
+      collision.normal = normal;
+      collision.contactPoint = contact + normal * radius;
+      collision.feature = feature;
+      collision.hasCollision = true;
+      recordContact(collision);
+
+      remaining *= 1.0f - toi;
+      start = contact;
+      end = contact + velocityA * remaining;
     }
-    
-    if (bodyA->type == BodyType::STATIC && bodyB->type == BodyType::STATIC) {
-      continue;
+
+    if (end != m_bodies.positions[body]) {
+      m_bodies.positions[body] = end;
+      m_bodies.prevPositions[body] = end - m_bodies.velocities[body] * dt;
+      m_bodies.updateAABB(body);
     }
-    
-    Collision collision;
-    if (detectCollision(*bodyA, *bodyB, collision)) {
-      m_collisions.push_back(collision);
-      
-      if (m_collisionCallback) {
-        m_collisionCallback(collision);
+  }
+}
+
+// Splits the step into substeps of predict, narrow phase on the pairs the
+// broad phase already found, contact projection, velocity update and a
+// velocity pass for restitution and friction. A pair that touches in any
+// substep counts as touching for the step's contact events.
+void PhysicsEngine::substep(float dt) {
+  XPBDSolver& solver = static_cast<XPBDSolver&>(*m_solver);
+  const int substeps = std::max(m_config.substeps, 1);
+  const float h = dt / static_cast<float>(substeps);
+  const uint32_t count = static_cast<uint32_t>(m_bodies.activeCount());
+
+  for (int step = 0; step < substeps; ++step) {
+    {
+      ScopedPhaseTimer timer(profile(), PhysicsPhase::INTEGRATION);
+      integrate(h);
+    }
+    {
+      ScopedPhaseTimer timer(profile(), PhysicsPhase::BROAD_PHASE_UPDATE);
+      updateAABBs();
+    }
+    {
+      ScopedPhaseTimer timer(profile(), PhysicsPhase::NARROW_PHASE);
+      narrowPhaseCollision();
+      boundaryCollision();
+      recordContacts();
+    }
+    {
+      ScopedPhaseTimer timer(profile(), PhysicsPhase::CONTACT_SOLVER);
+      m_contactSolver.projectContacts(m_bodies, m_collisions);
+    }
+    {
+      ScopedPhaseTimer timer(profile(), PhysicsPhase::INTEGRATION);
+      if (!m_jobSystem) {
+        solver.updateVelocities(m_bodies, 0, count, h);
+      } else {
+        m_jobSystem->parallelFor(count, INTEGRATE_GRAIN_SIZE, [this, &solver, h](uint32_t begin, uint32_t end, uint32_t) {
+          solver.updateVelocities(m_bodies, begin, end, h);
+        });
       }
     }
+    {
+      ScopedPhaseTimer timer(profile(), PhysicsPhase::CONTACT_SOLVER);
+      m_contactSolver.solveContactVelocities(m_bodies, h);
+    }
+  }
+
+  std::fill(m_bodies.forces.begin(), m_bodies.forces.begin() + count, glm::vec2(0.0f));
+  std::fill(m_bodies.torques.begin(), m_bodies.torques.begin() + count, 0.0f);
+}
+
+void PhysicsEngine::updateBroadPhase() {
+  const uint32_t activeCount = static_cast<uint32_t>(m_bodies.activeCount());
+  const uint32_t dynamicCount = static_cast<uint32_t>(m_bodies.dynamicCount());
+  for (uint32_t i = 0; i < activeCount; ++i) {
+    syncBroadPhase(i, false);
+  }
+
+  // Sleeping bodies sit in the broad phase as statics: they are not moved
+  // every step and never pair with each other. Inactive ones are removed.
+  // Both only change when the partition does.
+  if (m_partitionChanged || m_staticsDirty) {
+    for (uint32_t i = activeCount; i < dynamicCount; ++i) {
+      m_bodies.updateAABB(i);
+      syncBroadPhase(i, true);
+    }
+  }
+
+  // Static bodies only reach the broad phase when they are added, moved
+  // through updateStaticBody() or the broad phase is replaced.
+  if (m_staticsDirty) {
+    const uint32_t count = static_cast<uint32_t>(m_bodies.size());
+    for (uint32_t i = dynamicCount; i < count; ++i) {
+      m_bodies.updateAABB(i);
+      syncBroadPhase(i, true);
+    }
+    m_staticsDirty = false;
+  } else {
+    for (BodyHandle handle : m_dirtyStatics) {
+      uint32_t index = m_bodies.denseIndex(handle);
+      if (index == BodyHandle::INVALID_INDEX) continue;
+
+      m_bodies.updateAABB(index);
+      syncBroadPhase(index, index >= activeCount);
+    }
   }
+  m_dirtyStatics.clear();
+  m_broadPhase->flush();
 }
 
-void PhysicsEngine::resolveCollisions() {
-  for (auto& collision : m_collisions) {
-    resolveCollision(collision);
+void PhysicsEngine::syncBroadPhase(uint32_t index, bool isStatic) {
+  if (m_bodies.active[index]) {
+    m_broadPhase->update(index, m_bodies.aabbs[index], isStatic, m_bodies.filters[index]);
+  } else {
+    m_broadPhase->remove(index);
   }
 }
 
-void PhysicsEngine::resolveCollision(Collision& collision) {
-  RigidBody* bodyA = collision.bodyA;
-  RigidBody* bodyB = collision.bodyB;
-  
-  if (bodyA->type == BodyType::STATIC && bodyB->type == BodyType::STATIC) {
+// The broad phase holds the AABBs from the start of the last step. Before
+// answering queries it is synced the same way update() does, so the next
+// step finds nothing left to move.
+void PhysicsEngine::syncQueries() {
+  bool dirty = m_queriesDirty || m_staticsDirty || !m_dirtyStatics.empty() || !m_bodies.wokenBodies.empty();
+  if (!dirty) return;
+
+  wakeRequestedIslands();
+  m_partitionChanged = m_bodies.partitionActive();
+  updateAABBs();
+  updateBroadPhase();
+  m_queriesDirty = false;
+}
+
+bool PhysicsEngine::raycast(const Ray& ray, RaycastHit& hit) {
+  syncQueries();
+  castRay(ray, hit);
+  return hit.hit;
+}
+
+// Rays starting close together walk the same cells and tree nodes, so they
+// are traced in Morton order of their origins. The order is sorted in
+// m_rayOrder and the hits go straight to the caller's buffer, so a batch
+// allocates nothing once m_rayOrder has grown.
+void PhysicsEngine::raycastBatch(const Ray* rays, RaycastHit* hits, size_t count) {
+  if (count == 0) return;
+  syncQueries();
+
+  glm::vec2 lower = rays[0].from;
+  glm::vec2 upper = rays[0].from;
+  for (size_t i = 1; i < count; ++i) {
+    lower = glm::min(lower, rays[i].from);
+    upper = glm::max(upper, rays[i].from);
+  }
+
+  glm::vec2 scale = 65535.0f / glm::max(upper - lower, glm::vec2(1e-6f));
+  m_rayOrder.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    glm::vec2 cell = (rays[i].from - lower) * scale;
+    uint64_t code = mortonCode(static_cast<uint32_t>(cell.x), static_cast<uint32_t>(cell.y));
+    m_rayOrder[i] = (code << 32) | static_cast<uint64_t>(i);
+  }
+  std::sort(m_rayOrder.begin(), m_rayOrder.end());
+
+  const uint32_t rayCount = static_cast<uint32_t>(count);
+  if (!m_jobSystem) {
+    for (uint32_t k = 0; k < rayCount; ++k) {
+      uint32_t i = static_cast<uint32_t>(m_rayOrder[k]);
+      castRay(rays[i], hits[i]);
+    }
     return;
   }
+
+  struct Batch {
+    const Ray* rays;
+    RaycastHit* hits;
+  } batch{rays, hits};
+
+  m_jobSystem->parallelFor(rayCount, RAYCAST_GRAIN_SIZE, [this, &batch](uint32_t begin, uint32_t end, uint32_t) {
+    for (uint32_t k = begin; k < end; ++k) {
+      uint32_t i = static_cast<uint32_t>(m_rayOrder[k]);
+      castRay(batch.rays[i], batch.hits[i]);
+    }
+  });
+}
+
+size_t PhysicsEngine::queryAABB(const AABB& aabb, BodyHandle* results, size_t capacity) {
+  syncQueries();
+
+  OverlapCollector collector(m_bodies, aabb, results, capacity);
+  m_broadPhase->queryAABB(aabb, collector);
+  return collector.count;
+}
+
+size_t PhysicsEngine::queryPoint(const glm::vec2& point, BodyHandle* results, size_t capacity) {
+  return queryAABB(AABB(point, point), results, capacity);
+}
+
+// Read-only, so batches call it from several threads at once.
+void PhysicsEngine::castRay(const Ray& ray, RaycastHit& hit) const {
+  ClosestRayHit closest(m_bodies, ray);
+  m_broadPhase->rayCast(ray.from, ray.to, closest);
+
+  hit = RaycastHit();
+  if (closest.body != BodyHandle::INVALID_INDEX) {
+    hit.body = m_bodies.handleAt(closest.body);
+    hit.normal = closest.normal;
+    hit.fraction = closest.fraction;
+    hit.hit = true;
+  }
+
+  for (const BoundaryPlane& plane : m_boundaryPlanes) {
+    float startDistance = glm::dot(plane.normal, ray.from) - plane.offset;
+    float endDistance = glm::dot(plane.normal, ray.to) - plane.offset;
+    if (startDistance < 0.0f || endDistance >= 0.0f) continue;
+
+    float fraction = startDistance / (startDistance - endDistance);
+    if (fraction < hit.fraction) {
+      hit.body = BodyHandle();
+      hit.normal = plane.normal;
+      hit.fraction = fraction;
+      hit.hit = true;
+    }
+  }
+
+  hit.point = ray.from + (ray.to - ray.from) * hit.fraction;
+}
+
+void PhysicsEngine::broadPhaseCollision() {
+  m_broadPhase->computePairs(m_potentialCollisions);
+}
+
+bool PhysicsEngine::reorderDue() const {
+  if (m_reorderInterval > 0 && m_stepsSinceReorder >= m_reorderInterval) return true;
+  return m_reorderThreshold > 0.0f && m_reorderPairSpan > 0.0f && m_pairSpan > m_reorderPairSpan * m_reorderThreshold;
+}
+
+// The first measurement after a reorder is the reference the threshold
+// compares against.
+void PhysicsEngine::measurePairSpan() {
+  uint64_t span = 0;
+  for (const BodyPair& pair : m_potentialCollisions) {
+    span += pair.b - pair.a;
+  }
+  m_pairSpan = m_potentialCollisions.empty() ? 0.0f
+    : static_cast<float>(static_cast<double>(span) / static_cast<double>(m_potentialCollisions.size()));
+  if (m_reorderPairSpan == 0.0f) {
+    m_reorderPairSpan = m_pairSpan;
+  }
+}
+
+// Only the simulated prefix is sorted: sleeping and static bodies are not
+// streamed every step, and the partition would scatter sleeping bodies again
+// as they wake. Bodies in the same cell keep their relative order, so
+// re-sorting a layout that is still in order moves nothing.
+void PhysicsEngine::reorderBodies() {
+  m_reorderPairSpan = 0.0f;
+  m_stepsSinceReorder = 0;
+  const uint32_t count = static_cast<uint32_t>(m_bodies.activeCount());
+  if (count < 2) return;
+
+  glm::vec2 lower = m_bodies.positions[0];
+  glm::vec2 upper = lower;
+  for (uint32_t i = 1; i < count; ++i) {
+    lower = glm::min(lower, m_bodies.positions[i]);
+    upper = glm::max(upper, m_bodies.positions[i]);
+  }
+
+  // Morton codes take 16 bits per axis; huge worlds get coarser cells.
+  const glm::vec2 span = upper - lower;
+  const float cellSize = std::max({m_config.spatialHashCellSize, span.x / 65535.0f, span.y / 65535.0f, 1e-6f});
+  const float inverseCellSize = 1.0f / cellSize;
+  m_reorderKeys.resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    glm::vec2 cell = glm::min((m_bodies.positions[i] - lower) * inverseCellSize, glm::vec2(65535.0f));
+    uint64_t code = mortonCode(static_cast<uint32_t>(cell.x), static_cast<uint32_t>(cell.y));
+    m_reorderKeys[i] = (code << 32) | static_cast<uint64_t>(i);
+  }
+  std::sort(m_reorderKeys.begin(), m_reorderKeys.end());
+
+  m_reorderOrder.resize(count);
+  for (uint32_t k = 0; k < count; ++k) {
+    m_reorderOrder[k] = static_cast<uint32_t>(m_reorderKeys[k]);
+  }
+  if (!std::is_sorted(m_reorderOrder.begin(), m_reorderOrder.end())) {
+    m_bodies.reorder(0, m_reorderOrder);
+  }
+  m_reordered = true;
+  m_queriesDirty = true;
+}
+
+void PhysicsEngine::setJobSystem(JobSystem* jobSystem) {
+  m_jobSystem = jobSystem;
+}
+
+// Circle-circle pairs, the bulk of particle scenes, are queued by index in
+// batches for the SIMD kernel; every other shape pair goes through
+// detectCollision() directly.
+void PhysicsEngine::narrowPhaseRange(uint32_t begin, uint32_t end, NarrowPhaseScratch& scratch, std::vector<Collision>& collisions) const {
+  CirclePairBatch& circles = scratch.circles;
+  circles.clear();
   
-  glm::vec2 relativeVelocity = bodyB->velocity - bodyA->velocity;
-  
-  float normalVelocity = glm::dot(relativeVelocity, collision.normal);
+  const uint32_t activeCount = static_cast<uint32_t>(m_bodies.activeCount());
   
-  if (normalVelocity > 0) {
-    return;
+  for (uint32_t i = begin; i < end; ++i) {
+    uint32_t bodyA = m_potentialCollisions[i].a;
+    uint32_t bodyB = m_potentialCollisions[i].b;
+    
+    if (!m_bodies.active[bodyA] || !m_bodies.active[bodyB]) {
+      continue;
+    }
+    
+    // Neither body simulated: both static, sleeping or a mix.
+    if (bodyA >= activeCount && bodyB >= activeCount) {
+      continue;
+    }
+    
+    if (m_bodies.shapeTypes[bodyA] == ShapeType::CIRCLE && m_bodies.shapeTypes[bodyB] == ShapeType::CIRCLE) {
+      circles.push(bodyA, bodyB);
+      if (circles.full()) {
+        flushCircleBatch(scratch, collisions);
+      }
+      continue;
+    }
+    
+    Collision collision;
+    if (detectCollision(m_bodies, bodyA, bodyB, collision)) {
+      collision.handleA = m_bodies.handleAt(collision.bodyA);
+      collision.handleB = m_bodies.handleAt(collision.bodyB);
+      collisions.push_back(collision);
+    }
   }
   
-  float restitution = std::min(bodyA->restitution, bodyB->restitution);
-  
-  float j = -(1.0f + restitution) * normalVelocity;
-  j /= bodyA->invMass + bodyB->invMass;
+  flushCircleBatch(scratch, collisions);
+}
+
+void PhysicsEngine::flushCircleBatch(NarrowPhaseScratch& scratch, std::vector<Collision>& collisions) const {
+  const CirclePairBatch& circles = scratch.circles;
+  const CircleContactBatch& contacts = scratch.circleContacts;
   
-  glm::vec2 impulse = j * collision.normal;
+  collideCircleBatch(m_bodies, circles, scratch.circleContacts);
   
-  if (bodyA->type == BodyType::DYNAMIC) {
-    bodyA->applyImpulse(-impulse, collision.contactPoint);
+  for (uint32_t c = 0; c < contacts.count; ++c) {
+    uint32_t i = contacts.pair[c];
+    
+    Collision collision;
+    collision.bodyA = circles.bodyA[i];
+    collision.bodyB = circles.bodyB[i];
+    collision.handleA = m_bodies.handleAt(collision.bodyA);
+    collision.handleB = m_bodies.handleAt(collision.bodyB);
+    collision.normal = glm::vec2(contacts.nx[c], contacts.ny[c]);
+    collision.penetration = contacts.penetration[c];
+    collision.contactPoint = m_bodies.positions[collision.bodyA] + collision.normal * m_bodies.shapeExtents[collision.bodyA].x;
+    collision.hasCollision = true;
+    collisions.push_back(collision);
   }
   
-  if (bodyB->type == BodyType::DYNAMIC) {
-    bodyB->applyImpulse(impulse, collision.contactPoint);
-  }
+  scratch.circles.clear();
+}
+
+// Contacts are gathered into one buffer per thread and then sorted by body
+// pair, so the contact order (and everything the solver derives from it)
+// does not depend on the thread count or on scheduling.
+void PhysicsEngine::narrowPhaseCollision() {
+  m_collisions.clear();
   
-  const float percent = 0.2f; 
-  const float slop = 0.01f;   
+  const uint32_t pairCount = static_cast<uint32_t>(m_potentialCollisions.size());
   
-  glm::vec2 correction = std::max(collision.penetration - slop, 0.0f) * percent * 
-                        collision.normal / (bodyA->invMass + bodyB->invMass);
+  const size_t threadCount = m_jobSystem ? m_jobSystem->getThreadCount() : 1;
+  while (m_narrowPhaseScratch.size() < threadCount) {
+    m_narrowPhaseScratch.push_back(std::make_unique<NarrowPhaseScratch>());
+  }
   
-  if (bodyA->type == BodyType::DYNAMIC) {
-    bodyA->position -= correction * bodyA->invMass;
+  if (!m_jobSystem || pairCount <= NARROW_PHASE_GRAIN_SIZE) {
+    narrowPhaseRange(0, pairCount, *m_narrowPhaseScratch[0], m_collisions);
+  } else {
+    for (auto& scratch : m_narrowPhaseScratch) {
+      scratch->collisions.clear();
+    }
+    
+    m_jobSystem->parallelFor(pairCount, NARROW_PHASE_GRAIN_SIZE, [this](uint32_t begin, uint32_t end, uint32_t thread) {
+      NarrowPhaseScratch& scratch = *m_narrowPhaseScratch[thread];
+      narrowPhaseRange(begin, end, scratch, scratch.collisions);
+    });
+    
+    for (const auto& scratch : m_narrowPhaseScratch) {
+      m_collisions.insert(m_collisions.end(), scratch->collisions.begin(), scratch->collisions.end());
+    }
   }
   
-  if (bodyB->type == BodyType::DYNAMIC) {
-    bodyB->position += correction * bodyB->invMass;
+  std::sort(m_collisions.begin(), m_collisions.end(), [](const Collision& a, const Collision& b) {
+    return BodyPair(a.bodyA, a.bodyB) < BodyPair(b.bodyA, b.bodyB);
+  });
+}
+
+// Boundary planes are infinite half-spaces tested directly against every
+// moving body, so world walls never enter the broad phase. The plane acts as
+// bodyB with an invalid index and handle.
+void PhysicsEngine::boundaryCollision() {
+  if (m_boundaryPlanes.empty()) return;
+
+  const uint32_t count = static_cast<uint32_t>(m_bodies.activeCount());
+  for (uint32_t i = 0; i < count; ++i) {
+    const glm::vec2& position = m_bodies.positions[i];
+    glm::vec2 halfExtent = (m_bodies.aabbs[i].max - m_bodies.aabbs[i].min) * 0.5f;
+
+    for (uint32_t p = 0; p < m_boundaryPlanes.size(); ++p) {
+      const BoundaryPlane& plane = m_boundaryPlanes[p];
+      float support = m_bodies.shapeTypes[i] == ShapeType::CIRCLE
+        ? m_bodies.shapeExtents[i].x
+        : std::abs(plane.normal.x) * halfExtent.x + std::abs(plane.normal.y) * halfExtent.y;
+
+      float distance = glm::dot(plane.normal, position) - plane.offset - support;
+      if (distance >= 0.0f) continue;
+
+      Collision collision;
+      collision.bodyA = i;
+      collision.bodyB = BodyHandle::INVALID_INDEX;
+      collision.handleA = m_bodies.handleAt(i);
+      collision.normal = -plane.normal;
+      collision.penetration = -distance;
+      collision.contactPoint = position - plane.normal * support;
+      collision.feature = p;
+      collision.hasCollision = true;
+      m_collisions.push_back(collision);
+    }
+  }
+}
+
+void PhysicsEngine::beginContactEvents() {
+  m_contactEvents.clear();
+  m_nextContacts.clear();
+}
+
+void PhysicsEngine::recordContacts() {
+  for (const Collision& collision : m_collisions) {
+    recordContact(collision);
+  }
+}
+
+// Pairs are keyed by handle slot like the contact solver's impulse cache,
+// with one key per boundary plane. The first contact of a pair in a step
+// is the one reported.
+void PhysicsEngine::recordContact(const Collision& collision) {
+  const bool worldB = collision.bodyB == BodyHandle::INVALID_INDEX;
+  uint32_t slotB = worldB ? BodyHandle::INVALID_INDEX - collision.feature : collision.handleB.index;
+  uint64_t key = BodyPair(collision.handleA.index, slotB).key();
+
+  bool inserted;
+  ContactEvent& event = m_nextContacts.insert(key, &inserted);
+  if (!inserted) return;
+
+  event.bodyA = collision.handleA;
+  event.bodyB = collision.handleB;
+  event.normal = collision.normal;
+  event.contactPoint = collision.contactPoint;
+  event.penetration = collision.penetration;
+  event.feature = collision.feature;
+
+  const ContactEvent* previous = m_contacts.find(key);
+  event.type = previous && sameContactPair(*previous, event) ? ContactEventType::PERSIST : ContactEventType::BEGIN;
+  m_contactEvents.push_back(event);
+}
+
+// Pairs from last step that were not seen again have ended, unless neither
+// body is simulated any more: sleeping bodies produce no contacts, so their
+// pairs are carried over silently and persist once the island wakes. A pair
+// whose slot now belongs to a different body ended as well.
+void PhysicsEngine::finishContactEvents() {
+  const size_t activeCount = m_bodies.activeCount();
+  auto resting = [this, activeCount](BodyHandle handle) {
+    if (!handle.isValid()) return true;
+    uint32_t index = m_bodies.denseIndex(handle);
+    return index != BodyHandle::INVALID_INDEX && index >= activeCount && m_bodies.active[index];
+  };
+
+  m_contacts.forEach([this, &resting](uint64_t key, const ContactEvent& previous) {
+    const ContactEvent* current = m_nextContacts.find(key);
+    if (current) {
+      if (sameContactPair(previous, *current)) return;
+    } else if (resting(previous.bodyA) && resting(previous.bodyB)) {
+      m_nextContacts.insert(key) = previous;
+      return;
+    }
+
+    ContactEvent& ended = m_contactEvents.emplace_back(previous);
+    ended.type = ContactEventType::END;
+  });
+
+  std::swap(m_contacts, m_nextContacts);
+}
+
+bool PhysicsEngine::sameContactPair(const ContactEvent& a, const ContactEvent& b) {
+  return (a.bodyA == b.bodyA && a.bodyB == b.bodyB) || (a.bodyA == b.bodyB && a.bodyB == b.bodyA);
+}
+
+void PhysicsEngine::resolveCollisions(float dt) {
+  m_contactSolver.solveVelocities(m_bodies, m_config.velocityIterations, dt);
+  m_contactSolver.solvePositions(m_bodies, m_config.positionIterations);
+}
+
+void PhysicsEngine::wakeRequestedIslands() {
+  for (size_t i = 0; i < m_bodies.wokenBodies.size(); ++i) {
+    uint32_t index = m_bodies.denseIndex(m_bodies.wokenBodies[i]);
+    if (index != BodyHandle::INVALID_INDEX && m_bodies.sleepIslands[index] != BodyHandle::INVALID_INDEX) {
+      wakeIsland(m_bodies.sleepIslands[index]);
+    }
+  }
+  m_bodies.wokenBodies.clear();
+}
+
+// Only flags the bodies; they rejoin the simulated prefix at the next
+// partitionActive(), so dense indices stay valid for the rest of a step.
+void PhysicsEngine::wakeIsland(uint32_t island) {
+  std::vector<BodyHandle>& bodies = m_sleepingIslands[island];
+  if (bodies.empty()) return;
+
+  for (BodyHandle handle : bodies) {
+    uint32_t index = m_bodies.denseIndex(handle);
+    if (index == BodyHandle::INVALID_INDEX) continue;
+
+    m_bodies.sleepIslands[index] = BodyHandle::INVALID_INDEX;
+    m_bodies.setAwake(index, true);
   }
-}
\ No newline at end of file
+
+  bodies.clear();
+  m_freeIslands.push_back(island);
+}
+
+uint32_t PhysicsEngine::findIsland(uint32_t body) {
+  while (m_islandParents[body] != body) {
+    m_islandParents[body] = m_islandParents[m_islandParents[body]];
+    body = m_islandParents[body];
+  }
+  return body;
+}
+
+// Union-find over this step's contacts between simulated bodies. Static
+// bodies and the world do not join islands. An island sleeps once every
+// body in it has been slow for timeToSleep; a contact with a body that is
+// asleep wakes that body's island instead.
+void PhysicsEngine::updateSleep(float dt) {
+  if (!m_config.allowSleep) return;
+
+  const uint32_t count = static_cast<uint32_t>(m_bodies.activeCount());
+  const float linearTolerance = m_config.sleepLinearVelocity * m_config.sleepLinearVelocity;
+
+  m_islandParents.resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    m_islandParents[i] = i;
+
+    const glm::vec2& velocity = m_bodies.velocities[i];
+    bool slow = glm::dot(velocity, velocity) <= linearTolerance &&
+                std::abs(m_bodies.angularVelocities[i]) <= m_config.sleepAngularVelocity;
+    m_bodies.sleepTimes[i] = slow ? m_bodies.sleepTimes[i] + dt : 0.0f;
+  }
+
+  for (const Collision& collision : m_collisions) {
+    uint32_t a = collision.bodyA;
+    uint32_t b = collision.bodyB;
+    if (b == BodyHandle::INVALID_INDEX) continue;
+
+    bool simulatedA = a < count;
+    bool simulatedB = b < count;
+    if (simulatedA && simulatedB) {
+      uint32_t rootA = findIsland(a);
+      uint32_t rootB = findIsland(b);
+      if (rootA != rootB) {
+        m_islandParents[rootA] = rootB;
+      }
+      continue;
+    }
+
+    uint32_t other = simulatedA ? b : a;
+    if (m_bodies.types[other] == BodyType::STATIC) continue;
+
+    uint32_t island = m_bodies.sleepIslands[other];
+    if (island != BodyHandle::INVALID_INDEX) {
+      wakeIsland(island);
+    }
+    m_bodies.sleepTimes[simulatedA ? a : b] = 0.0f;
+  }
+
+  m_islandSleepTimes.assign(count, m_config.timeToSleep);
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t root = findIsland(i);
+    m_islandSleepTimes[root] = std::min(m_islandSleepTimes[root], m_bodies.sleepTimes[i]);
+  }
+
+  m_islandIds.assign(count, BodyHandle::INVALID_INDEX);
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t root = findIsland(i);
+    if (m_islandSleepTimes[root] < m_config.timeToSleep) continue;
+
+    if (m_islandIds[root] == BodyHandle::INVALID_INDEX) {
+      if (!m_freeIslands.empty()) {
+        m_islandIds[root] = m_freeIslands.back();
+        m_freeIslands.pop_back();
+      } else {
+        m_islandIds[root] = static_cast<uint32_t>(m_sleepingIslands.size());
+        m_sleepingIslands.emplace_back();
+      }
+    }
+
+    uint32_t island = m_islandIds[root];
+    m_sleepingIslands[island].push_back(m_bodies.handleAt(i));
+    m_bodies.sleepIslands[i] = island;
+    m_bodies.velocities[i] = glm::vec2(0.0f);
+    m_bodies.prevPositions[i] = m_bodies.positions[i];
+    m_bodies.angularVelocities[i] = 0.0f;
+    m_bodies.setAwake(i, false);
+  }
+}
@@ -2,22 +2,34 @@
 
 #include "Core/common.hpp"
 #include "body.hpp"
+#include "BodyStorage.hpp"
+#include "BroadPhase.hpp"
 #include "SpatialHash.hpp"
+#include "SweepAndPrune.hpp"
+#include "AABBTreeBroadPhase.hpp"
+#include "NarrowPhaseKernels.hpp"
+#include "ContactSolver.hpp"
+#include "PairTable.hpp"
+#include "Core/JobSystem.hpp"
 #include <vector>
 #include <memory>
-#include <functional>
 
 class PhysicsEngine;
 
 enum class IntegrationMethod {
   VERLET,
-  LEAPFROG
+  LEAPFROG,
+  XPBD
 };
 
 class Solver {
 public:
   virtual ~Solver() = default;
-  virtual void integrate(std::vector<RigidBody>& bodies, float dt) = 0;
+  // Every body in [begin, end) must be active and non-static.
+  virtual void integrate(BodyStorage& bodies, size_t begin, size_t end, float dt) = 0;
+  void setGravity(const glm::vec2& gravity) { m_gravity = gravity; }
+protected:
+  glm::vec2 m_gravity = {0.0f, 9.81f};
 };
 
 class VerletSolver : public Solver {
@@ -25,9 +37,7 @@ public:
   VerletSolver() = default;
   ~VerletSolver() override = default;
 
-  void integrate(std::vector<RigidBody>& bodies, float dt) override;
-private:
-  glm::vec2 m_gravity = {0.0f, 9.81f};
+  void integrate(BodyStorage& bodies, size_t begin, size_t end, float dt) override;
 };
 
 class LeapFrogSolver : public Solver {
@@ -35,31 +45,160 @@ public:
   LeapFrogSolver() = default;
   ~LeapFrogSolver() override = default;
 
-  void integrate(std::vector<RigidBody>& bodies, float dt) override;
-private:
-  glm::vec2 m_gravity = {0.0f, 9.81f};
+  void integrate(BodyStorage& bodies, size_t begin, size_t end, float dt) override;
+};
+
+// Prediction step of an XPBD substep: prevPositions keeps the substep's
+// start so updateVelocities() can derive the velocity after the contacts
+// moved the bodies. Forces are left in place for the remaining substeps.
+class XPBDSolver : public Solver {
+public:
+  XPBDSolver() = default;
+  ~XPBDSolver() override = default;
+
+  void integrate(BodyStorage& bodies, size_t begin, size_t end, float dt) override;
+  void updateVelocities(BodyStorage& bodies, size_t begin, size_t end, float dt);
+};
+
+bool detectCollision(const BodyStorage& bodies, uint32_t bodyA, uint32_t bodyB, Collision& collision);
+bool circleVsCircle(const BodyStorage& bodies, uint32_t bodyA, uint32_t bodyB, Collision& collision);
+bool rectangleVsRectangle(const BodyStorage& bodies, uint32_t bodyA, uint32_t bodyB, Collision& collision);
+bool circleVsRectangle(const BodyStorage& bodies, uint32_t circle, uint32_t rectangle, Collision& collision);
+
+// Swept tests for a circle moving from start to end. On a hit, toi is the
+// fraction of the move in [0, 1] and normal points from the moving circle
+// into the target. Circles that already overlap at start are left to the
+// discrete tests and report no hit.
+bool sweepCircleVsCircle(const glm::vec2& start, const glm::vec2& end, float radius,
+                         const glm::vec2& center, float targetRadius, float& toi, glm::vec2& normal);
+bool sweepCircleVsRectangle(const glm::vec2& start, const glm::vec2& end, float radius,
+                            const glm::vec2& center, const glm::vec2& halfSize, float& toi, glm::vec2& normal);
+
+enum class PhysicsPhase {
+  BROAD_PHASE_UPDATE,  // waking, partitioning, AABBs and broad phase sync
+  PAIR_FINDING,
+  NARROW_PHASE,        // contacts, boundary planes and contact events
+  INTEGRATION,
+  CONTACT_SOLVER,
+  CONTINUOUS,
+  SLEEP,
+  COUNT
 };
 
-bool detectCollision(const RigidBody& bodyA, const RigidBody& bodyB, Collision& collision);
-bool circleVsCircle(const RigidBody& bodyA, const RigidBody& bodyB, Collision& collision);
-bool rectangleVsRectangle(const RigidBody& bodyA, const RigidBody& bodyB, Collision& collision);
-bool circleVsRectangle(const RigidBody& bodyA, const RigidBody& bodyB, Collision& collision);
+// Profile of the last update(), only filled while profiling is enabled. In
+// XPBD mode the substeps add up into their phases and contacts are those of
+// the last substep.
+struct PhysicsStats {
+  static constexpr size_t PHASE_COUNT = static_cast<size_t>(PhysicsPhase::COUNT);
+
+  uint64_t phaseNs[PHASE_COUNT] = {};
+  uint64_t stepNs = 0;
+
+  uint32_t bodies = 0;
+  uint32_t activeBodies = 0;
+  uint32_t sleepingBodies = 0;
+  uint32_t cellsUsed = 0;
+  uint32_t candidatePairs = 0;
+  uint32_t contacts = 0;
+  uint32_t solverIterations = 0;
+  float cacheHitRate = 0.0f;
+  // Mean dense index distance between the bodies of a candidate pair. Grows
+  // as the body order drifts away from the spatial order.
+  float pairSpan = 0.0f;
+  bool reordered = false;
+
+  uint64_t getPhaseNs(PhysicsPhase phase) const { return phaseNs[static_cast<size_t>(phase)]; }
+  static const char* getPhaseName(PhysicsPhase phase);
+};
 
 class PhysicsEngine {
 public:
   PhysicsEngine();
   ~PhysicsEngine();
 
-  size_t addBody(RigidBody&& body);
-  void removeBody(size_t index);
-  RigidBody* getBody(size_t index);
+  PhysicsEngine(const PhysicsEngine&) = delete;
+  PhysicsEngine& operator=(const PhysicsEngine&) = delete;
+
+  BodyHandle addBody(RigidBody&& body);
+  void addBodies(std::vector<RigidBody>&& bodies, std::vector<BodyHandle>* outHandles = nullptr);
+  void removeBody(BodyHandle handle);
+  void removeBodies(const std::vector<BodyHandle>& handles);
+  BodyRef getBody(BodyHandle handle);
+  bool isValid(BodyHandle handle) const { return m_bodies.contains(handle); }
+  size_t getBodyCount() const { return m_bodies.size(); }
+  // Read-only view for systems stepped beside the engine, such as
+  // ParticleSystem colliding with the static bodies.
+  const BodyStorage& getBodyStorage() const { return m_bodies; }
+  void reserveBodies(size_t count);
+  // Static bodies are not re-read every step; call this after moving one or
+  // changing its active flag.
+  void updateStaticBody(BodyHandle handle);
+  // Takes effect in the broad phase at the next step. Boundary planes
+  // collide with every body.
+  void setCollisionFilter(BodyHandle handle, const CollisionFilter& filter);
+  // Infinite wall keeping bodies on the side where dot(normal, p) >= offset.
+  void addBoundaryPlane(const glm::vec2& normal, float offset);
+  void clearBoundaryPlanes();
   void setIntegrationMethod(IntegrationMethod method);
   void setGravity(const glm::vec2& gravity);
   void setSpatialHashCellSize(float cellSize);
+  // Warm starting lets resting contacts converge in far fewer velocity
+  // iterations than the default eight.
+  void setSolverIterations(int velocityIterations, int positionIterations);
+  // Substeps per update() in XPBD mode. The broad phase still runs once.
+  void setSubstepCount(int substeps);
+  // Fraction of last step's contacts that were warm started from the cache.
+  float getContactCacheHitRate() const { return m_contactSolver.getCacheHitRate(); }
+  // Groups of touching bodies that stayed below the sleep velocities for
+  // timeToSleep seconds stop being simulated until something wakes them.
+  void setSleepEnabled(bool enabled);
+  size_t getAwakeBodyCount() const { return m_bodies.activeCount(); }
+  void setBroadPhase(BroadPhaseType type);
+  BroadPhase* getBroadPhase() const { return m_broadPhase.get(); }
+  // Scene queries against the bodies' current positions, served by the
+  // broad phase. The first query after a step, or after bodies were added,
+  // removed or woken, brings the broad phase up to date. Inactive bodies
+  // are never reported.
+  bool raycast(const Ray& ray, RaycastHit& hit);
+  // hits[i] receives the closest hit of rays[i]. Rays are traced in spatial
+  // order of their origins, in parallel when a job system is set.
+  void raycastBatch(const Ray* rays, RaycastHit* hits, size_t count);
+  // Write up to capacity handles and return how many bodies matched.
+  size_t queryAABB(const AABB& aabb, BodyHandle* results, size_t capacity);
+  size_t queryPoint(const glm::vec2& point, BodyHandle* results, size_t capacity);
+  // Not owned. Without a job system the step runs on the calling thread.
+  void setJobSystem(JobSystem* jobSystem);
   void update(float dt);
 
-  using CollisionCallback = std::function<void(const Collision&)>;
-  void setCollisionCallback(CollisionCallback callback);
+  // Simulation order drifts away from spatial order as bodies move, sleep
+  // and wake, and neighbours end up far apart in memory. reorderBodies()
+  // sorts the simulated bodies by Morton code of their broad phase cell;
+  // handles stay valid. A step reorders first when the interval has passed
+  // or the candidate pairs' mean index distance grew past threshold times
+  // its value after the last reorder. Both are off (0) by default.
+  void reorderBodies();
+  void setReorderInterval(uint32_t steps) { m_reorderInterval = steps; }
+  void setReorderThreshold(float ratio) { m_reorderThreshold = ratio; }
+
+  // Contact changes of the last update(), refilled every step: BEGIN and
+  // END once per touching pair and PERSIST for every step in between.
+  // Pairs of sleeping bodies report nothing until their island wakes.
+  const std::vector<ContactEvent>& getContactEvents() const { return m_contactEvents; }
+
+  // Per-phase timers and counters. Disabled, a step only tests the flag.
+  void setProfilingEnabled(bool enabled);
+  bool isProfilingEnabled() const { return m_profiling; }
+  const PhysicsStats& getStats() const { return m_stats; }
+
+  // Rollback support. saveSnapshot() copies the mutable simulation state of
+  // the dynamic bodies, the sleeping islands, the contact impulse cache and
+  // the contact pairs into buffer, reusing its capacity. Static bodies,
+  // body settings and engine settings are not included, and the contact
+  // events are empty until the next step. restoreSnapshot() only accepts a
+  // snapshot taken with the same bodies: adding or removing a body
+  // invalidates every earlier snapshot. A rejected snapshot changes nothing.
+  void saveSnapshot(std::vector<uint8_t>& buffer) const;
+  bool restoreSnapshot(const std::vector<uint8_t>& buffer);
 
   void debugDraw();
 private:
@@ -67,26 +206,118 @@ private:
     float gravity = 9.81f;
     glm::vec2 gravityVec = {0.0f, 9.81f};
     float spatialHashCellSize = 100.f;
+    float aabbTreeMargin = 4.0f;
     int velocityIterations = 8;
     int positionIterations = 3;
+    int substeps = 4;
     float damping = 0.99f;
+    bool allowSleep = true;
+    float sleepLinearVelocity = 0.5f;
+    float sleepAngularVelocity = 0.05f;
+    float timeToSleep = 0.5f;
   } m_config;
 
-  std::vector<RigidBody> m_bodies;
+  struct BoundaryPlane {
+    glm::vec2 normal;
+    float offset;
+  };
+
+  static constexpr uint32_t NARROW_PHASE_GRAIN_SIZE = 1024;
+  static constexpr uint32_t AABB_GRAIN_SIZE = 4096;
+  static constexpr uint32_t INTEGRATE_GRAIN_SIZE = 16384;
+  static constexpr uint32_t RAYCAST_GRAIN_SIZE = 256;
+  static constexpr int MAX_TOI_ITERATIONS = 4;
+  static constexpr uint32_t SNAPSHOT_MAGIC = 0x50534e50; // "PNSP"
+  static constexpr uint32_t SNAPSHOT_VERSION = 2;
+
+  struct BulletStart {
+    uint32_t body;
+    glm::vec2 position;
+  };
+
+  BodyStorage m_bodies;
+  std::vector<BodyHandle> m_pendingRemovals;
+  // Static or sleeping bodies to re-sync with the broad phase.
+  std::vector<BodyHandle> m_dirtyStatics;
+  bool m_staticsDirty = false;
+  bool m_partitionChanged = false;
+  bool m_queriesDirty = true;
+  std::vector<BoundaryPlane> m_boundaryPlanes;
+  bool m_stepping = false;
+  bool m_profiling = false;
+  PhysicsStats m_stats;
   std::unique_ptr<Solver> m_solver;
-  SpatialHash m_spatialHash;
-  CollisionCallback m_collisionCallback;
+  ContactSolver m_contactSolver;
+  std::unique_ptr<BroadPhase> m_broadPhase;
+  JobSystem* m_jobSystem = nullptr;
+  uint32_t m_reorderInterval = 0;
+  float m_reorderThreshold = 0.0f;
+  uint32_t m_stepsSinceReorder = 0;
+  float m_pairSpan = 0.0f;
+  float m_reorderPairSpan = 0.0f;
+  bool m_reordered = false;
   IntegrationMethod m_integrationMethod = IntegrationMethod::VERLET;
 
   void broadPhaseCollision();
+  bool reorderDue() const;
+  void measurePairSpan();
   void narrowPhaseCollision();
-  void resolveCollisions();
+  struct NarrowPhaseScratch {
+    std::vector<Collision> collisions;
+    CirclePairBatch circles;
+    CircleContactBatch circleContacts;
+  };
+
+  void narrowPhaseRange(uint32_t begin, uint32_t end, NarrowPhaseScratch& scratch, std::vector<Collision>& collisions) const;
+  void flushCircleBatch(NarrowPhaseScratch& scratch, std::vector<Collision>& collisions) const;
+  void boundaryCollision();
+  void beginContactEvents();
+  void recordContacts();
+  void recordContact(const Collision& collision);
+  void finishContactEvents();
+  static bool sameContactPair(const ContactEvent& a, const ContactEvent& b);
+  void resolveCollisions(float dt);
   void integrateVelocities(float dt);
   void integratePositions(float dt);
   void updateAABBs();
+  void prepareContinuous(float dt);
+  void sweepMovedAABBs();
+  void solveContinuous(float dt);
+  void integrate(float dt);
+  void substep(float dt);
 
-  void resolveCollision(Collision& collision);
-  void updateSpatialHash();
-  std::vector<std::pair<RigidBody*, RigidBody*>> m_potentialCollisions;
+  void updateBroadPhase();
+  void syncQueries();
+  void castRay(const Ray& ray, RaycastHit& hit) const;
+  void syncBroadPhase(uint32_t index, bool isStatic);
+  void flushPendingRemovals();
+  PhysicsStats* profile() { return m_profiling ? &m_stats : nullptr; }
+  void collectStats();
+  void writeSnapshot(SnapshotWriter& writer, uint64_t size) const;
+  static bool checkIslands(SnapshotReader& reader);
+  void destroyBody(BodyHandle handle);
+  void wakeRequestedIslands();
+  void wakeIsland(uint32_t island);
+  void updateSleep(float dt);
+  uint32_t findIsland(uint32_t body);
+  std::vector<BodyPair> m_potentialCollisions;
   std::vector<Collision> m_collisions;
+  std::vector<std::unique_ptr<NarrowPhaseScratch>> m_narrowPhaseScratch;
+  std::vector<BulletStart> m_bulletStarts;
+  std::vector<uint32_t> m_toiCandidates;
+  std::vector<uint32_t> m_staticOverlaps;
+  std::vector<uint64_t> m_rayOrder;
+  std::vector<uint64_t> m_reorderKeys;
+  std::vector<uint32_t> m_reorderOrder;
+  std::vector<ContactEvent> m_contactEvents;
+  PairTable<ContactEvent> m_contacts;
+  PairTable<ContactEvent> m_nextContacts;
+
+  // Bodies of each sleeping island by handle, so partition swaps while the
+  // island sleeps do not matter. Freed entries are reused.
+  std::vector<std::vector<BodyHandle>> m_sleepingIslands;
+  std::vector<uint32_t> m_freeIslands;
+  std::vector<uint32_t> m_islandParents;
+  std::vector<float> m_islandSleepTimes;
+  std::vector<uint32_t> m_islandIds;
 };
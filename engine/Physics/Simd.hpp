@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+
+// Thin wrappers over the widest float vector the build targets. Kernels are
+// written once against SimdLanes and fall back to one lane per "vector"
+// when no SIMD instruction set is available. AVX2 is opt-in (ENABLE_AVX2),
+// SSE2 is the x86-64 baseline and simd128 is used for WASM builds compiled
+// with -msimd128.
+//
+// glm::vec2 arrays are streamed as interleaved x/y floats, so one vector
+// covers WIDTH / 2 bodies. loadPairs() loads WIDTH / 2 per-body scalars and
+// repeats each one for the x and y lane; setPair() repeats an (x, y) pair
+// across the vector. gatherPairs() reads the (x, y) pairs of WIDTH bodies
+// by index and splits them into an x and a y vector; gatherX() reads only
+// the x of each.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PHYSIM_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PHYSIM_SIMD_SSE2 1
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define PHYSIM_SIMD_WASM 1
+#endif
+
+#if defined(PHYSIM_SIMD_AVX2)
+
+struct SimdLanes {
+  static constexpr uint32_t WIDTH = 8;
+  static constexpr const char* NAME = "avx2";
+  using Float = __m256;
+
+  static Float load(const float* p) { return _mm256_loadu_ps(p); }
+  static void store(float* p, Float v) { _mm256_storeu_ps(p, v); }
+  static Float set(float v) { return _mm256_set1_ps(v); }
+  static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+  static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+  static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+  static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+  static Float sqrt(Float a) { return _mm256_sqrt_ps(a); }
+  static Float lessEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+  static Float greater(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+  static Float select(Float mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+  static uint32_t mask(Float m) { return static_cast<uint32_t>(_mm256_movemask_ps(m)); }
+
+  static Float loadPairs(const float* p) {
+    return _mm256_permutevar8x32_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3));
+  }
+  static Float setPair(float x, float y) { return _mm256_setr_ps(x, y, x, y, x, y, x, y); }
+
+  // Plain loads beat vgatherdps for these random, cache-resident reads.
+  static void gatherPairs(const float* p, const uint32_t* index, Float& x, Float& y) {
+    Float lo = _mm256_insertf128_ps(_mm256_castps128_ps256(loadTwoPairs(p, index[0], index[1])),
+                                    loadTwoPairs(p, index[4], index[5]), 1);
+    Float hi = _mm256_insertf128_ps(_mm256_castps128_ps256(loadTwoPairs(p, index[2], index[3])),
+                                    loadTwoPairs(p, index[6], index[7]), 1);
+    x = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+    y = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+  }
+  static Float gatherX(const float* p, const uint32_t* index) {
+    return _mm256_setr_ps(p[2 * size_t{index[0]}], p[2 * size_t{index[1]}], p[2 * size_t{index[2]}], p[2 * size_t{index[3]}],
+                          p[2 * size_t{index[4]}], p[2 * size_t{index[5]}], p[2 * size_t{index[6]}], p[2 * size_t{index[7]}]);
+  }
+
+private:
+  static __m128 loadTwoPairs(const float* p, uint32_t first, uint32_t second) {
+    return _mm_loadh_pi(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p + 2 * size_t{first}))),
+                        reinterpret_cast<const __m64*>(p + 2 * size_t{second}));
+  }
+};
+
+#elif defined(PHYSIM_SIMD_SSE2)
+
+struct SimdLanes {
+  static constexpr uint32_t WIDTH = 4;
+  static constexpr const char* NAME = "sse2";
+  using Float = __m128;
+
+  static Float load(const float* p) { return _mm_loadu_ps(p); }
+  static void store(float* p, Float v) { _mm_storeu_ps(p, v); }
+  static Float set(float v) { return _mm_set1_ps(v); }
+  static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+  static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+  static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+  static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+  static Float sqrt(Float a) { return _mm_sqrt_ps(a); }
+  static Float lessEqual(Float a, Float b) { return _mm_cmple_ps(a, b); }
+  static Float greater(Float a, Float b) { return _mm_cmpgt_ps(a, b); }
+  static Float select(Float mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+  static uint32_t mask(Float m) { return static_cast<uint32_t>(_mm_movemask_ps(m)); }
+
+  static Float loadPairs(const float* p) {
+    Float v = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p)));
+    return _mm_unpacklo_ps(v, v);
+  }
+  static Float setPair(float x, float y) { return _mm_setr_ps(x, y, x, y); }
+
+  static void gatherPairs(const float* p, const uint32_t* index, Float& x, Float& y) {
+    Float lo = _mm_loadh_pi(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p + 2 * size_t{index[0]}))),
+                            reinterpret_cast<const __m64*>(p + 2 * size_t{index[1]}));
+    Float hi = _mm_loadh_pi(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p + 2 * size_t{index[2]}))),
+                            reinterpret_cast<const __m64*>(p + 2 * size_t{index[3]}));
+    x = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+    y = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+  }
+  static Float gatherX(const float* p, const uint32_t* index) {
+    return _mm_setr_ps(p[2 * size_t{index[0]}], p[2 * size_t{index[1]}], p[2 * size_t{index[2]}], p[2 * size_t{index[3]}]);
+  }
+};
+
+#elif defined(PHYSIM_SIMD_WASM)
+
+struct SimdLanes {
+  static constexpr uint32_t WIDTH = 4;
+  static constexpr const char* NAME = "simd128";
+  using Float = v128_t;
+
+  static Float load(const float* p) { return wasm_v128_load(p); }
+  static void store(float* p, Float v) { wasm_v128_store(p, v); }
+  static Float set(float v) { return wasm_f32x4_splat(v); }
+  static Float add(Float a, Float b) { return wasm_f32x4_add(a, b); }
+  static Float sub(Float a, Float b) { return wasm_f32x4_sub(a, b); }
+  static Float mul(Float a, Float b) { return wasm_f32x4_mul(a, b); }
+  static Float div(Float a, Float b) { return wasm_f32x4_div(a, b); }
+  static Float sqrt(Float a) { return wasm_f32x4_sqrt(a); }
+  static Float lessEqual(Float a, Float b) { return wasm_f32x4_le(a, b); }
+  static Float greater(Float a, Float b) { return wasm_f32x4_gt(a, b); }
+  static Float select(Float mask, Float a, Float b) { return wasm_v128_bitselect(a, b, mask); }
+  static uint32_t mask(Float m) { return static_cast<uint32_t>(wasm_i32x4_bitmask(m)); }
+
+  static Float loadPairs(const float* p) {
+    Float v = wasm_v128_load64_zero(p);
+    return wasm_i32x4_shuffle(v, v, 0, 0, 1, 1);
+  }
+  static Float setPair(float x, float y) { return wasm_f32x4_make(x, y, x, y); }
+
+  static void gatherPairs(const float* p, const uint32_t* index, Float& x, Float& y) {
+    x = gatherX(p, index);
+    y = gatherX(p + 1, index);
+  }
+  static Float gatherX(const float* p, const uint32_t* index) {
+    return wasm_f32x4_make(p[2 * size_t{index[0]}], p[2 * size_t{index[1]}], p[2 * size_t{index[2]}], p[2 * size_t{index[3]}]);
+  }
+};
+
+#else
+
+struct SimdLanes {
+  static constexpr uint32_t WIDTH = 1;
+  static constexpr const char* NAME = "scalar";
+  using Float = float;
+
+  static Float load(const float* p) { return *p; }
+  static void store(float* p, Float v) { *p = v; }
+  static Float set(float v) { return v; }
+  static Float add(Float a, Float b) { return a + b; }
+  static Float sub(Float a, Float b) { return a - b; }
+  static Float mul(Float a, Float b) { return a * b; }
+  static Float div(Float a, Float b) { return a / b; }
+  static Float sqrt(Float a) { return std::sqrt(a); }
+  static Float lessEqual(Float a, Float b) { return a <= b ? 1.0f : 0.0f; }
+  static Float greater(Float a, Float b) { return a > b ? 1.0f : 0.0f; }
+  static Float select(Float mask, Float a, Float b) { return mask != 0.0f ? a : b; }
+  static uint32_t mask(Float m) { return m != 0.0f ? 1u : 0u; }
+
+  // A single lane cannot hold an x/y pair; kernels take their scalar path.
+  static Float loadPairs(const float* p) { return *p; }
+  static Float setPair(float x, float y) { (void)y; return x; }
+
+  static void gatherPairs(const float* p, const uint32_t* index, Float& x, Float& y) {
+    x = p[2 * size_t{index[0]}];
+    y = p[2 * size_t{index[0]} + 1];
+  }
+  static Float gatherX(const float* p, const uint32_t* index) { return p[2 * size_t{index[0]}]; }
+};
+
+#endif
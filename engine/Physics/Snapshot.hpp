@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+// Sequential raw copies into a snapshot buffer. A writer without a buffer
+// only counts bytes, so the same save routine first sizes the buffer and
+// then fills it.
+class SnapshotWriter {
+public:
+  explicit SnapshotWriter(uint8_t* data = nullptr) : m_data(data) {}
+
+  template<typename T>
+  void write(const T& value) {
+    writeArray(&value, 1);
+  }
+
+  template<typename T>
+  void writeArray(const T* values, size_t count) {
+    static_assert(std::is_trivially_copyable<T>::value, "snapshots hold raw copies");
+    const size_t bytes = sizeof(T) * count;
+    if (m_data && bytes > 0) {
+      std::memcpy(m_data + m_size, values, bytes);
+    }
+    m_size += bytes;
+  }
+
+  // Accounts for bytes without writing them; only valid while counting.
+  void skip(size_t bytes) { m_size += bytes; }
+  bool counting() const { return m_data == nullptr; }
+  size_t size() const { return m_size; }
+
+private:
+  uint8_t* m_data;
+  size_t m_size = 0;
+};
+
+// Reads back what a SnapshotWriter wrote, in the same order. Reads past the
+// end fail and leave the destination untouched.
+class SnapshotReader {
+public:
+  SnapshotReader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+  template<typename T>
+  bool read(T& value) {
+    return readArray(&value, 1);
+  }
+
+  template<typename T>
+  bool readArray(T* values, size_t count) {
+    static_assert(std::is_trivially_copyable<T>::value, "snapshots hold raw copies");
+    if (count > (m_size - m_offset) / sizeof(T)) {
+      m_failed = true;
+      return false;
+    }
+    const size_t bytes = sizeof(T) * count;
+    if (bytes > 0) {
+      std::memcpy(values, m_data + m_offset, bytes);
+    }
+    m_offset += bytes;
+    return true;
+  }
+
+  // Advances past count values without copying them.
+  template<typename T>
+  bool skipArray(size_t count) {
+    if (count > (m_size - m_offset) / sizeof(T)) {
+      m_failed = true;
+      return false;
+    }
+    const size_t bytes = sizeof(T) * count;
+    m_offset += bytes;
+    return true;
+  }
+
+  bool failed() const { return m_failed; }
+  size_t remaining() const { return m_size - m_offset; }
+
+private:
+  const uint8_t* m_data;
+  size_t m_size;
+  size_t m_offset = 0;
+  bool m_failed = false;
+};
@@ -0,0 +1,349 @@
+#include "SpatialHash.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+SpatialHash::SpatialHash(float cellSize)
+  : m_cellSize(cellSize), m_invCellSize(1.0f / cellSize) {
+  m_cells.resize(1024);
+}
+
+int SpatialHash::toCell(float coordinate) const {
+  float cell = std::floor(coordinate * m_invCellSize);
+  cell = std::max(std::min(cell, static_cast<float>(MAX_CELL_COORD)), -static_cast<float>(MAX_CELL_COORD));
+  return static_cast<int>(cell);
+}
+
+SpatialHash::CellRange SpatialHash::computeRange(const AABB& aabb) const {
+  CellRange range;
+  range.minX = toCell(aabb.min.x);
+  range.minY = toCell(aabb.min.y);
+  range.maxX = toCell(aabb.max.x);
+  range.maxY = toCell(aabb.max.y);
+  return range;
+}
+
+uint32_t SpatialHash::findCell(uint64_t key) const {
+  const size_t mask = m_cells.size() - 1;
+  size_t slot = hashKey(key) & mask;
+
+  while (m_cells[slot].used) {
+    if (m_cells[slot].key == key) {
+      return static_cast<uint32_t>(slot);
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  return INVALID;
+}
+
+uint32_t SpatialHash::findOrInsertCell(uint64_t key) {
+  if ((m_usedCells + 1) * 2 > m_cells.size()) {
+    size_t capacity = m_cells.size();
+    while ((m_liveCells + 1) * 4 > capacity) {
+      capacity *= 2;
+    }
+    rehash(capacity);
+  }
+
+  const size_t mask = m_cells.size() - 1;
+  size_t slot = hashKey(key) & mask;
+
+  while (m_cells[slot].used) {
+    if (m_cells[slot].key == key) {
+      return static_cast<uint32_t>(slot);
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  m_cells[slot].used = true;
+  m_cells[slot].key = key;
+  m_cells[slot].head = INVALID;
+  m_cells[slot].count = 0;
+  m_usedCells++;
+
+  return static_cast<uint32_t>(slot);
+}
+
+// Rebuilds the table without its empty cells. Cells that bodies have left
+// are only dropped here, so the table tracks the occupied region of the
+// world instead of every cell ever touched.
+void SpatialHash::rehash(size_t capacity) {
+  m_rehashScratch.swap(m_cells);
+  m_cells.assign(capacity, Cell());
+  m_usedCells = 0;
+
+  const size_t mask = capacity - 1;
+  for (const Cell& old : m_rehashScratch) {
+    if (!old.used || old.count == 0) continue;
+
+    size_t slot = hashKey(old.key) & mask;
+    while (m_cells[slot].used) {
+      slot = (slot + 1) & mask;
+    }
+
+    m_cells[slot] = old;
+    m_usedCells++;
+
+    for (uint32_t node = old.head; node != INVALID; node = m_nodes[node].next) {
+      m_nodes[node].cell = static_cast<uint32_t>(slot);
+    }
+  }
+}
+
+uint32_t SpatialHash::allocateNode() {
+  if (m_freeNode != INVALID) {
+    uint32_t node = m_freeNode;
+    m_freeNode = m_nodes[node].next;
+    return node;
+  }
+
+  m_nodes.emplace_back();
+  return static_cast<uint32_t>(m_nodes.size() - 1);
+}
+
+void SpatialHash::unlinkProxy(Proxy& proxy) {
+  uint32_t node = proxy.firstNode;
+
+  while (node != INVALID) {
+    Node& entry = m_nodes[node];
+    Cell& cell = m_cells[entry.cell];
+
+    if (entry.prev != INVALID) {
+      m_nodes[entry.prev].next = entry.next;
+    } else {
+      cell.head = entry.next;
+    }
+    if (entry.next != INVALID) {
+      m_nodes[entry.next].prev = entry.prev;
+    }
+    if (--cell.count == 0) {
+      m_liveCells--;
+    }
+
+    uint32_t nextOfBody = entry.nextOfBody;
+    entry.body = INVALID;
+    entry.next = m_freeNode;
+    m_freeNode = node;
+    node = nextOfBody;
+  }
+
+  proxy.firstNode = INVALID;
+  proxy.range = CellRange();
+}
+
+void SpatialHash::ensureProxy(uint32_t body) {
+  if (body >= m_proxies.size()) {
+    m_proxies.resize(static_cast<size_t>(body) + 1);
+  }
+}
+
+void SpatialHash::update(uint32_t body, const AABB& aabb, bool isStatic, const CollisionFilter& filter) {
+  ensureProxy(body);
+
+  CellRange range = computeRange(aabb);
+  if (m_proxies[body].firstNode != INVALID && m_proxies[body].range == range &&
+      m_proxies[body].isStatic == isStatic && m_proxies[body].filter == filter) {
+    return;
+  }
+
+  unlinkProxy(m_proxies[body]);
+  m_proxies[body].range = range;
+  m_proxies[body].isStatic = isStatic;
+  m_proxies[body].filter = filter;
+
+  uint32_t lastNode = INVALID;
+  for (int y = range.minY; y <= range.maxY; ++y) {
+    for (int x = range.minX; x <= range.maxX; ++x) {
+      uint32_t cellIndex = findOrInsertCell(cellKey(x, y));
+      uint32_t node = allocateNode();
+
+      Node& entry = m_nodes[node];
+      Cell& cell = m_cells[cellIndex];
+      entry.body = body;
+      entry.cell = cellIndex;
+      entry.prev = INVALID;
+      entry.next = cell.head;
+      entry.nextOfBody = INVALID;
+      entry.flags = static_cast<uint8_t>((x == range.minX ? FIRST_COLUMN : 0) | (y == range.minY ? FIRST_ROW : 0) |
+                                         (isStatic ? STATIC_BODY : 0));
+      entry.filter = filter;
+
+      if (cell.head != INVALID) {
+        m_nodes[cell.head].prev = node;
+      }
+      cell.head = node;
+      if (cell.count++ == 0) {
+        m_liveCells++;
+      }
+
+      if (lastNode == INVALID) {
+        m_proxies[body].firstNode = node;
+      } else {
+        m_nodes[lastNode].nextOfBody = node;
+      }
+      lastNode = node;
+    }
+  }
+}
+
+void SpatialHash::remove(uint32_t body) {
+  if (body >= m_proxies.size()) return;
+  unlinkProxy(m_proxies[body]);
+}
+
+void SpatialHash::swapBodies(uint32_t a, uint32_t b) {
+  if (a == b) return;
+
+  ensureProxy(std::max(a, b));
+  std::swap(m_proxies[a], m_proxies[b]);
+
+  for (uint32_t node = m_proxies[a].firstNode; node != INVALID; node = m_nodes[node].nextOfBody) {
+    m_nodes[node].body = a;
+  }
+  for (uint32_t node = m_proxies[b].firstNode; node != INVALID; node = m_nodes[node].nextOfBody) {
+    m_nodes[node].body = b;
+  }
+}
+
+void SpatialHash::permuteBodies(uint32_t begin, const std::vector<uint32_t>& order) {
+  const size_t count = order.size();
+  if (count == 0) return;
+
+  ensureProxy(static_cast<uint32_t>(begin + count - 1));
+  m_permutedProxies.resize(count);
+  for (size_t k = 0; k < count; ++k) {
+    m_permutedProxies[k] = m_proxies[begin + order[k]];
+  }
+  std::copy(m_permutedProxies.begin(), m_permutedProxies.end(), m_proxies.begin() + begin);
+
+  for (size_t k = 0; k < count; ++k) {
+    const uint32_t body = static_cast<uint32_t>(begin + k);
+    for (uint32_t node = m_proxies[body].firstNode; node != INVALID; node = m_nodes[node].nextOfBody) {
+      m_nodes[node].body = body;
+    }
+  }
+}
+
+void SpatialHash::clear() {
+  std::fill(m_cells.begin(), m_cells.end(), Cell());
+  m_usedCells = 0;
+  m_liveCells = 0;
+  m_nodes.clear();
+  m_freeNode = INVALID;
+  m_proxies.clear();
+}
+
+void SpatialHash::query(const AABB& aabb, std::vector<uint32_t>& result) {
+  result.clear();
+
+  if (++m_queryStamp == 0) {
+    for (Proxy& proxy : m_proxies) proxy.queryStamp = 0;
+    m_queryStamp = 1;
+  }
+
+  CellRange range = computeRange(aabb);
+  for (int y = range.minY; y <= range.maxY; ++y) {
+    for (int x = range.minX; x <= range.maxX; ++x) {
+      uint32_t cellIndex = findCell(cellKey(x, y));
+      if (cellIndex == INVALID) continue;
+
+      for (uint32_t node = m_cells[cellIndex].head; node != INVALID; node = m_nodes[node].next) {
+        Proxy& proxy = m_proxies[m_nodes[node].body];
+        if (proxy.queryStamp != m_queryStamp) {
+          proxy.queryStamp = m_queryStamp;
+          result.push_back(m_nodes[node].body);
+        }
+      }
+    }
+  }
+}
+
+// Same first-cell rule as pair generation: a body is reported from the
+// first cell of the overlap of its range and the query range, so no query
+// stamps are needed and the query stays read-only.
+void SpatialHash::queryAABB(const AABB& aabb, QueryCallback& callback) const {
+  CellRange range = computeRange(aabb);
+  for (int y = range.minY; y <= range.maxY; ++y) {
+    for (int x = range.minX; x <= range.maxX; ++x) {
+      uint32_t cellIndex = findCell(cellKey(x, y));
+      if (cellIndex == INVALID) continue;
+
+      for (uint32_t node = m_cells[cellIndex].head; node != INVALID; node = m_nodes[node].next) {
+        const CellRange& bodyRange = m_proxies[m_nodes[node].body].range;
+        if (x != std::max(range.minX, bodyRange.minX) || y != std::max(range.minY, bodyRange.minY)) continue;
+        if (!callback.reportBody(m_nodes[node].body)) return;
+      }
+    }
+  }
+}
+
+// Walks the cells along the ray front to back (Amanatides-Woo) and stops
+// once the next cell starts beyond the clipped ray.
+void SpatialHash::rayCast(const glm::vec2& from, const glm::vec2& to, RayCastCallback& callback) const {
+  const glm::vec2 delta = to - from;
+  const float infinity = std::numeric_limits<float>::infinity();
+
+  int x = toCell(from.x);
+  int y = toCell(from.y);
+  const int stepX = delta.x > 0.0f ? 1 : (delta.x < 0.0f ? -1 : 0);
+  const int stepY = delta.y > 0.0f ? 1 : (delta.y < 0.0f ? -1 : 0);
+  int remaining = std::abs(toCell(to.x) - x) + std::abs(toCell(to.y) - y);
+
+  // Fraction of the ray at which it crosses the next cell border per axis.
+  float nextX = stepX == 0 ? infinity : (static_cast<float>(x + (stepX > 0 ? 1 : 0)) * m_cellSize - from.x) / delta.x;
+  float nextY = stepY == 0 ? infinity : (static_cast<float>(y + (stepY > 0 ? 1 : 0)) * m_cellSize - from.y) / delta.y;
+  const float stepFractionX = stepX == 0 ? infinity : m_cellSize / std::abs(delta.x);
+  const float stepFractionY = stepY == 0 ? infinity : m_cellSize / std::abs(delta.y);
+  float maxFraction = 1.0f;
+
+  while (true) {
+    uint32_t cellIndex = findCell(cellKey(x, y));
+    if (cellIndex != INVALID) {
+      for (uint32_t node = m_cells[cellIndex].head; node != INVALID; node = m_nodes[node].next) {
+        maxFraction = callback.reportBody(m_nodes[node].body);
+        if (maxFraction <= 0.0f) return;
+      }
+    }
+
+    if (remaining-- <= 0) return;
+
+    if (nextX < nextY) {
+      if (nextX > maxFraction) return;
+      x += stepX;
+      nextX += stepFractionX;
+    } else {
+      if (nextY > maxFraction) return;
+      y += stepY;
+      nextY += stepFractionY;
+    }
+  }
+}
+
+// Both bodies of a pair are in this cell, so the cell is the first cell of
+// their overlap exactly when one of them starts in this column and one of
+// them starts in this row. Static-static pairs and pairs the filters
+// reject are skipped here rather than in the narrow phase; each node
+// carries a copy of its body's filter so this stays within the cell list.
+void SpatialHash::computePairs(std::vector<BodyPair>& pairs) {
+  pairs.clear();
+
+  for (const Cell& cell : m_cells) {
+    if (!cell.used || cell.count < 2) continue;
+
+    for (uint32_t i = cell.head; i != INVALID; i = m_nodes[i].next) {
+      const Node& nodeA = m_nodes[i];
+
+      for (uint32_t j = nodeA.next; j != INVALID; j = m_nodes[j].next) {
+        const Node& nodeB = m_nodes[j];
+        uint8_t flags = (nodeA.flags | nodeB.flags) & (FIRST_COLUMN | FIRST_ROW);
+
+        if (flags == (FIRST_COLUMN | FIRST_ROW) && !(nodeA.flags & nodeB.flags & STATIC_BODY) &&
+            nodeA.filter.shouldCollide(nodeB.filter)) {
+          pairs.emplace_back(nodeA.body, nodeB.body);
+        }
+      }
+    }
+  }
+}
@@ -1,109 +1,119 @@
 #pragma once
 
-#include "body.hpp"
-#include <unordered_map>
+#include "BroadPhase.hpp"
 #include <vector>
-#include <functional>
+#include <utility>
 
-class SpatialHash {
+// Incremental uniform grid over an open-addressed cell table. Bodies are
+// identified by their dense index and keep their cell entries between steps;
+// update() only re-files a body when its covered cell range changes. All
+// storage is reused, so once the tables have grown to fit the scene a step
+// performs no heap allocations.
+//
+// A pair of bodies sharing several cells is reported only from the first
+// cell of the overlap of their cell ranges, so pair generation needs no
+// de-duplication pass.
+class SpatialHash : public BroadPhase {
 public:
-  SpatialHash(float cellSize = 100.0f) : m_cellSize(cellSize) {}
-  
-  void insert(RigidBody* body) {
-    if (!body) return;
-    
-    auto cells = getCellsForAABB(body->aabb);
-    for (const auto& cell : cells) {
-      m_cells[cell].push_back(body);
-    }
-  }
-  
-  void clear() {
-    m_cells.clear();
-  }
-  
-  std::vector<RigidBody*> queryPotentialCollisions(RigidBody* body) {
-    if (!body) return {};
-    
-    std::vector<RigidBody*> result;
-    std::unordered_map<RigidBody*, bool> visited;
-    
-    auto cells = getCellsForAABB(body->aabb);
-    for (const auto& cell : cells) {
-      auto it = m_cells.find(cell);
-      if (it != m_cells.end()) {
-        for (RigidBody* other : it->second) {
-          if (other != body && !visited[other]) {
-            visited[other] = true;
-            result.push_back(other);
-          }
-        }
-      }
-    }
-    
-    return result;
-  }
-  
-  std::vector<std::pair<RigidBody*, RigidBody*>> queryAllPotentialCollisions() {
-      std::vector<std::pair<RigidBody*, RigidBody*>> result;
-      std::unordered_map<uint64_t, bool> collisionPairs;
-      
-      for (const auto& cellEntry : m_cells) {
-        const auto& bodies = cellEntry.second;
-        
-        for (size_t i = 0; i < bodies.size(); ++i) {
-          for (size_t j = i + 1; j < bodies.size(); ++j) {
-            RigidBody* bodyA = bodies[i];
-            RigidBody* bodyB = bodies[j];
-            
-            uint64_t pairId = getPairId(bodyA, bodyB);
-            
-            if (collisionPairs.find(pairId) != collisionPairs.end()) {
-                continue;
-            }
-            
-            collisionPairs[pairId] = true;
-            result.emplace_back(bodyA, bodyB);
-        }
-      }
-    }
-    
-    return result;
-  }
-    
+  explicit SpatialHash(float cellSize = 100.0f);
+  ~SpatialHash() override = default;
+
+  BroadPhaseType getType() const override { return BroadPhaseType::SPATIAL_HASH; }
+
+  void update(uint32_t body, const AABB& aabb, bool isStatic, const CollisionFilter& filter) override;
+  void remove(uint32_t body) override;
+  void swapBodies(uint32_t a, uint32_t b) override;
+  void permuteBodies(uint32_t begin, const std::vector<uint32_t>& order) override;
+  void clear() override;
+
+  void query(const AABB& aabb, std::vector<uint32_t>& result) override;
+  void computePairs(std::vector<BodyPair>& pairs) override;
+
+  void queryAABB(const AABB& aabb, QueryCallback& callback) const override;
+  void rayCast(const glm::vec2& from, const glm::vec2& to, RayCastCallback& callback) const override;
+
+  float getCellSize() const { return m_cellSize; }
+  // Cells holding at least one body. Emptied cells stay in the table for
+  // reuse until the next rehash and are not counted.
+  size_t getUsedCellCount() const { return m_liveCells; }
+
 private:
-  float m_cellSize;
-  std::unordered_map<uint64_t, std::vector<RigidBody*>> m_cells;
-  
-  uint64_t hashCell(int x, int y) const {
-    return (static_cast<uint64_t>(x) << 32) | static_cast<uint64_t>(y);
-  }
-  
-  std::vector<uint64_t> getCellsForAABB(const AABB& aabb) {
-    std::vector<uint64_t> cells;
-    
-    int minCellX = static_cast<int>(std::floor(aabb.min.x / m_cellSize));
-    int minCellY = static_cast<int>(std::floor(aabb.min.y / m_cellSize));
-    int maxCellX = static_cast<int>(std::floor(aabb.max.x / m_cellSize));
-    int maxCellY = static_cast<int>(std::floor(aabb.max.y / m_cellSize));
-    
-    for (int y = minCellY; y <= maxCellY; ++y) {
-      for (int x = minCellX; x <= maxCellX; ++x) {
-        cells.push_back(hashCell(x, y));
-      }
+  static constexpr uint32_t INVALID = 0xFFFFFFFFu;
+  static constexpr int MAX_CELL_COORD = 1 << 30;
+
+  struct CellRange {
+    int minX = 0;
+    int minY = 0;
+    int maxX = -1;
+    int maxY = -1;
+
+    bool operator==(const CellRange& other) const {
+      return minX == other.minX && minY == other.minY && maxX == other.maxX && maxY == other.maxY;
     }
-    
-    return cells;
+  };
+
+  struct Cell {
+    uint64_t key = 0;
+    uint32_t head = INVALID;
+    uint32_t count = 0;
+    bool used = false;
+  };
+
+  enum NodeFlags : uint8_t {
+    FIRST_COLUMN = 1 << 0,
+    FIRST_ROW = 1 << 1,
+    STATIC_BODY = 1 << 2
+  };
+
+  struct Node {
+    uint32_t body = INVALID;
+    uint32_t cell = INVALID;
+    uint32_t prev = INVALID;
+    uint32_t next = INVALID;
+    uint32_t nextOfBody = INVALID;
+    uint8_t flags = 0;
+    CollisionFilter filter;
+  };
+
+  struct Proxy {
+    CellRange range;
+    uint32_t firstNode = INVALID;
+    uint32_t queryStamp = 0;
+    bool isStatic = false;
+    CollisionFilter filter;
+  };
+
+  float m_cellSize;
+  float m_invCellSize;
+
+  std::vector<Cell> m_cells;
+  std::vector<Cell> m_rehashScratch;
+  size_t m_usedCells = 0;
+  size_t m_liveCells = 0;
+
+  std::vector<Node> m_nodes;
+  uint32_t m_freeNode = INVALID;
+
+  std::vector<Proxy> m_proxies;
+  std::vector<Proxy> m_permutedProxies;
+  uint32_t m_queryStamp = 0;
+
+  CellRange computeRange(const AABB& aabb) const;
+  int toCell(float coordinate) const;
+
+  static uint64_t cellKey(int x, int y) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint64_t>(static_cast<uint32_t>(y));
   }
-    
-  uint64_t getPairId(RigidBody* a, RigidBody* b) const {
-    uintptr_t addrA = reinterpret_cast<uintptr_t>(a);
-    uintptr_t addrB = reinterpret_cast<uintptr_t>(b);
-    
-    if (addrA > addrB) {
-      std::swap(addrA, addrB);
-    }
-    
-    return (static_cast<uint64_t>(addrA) << 32) | static_cast<uint64_t>(addrB);
+
+  static size_t hashKey(uint64_t key) {
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 17);
   }
+
+  uint32_t findCell(uint64_t key) const;
+  uint32_t findOrInsertCell(uint64_t key);
+  void rehash(size_t capacity);
+
+  uint32_t allocateNode();
+  void unlinkProxy(Proxy& proxy);
+  void ensureProxy(uint32_t body);
 };
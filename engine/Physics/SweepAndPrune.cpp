@@ -0,0 +1,340 @@
+#include "SweepAndPrune.hpp"
+#include <algorithm>
+
+void SweepAndPrune::update(uint32_t body, const AABB& aabb, bool isStatic, const CollisionFilter& filter) {
+  if (body >= m_bodyToProxy.size()) {
+    m_bodyToProxy.resize(static_cast<size_t>(body) + 1, INVALID);
+  }
+
+  uint32_t proxy = m_bodyToProxy[body];
+  if (proxy == INVALID) {
+    m_bodyToProxy[body] = createProxy(body, aabb, isStatic, filter);
+    return;
+  }
+
+  if (m_proxies[proxy].isStatic != isStatic || m_proxies[proxy].filter != filter) {
+    remove(body);
+    m_bodyToProxy[body] = createProxy(body, aabb, isStatic, filter);
+    return;
+  }
+
+  Proxy& entry = m_proxies[proxy];
+  if (entry.aabb.min == aabb.min && entry.aabb.max == aabb.max) {
+    return;
+  }
+
+  entry.aabb = aabb;
+  if (!entry.inserted()) return;
+
+  for (int axis = 0; axis < 2; ++axis) {
+    m_endpoints[axis][entry.minIndex[axis]].value = aabb.min[axis];
+    m_endpoints[axis][entry.maxIndex[axis]].value = aabb.max[axis];
+  }
+  m_moved = true;
+}
+
+uint32_t SweepAndPrune::createProxy(uint32_t body, const AABB& aabb, bool isStatic, const CollisionFilter& filter) {
+  uint32_t proxy;
+  if (!m_freeProxies.empty()) {
+    proxy = m_freeProxies.back();
+    m_freeProxies.pop_back();
+  } else {
+    proxy = static_cast<uint32_t>(m_proxies.size());
+    m_proxies.emplace_back();
+  }
+
+  Proxy& entry = m_proxies[proxy];
+  entry.aabb = aabb;
+  entry.body = body;
+  entry.isStatic = isStatic;
+  entry.filter = filter;
+  m_pendingProxies.push_back(proxy);
+
+  return proxy;
+}
+
+// Insertion sort that moves each endpoint down to its place. A min moving
+// below a max starts an overlap on this axis and a max moving below a min
+// ends one; all boxes already hold their new values, so the pair test sees
+// where they end up.
+void SweepAndPrune::sortEndpoints(int axis) {
+  std::vector<Endpoint>& endpoints = m_endpoints[axis];
+  const uint32_t count = static_cast<uint32_t>(endpoints.size());
+
+  for (uint32_t i = 1; i < count; ++i) {
+    if (!precedes(endpoints[i], endpoints[i - 1])) continue;
+
+    const Endpoint endpoint = endpoints[i];
+    const uint32_t proxy = endpoint.proxy();
+    uint32_t index = i;
+    do {
+      const Endpoint& previous = endpoints[index - 1];
+      if (endpoint.isMax() != previous.isMax()) {
+        if (!endpoint.isMax() && canPair(proxy, previous.proxy())) {
+          m_pairs.addPair(proxy, previous.proxy());
+        } else if (endpoint.isMax()) {
+          m_pairs.removePair(proxy, previous.proxy());
+        }
+      }
+
+      endpoints[index] = previous;
+      setEndpointIndex(axis, index);
+      index--;
+    } while (index > 0 && precedes(endpoint, endpoints[index - 1]));
+
+    endpoints[index] = endpoint;
+    setEndpointIndex(axis, index);
+  }
+}
+
+void SweepAndPrune::remove(uint32_t body) {
+  if (body >= m_bodyToProxy.size() || m_bodyToProxy[body] == INVALID) return;
+
+  uint32_t proxy = m_bodyToProxy[body];
+  m_proxies[proxy].body = INVALID;
+  if (m_proxies[proxy].inserted()) {
+    m_deadProxies.push_back(proxy);
+  }
+  m_bodyToProxy[body] = INVALID;
+}
+
+// Dead endpoints go first so the sort does not move them, and the sort
+// comes before the merge, which needs both sides in order.
+void SweepAndPrune::flush() {
+  if (m_resetDeltas) {
+    m_pairs.resetDeltas();
+    m_resetDeltas = false;
+  }
+
+  if (!m_deadProxies.empty()) removeDeadProxies();
+  if (m_moved) {
+    sortEndpoints(0);
+    sortEndpoints(1);
+    m_moved = false;
+  }
+  if (!m_pendingProxies.empty()) insertPendingProxies();
+
+  m_pairs.finalize([this](uint32_t proxy) { return m_proxies[proxy].body; });
+}
+
+void SweepAndPrune::removeDeadProxies() {
+  m_deadPairs.clear();
+  m_pairs.forEachPair([this](uint32_t proxyA, uint32_t proxyB) {
+    if (m_proxies[proxyA].body == INVALID || m_proxies[proxyB].body == INVALID) {
+      m_deadPairs.emplace_back(proxyA, proxyB);
+    }
+  });
+  for (const BodyPair& pair : m_deadPairs) {
+    m_pairs.removePair(pair.a, pair.b);
+  }
+
+  for (int axis = 0; axis < 2; ++axis) {
+    std::vector<Endpoint>& endpoints = m_endpoints[axis];
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < endpoints.size(); ++i) {
+      if (m_proxies[endpoints[i].proxy()].body == INVALID) continue;
+      endpoints[kept] = endpoints[i];
+      setEndpointIndex(axis, kept);
+      kept++;
+    }
+    endpoints.resize(kept);
+  }
+
+  for (uint32_t proxy : m_deadProxies) {
+    m_proxies[proxy] = Proxy();
+    m_freeProxies.push_back(proxy);
+  }
+  m_deadProxies.clear();
+}
+
+// Each axis gets the batch sorted on its own and merged in from the back,
+// so old endpoints only move once. A single sweep over x then finds every
+// pair with a new proxy: new ones are tested against all open proxies, old
+// ones only against open new ones.
+void SweepAndPrune::insertPendingProxies() {
+  uint32_t pending = 0;
+  for (uint32_t proxy : m_pendingProxies) {
+    if (m_proxies[proxy].body == INVALID) {
+      m_proxies[proxy] = Proxy();
+      m_freeProxies.push_back(proxy);
+    } else {
+      m_pendingProxies[pending++] = proxy;
+    }
+  }
+  m_pendingProxies.resize(pending);
+  if (m_pendingProxies.empty()) return;
+
+  for (int axis = 0; axis < 2; ++axis) {
+    m_batch.clear();
+    for (uint32_t proxy : m_pendingProxies) {
+      m_batch.push_back({m_proxies[proxy].aabb.min[axis], proxy << 1});
+      m_batch.push_back({m_proxies[proxy].aabb.max[axis], (proxy << 1) | 1u});
+    }
+    std::sort(m_batch.begin(), m_batch.end(), batchPrecedes);
+
+    std::vector<Endpoint>& endpoints = m_endpoints[axis];
+    uint32_t old = static_cast<uint32_t>(endpoints.size());
+    uint32_t added = static_cast<uint32_t>(m_batch.size());
+    uint32_t out = old + added;
+    endpoints.resize(out);
+    while (added > 0) {
+      if (old > 0 && precedes(m_batch[added - 1], endpoints[old - 1])) {
+        endpoints[--out] = endpoints[--old];
+      } else {
+        endpoints[--out] = m_batch[--added];
+      }
+      setEndpointIndex(axis, out);
+    }
+  }
+
+  for (uint32_t proxy : m_pendingProxies) {
+    m_proxies[proxy].isNew = true;
+  }
+  m_openSlot.assign(m_proxies.size(), INVALID);
+  for (const Endpoint& endpoint : m_endpoints[0]) {
+    const uint32_t proxy = endpoint.proxy();
+    if (endpoint.isMax()) {
+      closeProxy(proxy);
+      continue;
+    }
+
+    for (uint32_t other : m_open[1]) {
+      if (canPair(proxy, other)) m_pairs.addPair(proxy, other);
+    }
+    if (m_proxies[proxy].isNew) {
+      for (uint32_t other : m_open[0]) {
+        if (canPair(proxy, other)) m_pairs.addPair(proxy, other);
+      }
+    }
+    openProxy(proxy);
+  }
+
+  for (uint32_t proxy : m_pendingProxies) {
+    m_proxies[proxy].isNew = false;
+  }
+  m_pendingProxies.clear();
+  m_open[0].clear();
+  m_open[1].clear();
+}
+
+void SweepAndPrune::openProxy(uint32_t proxy) {
+  std::vector<uint32_t>& open = m_open[m_proxies[proxy].isNew ? 1 : 0];
+  m_openSlot[proxy] = static_cast<uint32_t>(open.size());
+  open.push_back(proxy);
+}
+
+void SweepAndPrune::closeProxy(uint32_t proxy) {
+  std::vector<uint32_t>& open = m_open[m_proxies[proxy].isNew ? 1 : 0];
+  const uint32_t slot = m_openSlot[proxy];
+  if (slot == INVALID) return;
+
+  m_openSlot[proxy] = INVALID;
+  open[slot] = open.back();
+  m_openSlot[open[slot]] = slot;
+  open.pop_back();
+}
+
+void SweepAndPrune::swapBodies(uint32_t a, uint32_t b) {
+  if (a == b) return;
+
+  size_t required = static_cast<size_t>(std::max(a, b)) + 1;
+  if (m_bodyToProxy.size() < required) {
+    m_bodyToProxy.resize(required, INVALID);
+  }
+
+  std::swap(m_bodyToProxy[a], m_bodyToProxy[b]);
+  if (m_bodyToProxy[a] != INVALID) m_proxies[m_bodyToProxy[a]].body = a;
+  if (m_bodyToProxy[b] != INVALID) m_proxies[m_bodyToProxy[b]].body = b;
+}
+
+void SweepAndPrune::permuteBodies(uint32_t begin, const std::vector<uint32_t>& order) {
+  const size_t count = order.size();
+  if (m_bodyToProxy.size() < begin + count) {
+    m_bodyToProxy.resize(begin + count, INVALID);
+  }
+
+  m_permutedProxies.resize(count);
+  for (size_t k = 0; k < count; ++k) {
+    m_permutedProxies[k] = m_bodyToProxy[begin + order[k]];
+  }
+  for (size_t k = 0; k < count; ++k) {
+    const uint32_t proxy = m_permutedProxies[k];
+    m_bodyToProxy[begin + k] = proxy;
+    if (proxy != INVALID) m_proxies[proxy].body = static_cast<uint32_t>(begin + k);
+  }
+}
+
+void SweepAndPrune::clear() {
+  m_endpoints[0].clear();
+  m_endpoints[1].clear();
+  m_proxies.clear();
+  m_freeProxies.clear();
+  m_bodyToProxy.clear();
+  m_pendingProxies.clear();
+  m_deadProxies.clear();
+  m_moved = false;
+  m_resetDeltas = false;
+  m_pairs.clear();
+}
+
+void SweepAndPrune::query(const AABB& aabb, std::vector<uint32_t>& result) {
+  flush();
+  result.clear();
+
+  for (const Endpoint& endpoint : m_endpoints[0]) {
+    if (endpoint.value > aabb.max.x) break;
+    if (endpoint.isMax()) continue;
+
+    const Proxy& proxy = m_proxies[endpoint.proxy()];
+    if (proxy.aabb.overlaps(aabb)) {
+      result.push_back(proxy.body);
+    }
+  }
+}
+
+void SweepAndPrune::queryAABB(const AABB& aabb, QueryCallback& callback) const {
+  for (const Endpoint& endpoint : m_endpoints[0]) {
+    if (endpoint.value > aabb.max.x) break;
+    if (endpoint.isMax()) continue;
+
+    const Proxy& proxy = m_proxies[endpoint.proxy()];
+    if (proxy.aabb.overlaps(aabb) && !callback.reportBody(proxy.body)) return;
+  }
+}
+
+// Walks the x endpoints up to the right end of the ray, which moves left
+// as hits clip it. Without a hierarchy every proxy starting left of the
+// ray is still visited, so ray-heavy scenes are better served by the tree
+// or the hash.
+void SweepAndPrune::rayCast(const glm::vec2& from, const glm::vec2& to, RayCastCallback& callback) const {
+  const glm::vec2 delta = to - from;
+  float maxFraction = 1.0f;
+
+  for (const Endpoint& endpoint : m_endpoints[0]) {
+    if (endpoint.value > std::max(from.x, from.x + delta.x * maxFraction)) break;
+    if (endpoint.isMax()) continue;
+
+    const Proxy& proxy = m_proxies[endpoint.proxy()];
+    float enter;
+    if (!proxy.aabb.intersectsSegment(from, delta, maxFraction, enter)) continue;
+
+    maxFraction = callback.reportBody(proxy.body);
+    if (maxFraction <= 0.0f) return;
+  }
+}
+
+void SweepAndPrune::computePairs(std::vector<BodyPair>& pairs) {
+  flush();
+
+  pairs.clear();
+  m_pairs.forEachPair([this, &pairs](uint32_t proxyA, uint32_t proxyB) {
+    pairs.emplace_back(m_proxies[proxyA].body, m_proxies[proxyB].body);
+  });
+  m_resetDeltas = true;
+}
+
+bool SweepAndPrune::getPairDeltas(std::vector<BodyPair>& begun, std::vector<BodyPair>& ended) const {
+  begun = m_pairs.getBegunPairs();
+  ended = m_pairs.getEndedPairs();
+  return true;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "BroadPhase.hpp"
+#include "PairManager.hpp"
+#include <vector>
+
+// Incremental sort-and-prune over both axes. update() only writes the new
+// endpoint values; flush() then repairs each axis with one insertion sort
+// pass, which is close to linear when bodies move a little per step, and
+// bodies moving together do not cross each other on the way. Overlapping
+// pairs are kept in a persistent table and changed only when endpoints
+// cross. Added and removed bodies are batched as well: new endpoints are
+// sorted and merged in once, and removed ones are compacted out in one
+// pass. Each flush() stages its pair changes and reports the net begin/end
+// deltas through getPairDeltas().
+class SweepAndPrune : public BroadPhase {
+public:
+  SweepAndPrune() = default;
+  ~SweepAndPrune() override = default;
+
+  BroadPhaseType getType() const override { return BroadPhaseType::SWEEP_AND_PRUNE; }
+
+  void update(uint32_t body, const AABB& aabb, bool isStatic, const CollisionFilter& filter) override;
+  void remove(uint32_t body) override;
+  void swapBodies(uint32_t a, uint32_t b) override;
+  void permuteBodies(uint32_t begin, const std::vector<uint32_t>& order) override;
+  void clear() override;
+  void flush() override;
+
+  void query(const AABB& aabb, std::vector<uint32_t>& result) override;
+  void computePairs(std::vector<BodyPair>& pairs) override;
+
+  void queryAABB(const AABB& aabb, QueryCallback& callback) const override;
+  void rayCast(const glm::vec2& from, const glm::vec2& to, RayCastCallback& callback) const override;
+
+  bool getPairDeltas(std::vector<BodyPair>& begun, std::vector<BodyPair>& ended) const override;
+
+private:
+  static constexpr uint32_t INVALID = 0xFFFFFFFFu;
+
+  struct Endpoint {
+    float value;
+    uint32_t data;
+
+    uint32_t proxy() const { return data >> 1; }
+    bool isMax() const { return (data & 1u) != 0; }
+  };
+
+  // Sort order of the endpoint arrays. Equal values put min endpoints
+  // before max endpoints of other proxies, so touching boxes always pair,
+  // like AABB::overlaps(), instead of depending on which side they came
+  // from.
+  static bool precedes(const Endpoint& a, const Endpoint& b) {
+    if (a.value != b.value) return a.value < b.value;
+    return !a.isMax() && b.isMax() && a.proxy() != b.proxy();
+  }
+
+  // Order of a batch of new endpoints. Unlike precedes() it is a strict
+  // weak ordering, and a batch sorted by it has no neighbours precedes()
+  // would swap.
+  static bool batchPrecedes(const Endpoint& a, const Endpoint& b) {
+    if (a.value != b.value) return a.value < b.value;
+    if (a.isMax() != b.isMax()) return b.isMax();
+    return a.data < b.data;
+  }
+
+  // A proxy without endpoints is waiting in m_pendingProxies. Removed
+  // proxies have no body; their endpoints stay until the next flush().
+  struct Proxy {
+    AABB aabb;
+    uint32_t body = INVALID;
+    bool isStatic = false;
+    bool isNew = false;
+    CollisionFilter filter;
+    uint32_t minIndex[2] = {INVALID, INVALID};
+    uint32_t maxIndex[2] = {INVALID, INVALID};
+
+    bool inserted() const { return minIndex[0] != INVALID; }
+  };
+
+  std::vector<Endpoint> m_endpoints[2];
+  std::vector<Proxy> m_proxies;
+  std::vector<uint32_t> m_freeProxies;
+  std::vector<uint32_t> m_bodyToProxy;
+  std::vector<uint32_t> m_permutedProxies;
+  std::vector<uint32_t> m_pendingProxies;
+  std::vector<uint32_t> m_deadProxies;
+  bool m_moved = false;
+  // Set by computePairs(); the next flush() starts new delta lists.
+  bool m_resetDeltas = false;
+
+  // Scratch for flush().
+  std::vector<Endpoint> m_batch;
+  std::vector<BodyPair> m_deadPairs;
+  std::vector<uint32_t> m_open[2];
+  std::vector<uint32_t> m_openSlot;
+
+  PairManager m_pairs;
+
+  uint32_t createProxy(uint32_t body, const AABB& aabb, bool isStatic, const CollisionFilter& filter);
+  bool canPair(uint32_t proxyA, uint32_t proxyB) const {
+    const Proxy& a = m_proxies[proxyA];
+    const Proxy& b = m_proxies[proxyB];
+    return !(a.isStatic && b.isStatic) && a.aabb.overlaps(b.aabb) && a.filter.shouldCollide(b.filter);
+  }
+  void setEndpointIndex(int axis, uint32_t index) {
+    const Endpoint& endpoint = m_endpoints[axis][index];
+    Proxy& proxy = m_proxies[endpoint.proxy()];
+    (endpoint.isMax() ? proxy.maxIndex : proxy.minIndex)[axis] = index;
+  }
+
+  void removeDeadProxies();
+  void sortEndpoints(int axis);
+  void insertPendingProxies();
+  void openProxy(uint32_t proxy);
+  void closeProxy(uint32_t proxy);
+};
@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <algorithm>
 
 enum class BodyType {
   STATIC,
@@ -16,6 +17,23 @@ enum class ShapeType {
   RECTANGLE
 };
 
+struct BodyHandle {
+  static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFFu;
+
+  uint32_t index = INVALID_INDEX;
+  uint32_t generation = 0;
+
+  bool isValid() const { return index != INVALID_INDEX; }
+
+  bool operator==(const BodyHandle& other) const {
+    return index == other.index && generation == other.generation;
+  }
+
+  bool operator!=(const BodyHandle& other) const {
+    return !(*this == other);
+  }
+};
+
 struct Shape {
   virtual ~Shape() = default;
   virtual ShapeType getType() const = 0;
@@ -53,6 +71,30 @@ struct AABB {
             min.y <= other.max.y && max.y >= other.min.y);
   }
   
+  // Fraction of from -> from + delta at which the segment enters the box,
+  // if it does before maxFraction. A segment starting inside enters at 0.
+  bool intersectsSegment(const glm::vec2& from, const glm::vec2& delta, float maxFraction, float& fraction) const {
+    float enter = 0.0f;
+    float exit = maxFraction;
+    for (int i = 0; i < 2; ++i) {
+      if (delta[i] == 0.0f) {
+        if (from[i] < min[i] || from[i] > max[i]) return false;
+        continue;
+      }
+
+      float inverse = 1.0f / delta[i];
+      float t0 = (min[i] - from[i]) * inverse;
+      float t1 = (max[i] - from[i]) * inverse;
+      if (t0 > t1) std::swap(t0, t1);
+      enter = std::max(enter, t0);
+      exit = std::min(exit, t1);
+      if (enter > exit) return false;
+    }
+
+    fraction = enter;
+    return true;
+  }
+
   glm::vec2 getCenter() const {
     return (min + max) * 0.5f;
   }
@@ -62,10 +104,72 @@ struct AABB {
   }
 };
 
+inline AABB computeAABB(ShapeType shapeType, const glm::vec2& extent, const glm::vec2& position, float rotation) {
+  AABB aabb;
+
+  switch (shapeType) {
+    case ShapeType::CIRCLE: {
+      float r = extent.x;
+      aabb.min = position - glm::vec2(r, r);
+      aabb.max = position + glm::vec2(r, r);
+      break;
+    }
+    case ShapeType::RECTANGLE: {
+      const glm::vec2& halfSize = extent;
+
+      if (rotation == 0.0f) {
+        aabb.min = position - halfSize;
+        aabb.max = position + halfSize;
+      } else {
+        float cosAngle = std::abs(std::cos(rotation));
+        float sinAngle = std::abs(std::sin(rotation));
+
+        glm::vec2 rotatedHalf = glm::vec2(
+          halfSize.x * cosAngle + halfSize.y * sinAngle,
+          halfSize.x * sinAngle + halfSize.y * cosAngle
+        );
+
+        aabb.min = position - rotatedHalf;
+        aabb.max = position + rotatedHalf;
+      }
+      break;
+    }
+  }
+
+  return aabb;
+}
+
+// Two bodies collide when each one's category is in the other's mask. A
+// shared non-zero group overrides the bits: bodies in the same positive
+// group always collide, bodies in the same negative group never do.
+struct CollisionFilter {
+  uint16_t categoryBits = 0x0001;
+  uint16_t maskBits = 0xFFFF;
+  int16_t groupIndex = 0;
+
+  bool shouldCollide(const CollisionFilter& other) const {
+    if (groupIndex != 0 && groupIndex == other.groupIndex) {
+      return groupIndex > 0;
+    }
+    return (categoryBits & other.maskBits) != 0 && (other.categoryBits & maskBits) != 0;
+  }
+
+  bool operator==(const CollisionFilter& other) const {
+    return categoryBits == other.categoryBits && maskBits == other.maskBits && groupIndex == other.groupIndex;
+  }
+
+  bool operator!=(const CollisionFilter& other) const {
+    return !(*this == other);
+  }
+};
+
 struct RigidBody {
   BodyType type = BodyType::DYNAMIC;
   std::string id;
   bool active = true;
+  // Fast circle that gets swept against other bodies so it cannot tunnel.
+  bool bullet = false;
+  CollisionFilter filter;
   
   glm::vec2 position = {0.0f, 0.0f};
   glm::vec2 prevPosition = {0.0f, 0.0f}; 
@@ -89,6 +193,8 @@ struct RigidBody {
   std::unique_ptr<Shape> shape;
   
   AABB aabb;
+
+  void* userData = nullptr;
   
   static RigidBody createCircle(BodyType type, const glm::vec2& pos, float radius, float m = 1.0f) {
     RigidBody body;
@@ -138,50 +244,23 @@ struct RigidBody {
     return body;
   }
   
-  void updateAABB() {
-    if (!shape) return;
-    
+  glm::vec2 getShapeExtent() const {
+    if (!shape) return glm::vec2(0.0f);
+
     switch (shape->getType()) {
-      case ShapeType::CIRCLE: {
-        CircleShape* circle = static_cast<CircleShape*>(shape.get());
-        float r = circle->radius;
-        aabb.min = position - glm::vec2(r, r);
-        aabb.max = position + glm::vec2(r, r);
-        break;
-      }
-      case ShapeType::RECTANGLE: {
-        RectangleShape* rect = static_cast<RectangleShape*>(shape.get());
-        glm::vec2 halfSize = rect->size * 0.5f;
-        
-        if (rotation == 0.0f) {
-          aabb.min = position - halfSize;
-          aabb.max = position + halfSize;
-        } else {
-          float cosAngle = std::cos(rotation);
-          float sinAngle = std::sin(rotation);
-          
-          glm::vec2 corners[4] = {
-            glm::vec2(halfSize.x * cosAngle - halfSize.y * sinAngle, 
-                      halfSize.x * sinAngle + halfSize.y * cosAngle),
-            glm::vec2(halfSize.x * cosAngle + halfSize.y * sinAngle, 
-                      halfSize.x * sinAngle - halfSize.y * cosAngle),
-            glm::vec2(-halfSize.x * cosAngle + halfSize.y * sinAngle, 
-                      -halfSize.x * sinAngle - halfSize.y * cosAngle),
-            glm::vec2(-halfSize.x * cosAngle - halfSize.y * sinAngle, 
-                      -halfSize.x * sinAngle + halfSize.y * cosAngle)
-          };
-          
-          aabb.min = aabb.max = position + corners[0];
-          
-          for (int i = 1; i < 4; ++i) {
-            glm::vec2 corner = position + corners[i];
-            aabb.min = glm::min(aabb.min, corner);
-            aabb.max = glm::max(aabb.max, corner);
-          }
-        }
-        break;
-      }
+      case ShapeType::CIRCLE:
+        return glm::vec2(static_cast<const CircleShape*>(shape.get())->radius);
+      case ShapeType::RECTANGLE:
+        return static_cast<const RectangleShape*>(shape.get())->size * 0.5f;
     }
+
+    return glm::vec2(0.0f);
+  }
+
+  void updateAABB() {
+    if (!shape) return;
+
+    aabb = computeAABB(shape->getType(), getShapeExtent(), position, rotation);
   }
   
   void applyForce(const glm::vec2& force) {
@@ -211,14 +290,69 @@ struct RigidBody {
   }
 };
 
+struct BodyPair {
+  uint32_t a;
+  uint32_t b;
+
+  BodyPair() : a(0), b(0) {}
+  BodyPair(uint32_t first, uint32_t second)
+    : a(first < second ? first : second), b(first < second ? second : first) {}
+
+  uint64_t key() const {
+    return (static_cast<uint64_t>(a) << 32) | static_cast<uint64_t>(b);
+  }
+
+  bool operator<(const BodyPair& other) const { return key() < other.key(); }
+  bool operator==(const BodyPair& other) const { return a == other.a && b == other.b; }
+};
+
 struct Collision {
-  RigidBody* bodyA;
-  RigidBody* bodyB;
-  glm::vec2 normal;        
+  uint32_t bodyA;
+  uint32_t bodyB;
+  BodyHandle handleA;
+  BodyHandle handleB;
+  glm::vec2 normal;        // from bodyA towards bodyB
   glm::vec2 contactPoint;  
   float penetration;       
+  // Which part of the shapes touches (rectangle axis, rectangle region or
+  // boundary plane index); stays the same while the contact persists.
+  uint32_t feature;
   bool hasCollision;
   
-  Collision() : bodyA(nullptr), bodyB(nullptr), normal(0.0f), contactPoint(0.0f), 
-                penetration(0.0f), hasCollision(false) {}
+  Collision() : bodyA(0), bodyB(0), normal(0.0f), contactPoint(0.0f), 
+                penetration(0.0f), feature(0), hasCollision(false) {}
+};
+
+enum class ContactEventType {
+  BEGIN,
+  PERSIST,
+  END
+};
+
+// One touching pair in a step. END events carry the pair's last contact;
+// bodyB is invalid for boundary planes, where feature is the plane index.
+struct ContactEvent {
+  ContactEventType type = ContactEventType::BEGIN;
+  BodyHandle bodyA;
+  BodyHandle bodyB;
+  glm::vec2 normal = glm::vec2(0.0f);        // from bodyA towards bodyB
+  glm::vec2 contactPoint = glm::vec2(0.0f);
+  float penetration = 0.0f;
+  uint32_t feature = 0;
+};
+
+// Segment from -> to. Shapes the ray starts inside of are not reported.
+struct Ray {
+  glm::vec2 from;
+  glm::vec2 to;
+};
+
+struct RaycastHit {
+  BodyHandle body;         // invalid for boundary planes
+  glm::vec2 point;
+  glm::vec2 normal;        // surface normal, facing the ray
+  float fraction;          // of from -> to
+  bool hit;
+
+  RaycastHit() : point(0.0f), normal(0.0f), fraction(1.0f), hit(false) {}
 };
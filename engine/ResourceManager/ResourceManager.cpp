@@ -1,7 +1,8 @@
 #include "ResourceManager.hpp"
 #include "Engine.hpp"
+#include "Core/JobSystem.hpp"
 
-ResourceManager::ResourceManager() {
+ResourceManager::ResourceManager(JobSystem* jobSystem) : m_jobSystem(jobSystem) {
   LOG("ResourceManager initialized");
 }
 
@@ -26,6 +27,49 @@ bool ResourceManager::loadTexture(const std::string& name, const std::string& fi
   return false;
 }
 
+bool ResourceManager::loadTextures(const std::vector<TextureRequest>& requests) {
+  std::vector<const TextureRequest*> pending;
+  pending.reserve(requests.size());
+  for(const auto& request : requests) {
+    if(m_textures.find(request.name) != m_textures.end()) {
+      WARLOG("Texture '", request.name, "' already exists");
+      continue;
+    }
+    pending.push_back(&request);
+  }
+
+  const uint32_t count = static_cast<uint32_t>(pending.size());
+  std::vector<Texture::ImageData> images(count);
+
+  auto decode = [&pending, &images](uint32_t begin, uint32_t end, uint32_t) {
+    for(uint32_t i = begin; i < end; ++i) {
+      Texture::decodeFile(pending[i]->filepath, images[i]);
+    }
+  };
+
+  if(m_jobSystem) {
+    m_jobSystem->parallelFor(count, 1, decode);
+  } else {
+    decode(0, count, 0);
+  }
+
+  bool allLoaded = true;
+  for(uint32_t i = 0; i < count; ++i) {
+    const TextureRequest& request = *pending[i];
+
+    auto texture = std::make_unique<Texture>();
+    if(texture->upload(images[i])) {
+      m_textures[request.name] = std::move(texture);
+      LOG("Loaded texture: ", request.name, " from ", request.filepath);
+    } else {
+      ERRLOG("Failed to load texture: ", request.name, " from ", request.filepath);
+      allLoaded = false;
+    }
+  }
+
+  return allLoaded;
+}
+
 Texture* ResourceManager::getTexture(const std::string& name) {
   auto it = m_textures.find(name);
   if(it != m_textures.end()) {
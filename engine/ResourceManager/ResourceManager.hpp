@@ -5,12 +5,22 @@
 #include "Core/common.hpp"
 #include "Renderer/Sprite.hpp"
 
+class JobSystem;
+
 class ResourceManager {
 public:
-  ResourceManager();
+  struct TextureRequest {
+    std::string name;
+    std::string filepath;
+  };
+
+  explicit ResourceManager(JobSystem* jobSystem = nullptr);
   ~ResourceManager();
 
   bool loadTexture(const std::string& name, const std::string& filepath);
+  // Decodes all files on the job system, then uploads them on the calling
+  // thread. Returns false if any texture failed to load.
+  bool loadTextures(const std::vector<TextureRequest>& requests);
   Texture* getTexture(const std::string& name);
   void unloadTexture(const std::string& name);
 
@@ -30,6 +40,7 @@ public:
   MemoryStats getMemoryStats() const;
 
 private:
+  JobSystem* m_jobSystem = nullptr;
   std::unordered_map<std::string, std::unique_ptr<Texture>> m_textures;
   std::unordered_map<std::string, std::unique_ptr<Sprite>> m_sprites;
 };
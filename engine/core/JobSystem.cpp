@@ -0,0 +1,273 @@
+#include "JobSystem.hpp"
+#include "Logger/Logger.hpp"
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__) && !defined(__EMSCRIPTEN__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+  // Workers are 1..n. Any other thread submits and waits as thread 0.
+  thread_local uint32_t t_threadIndex = 0;
+  thread_local const JobSystem* t_owner = nullptr;
+
+  void pinCurrentThread(uint32_t cpu) {
+#if defined(_WIN32)
+    if (cpu < sizeof(DWORD_PTR) * 8) {
+      SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu);
+    }
+#elif defined(__linux__) && !defined(__EMSCRIPTEN__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+  }
+}
+
+JobSystem::JobSystem() {
+  start(Config());
+}
+
+JobSystem::JobSystem(const Config& config) {
+  start(config);
+}
+
+JobSystem::JobSystem(uint32_t workerCount) {
+  Config config;
+  config.workerCount = workerCount;
+  start(config);
+}
+
+void JobSystem::start(const Config& config) {
+  uint32_t workerCount = config.workerCount;
+#ifdef __EMSCRIPTEN__
+  workerCount = 0;
+#endif
+
+  m_queues.reserve(workerCount + 1);
+  for (uint32_t i = 0; i <= workerCount; ++i) {
+    m_queues.push_back(std::make_unique<WorkQueue>());
+  }
+
+  m_workers.reserve(workerCount);
+  for (uint32_t i = 0; i < workerCount; ++i) {
+    m_workers.emplace_back(&JobSystem::workerLoop, this, i + 1, config.pinThreads);
+  }
+
+  LOG("Job system started with ", getThreadCount(), " threads");
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_quit = true;
+  }
+  m_wake.notify_all();
+
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+}
+
+uint32_t JobSystem::defaultWorkerCount() {
+  unsigned int hardwareThreads = std::thread::hardware_concurrency();
+  return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+uint32_t JobSystem::getThreadIndex() const {
+  return t_owner == this ? t_threadIndex : 0;
+}
+
+void JobSystem::run(Task task, JobCounter* counter) {
+  if (counter) {
+    counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  Job job{std::move(task), counter};
+  if (m_workers.empty()) {
+    execute(job, 0);
+    return;
+  }
+
+  push(getThreadIndex(), std::move(job));
+}
+
+void JobSystem::runAfter(JobCounter& dependency, Task task, JobCounter* counter) {
+  if (counter) {
+    counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(dependency.m_mutex);
+    if (!dependency.isDone()) {
+      dependency.m_continuations.push_back({std::move(task), counter});
+      return;
+    }
+  }
+
+  Job job{std::move(task), counter};
+  if (m_workers.empty()) {
+    execute(job, 0);
+  } else {
+    push(getThreadIndex(), std::move(job));
+  }
+}
+
+void JobSystem::wait(const JobCounter& counter) {
+  uint32_t threadIndex = getThreadIndex();
+
+  while (!counter.isDone()) {
+    Job job;
+    if (pop(threadIndex, job) || steal(threadIndex, job)) {
+      execute(job, threadIndex);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t grainSize, const RangeFunction& function) {
+  if (count == 0) return;
+
+  grainSize = std::max(grainSize, 1u);
+
+  if (m_workers.empty() || count <= grainSize) {
+    function(0, count, getThreadIndex());
+    return;
+  }
+
+  JobCounter counter;
+  RangeContext context{this, &function, &counter, grainSize};
+
+  runRange(&context, 0, count, getThreadIndex());
+  wait(counter);
+}
+
+// Keeps the lower half and hands the upper half to the deque, where idle
+// threads can steal it. The capture stays small enough for std::function's
+// inline storage.
+void JobSystem::runRange(const RangeContext* context, uint32_t begin, uint32_t end, uint32_t threadIndex) {
+  while (end - begin > context->grainSize) {
+    uint32_t middle = begin + (end - begin) / 2;
+    uint32_t upperEnd = end;
+    context->system->run([context, middle, upperEnd](uint32_t thread) {
+      runRange(context, middle, upperEnd, thread);
+    }, context->counter);
+    end = middle;
+  }
+
+  (*context->function)(begin, end, threadIndex);
+}
+
+void JobSystem::workerLoop(uint32_t threadIndex, bool pinThread) {
+  t_threadIndex = threadIndex;
+  t_owner = this;
+
+  if (pinThread) {
+    pinCurrentThread(threadIndex);
+  }
+
+  while (true) {
+    Job job;
+    if (pop(threadIndex, job) || steal(threadIndex, job)) {
+      execute(job, threadIndex);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    m_wake.wait(lock, [this] { return m_quit || m_queuedJobs.load(std::memory_order_acquire) > 0; });
+    if (m_quit) return;
+  }
+}
+
+void JobSystem::push(uint32_t threadIndex, Job&& job) {
+  {
+    WorkQueue& queue = *m_queues[threadIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back(std::move(job));
+  }
+  m_queuedJobs.fetch_add(1, std::memory_order_release);
+
+  // Taking the sleep mutex orders this push against a worker that is about
+  // to wait, so the wake-up cannot be lost.
+  { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+  m_wake.notify_one();
+}
+
+bool JobSystem::pop(uint32_t threadIndex, Job& job) {
+  WorkQueue& queue = *m_queues[threadIndex];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.jobs.empty()) return false;
+
+  job = std::move(queue.jobs.back());
+  queue.jobs.pop_back();
+  m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool JobSystem::steal(uint32_t threadIndex, Job& job) {
+  if (m_queuedJobs.load(std::memory_order_acquire) == 0) return false;
+
+  const uint32_t queueCount = static_cast<uint32_t>(m_queues.size());
+  for (uint32_t offset = 1; offset < queueCount; ++offset) {
+    WorkQueue& queue = *m_queues[(threadIndex + offset) % queueCount];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty()) continue;
+
+    job = std::move(queue.jobs.front());
+    queue.jobs.pop_front();
+    m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  return false;
+}
+
+void JobSystem::execute(Job& job, uint32_t threadIndex) {
+  job.task(threadIndex);
+  finish(job.counter);
+}
+
+// The decrement that completes a counter happens under its mutex, and
+// wait() takes that mutex before returning, so a waiter cannot destroy the
+// counter while the last job is still touching it.
+void JobSystem::finish(JobCounter* counter) {
+  if (!counter) return;
+
+  uint32_t pending = counter->m_pending.load(std::memory_order_acquire);
+  while (pending > 1) {
+    if (counter->m_pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel)) {
+      return;
+    }
+  }
+
+  std::vector<JobCounter::Continuation> continuations;
+  {
+    std::lock_guard<std::mutex> lock(counter->m_mutex);
+    if (counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    continuations.swap(counter->m_continuations);
+  }
+
+  for (auto& continuation : continuations) {
+    Job job{std::move(continuation.task), continuation.counter};
+    if (m_workers.empty()) {
+      execute(job, 0);
+    } else {
+      push(getThreadIndex(), std::move(job));
+    }
+  }
+}
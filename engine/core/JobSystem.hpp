@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class JobSystem;
+
+// Tracks a group of jobs. A counter is done once every job started with it
+// (and every job that was chained behind it with runAfter) has finished.
+// Only destroy a counter after JobSystem::wait() returned for it.
+class JobCounter {
+public:
+  JobCounter() = default;
+  JobCounter(const JobCounter&) = delete;
+  JobCounter& operator=(const JobCounter&) = delete;
+
+  bool isDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+  friend class JobSystem;
+
+  struct Continuation {
+    std::function<void(uint32_t)> task;
+    JobCounter* counter;
+  };
+
+  std::atomic<uint32_t> m_pending{0};
+  mutable std::mutex m_mutex;
+  std::vector<Continuation> m_continuations;
+};
+
+// Work-stealing scheduler. Every worker owns a deque: it pushes and pops
+// its own jobs at the back and idle workers steal from the front of the
+// others. The thread that created the job system is thread index 0 and
+// only runs jobs while it waits; workers are 1..getThreadCount()-1, so
+// per-thread scratch buffers need getThreadCount() entries.
+//
+// On WASM, or with zero workers, no threads are started and every job runs
+// inline at submission.
+class JobSystem {
+public:
+  using Task = std::function<void(uint32_t threadIndex)>;
+  using RangeFunction = std::function<void(uint32_t begin, uint32_t end, uint32_t threadIndex)>;
+
+  struct Config {
+    uint32_t workerCount = defaultWorkerCount();
+    // Pin worker i to hardware thread i + 1 where the platform allows it.
+    bool pinThreads = false;
+  };
+
+  JobSystem();
+  explicit JobSystem(const Config& config);
+  explicit JobSystem(uint32_t workerCount);
+  ~JobSystem();
+
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+
+  uint32_t getThreadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+  uint32_t getThreadIndex() const;
+
+  void run(Task task, JobCounter* counter = nullptr);
+  // Runs task once dependency is done. counter is incremented immediately.
+  void runAfter(JobCounter& dependency, Task task, JobCounter* counter = nullptr);
+  // Executes other jobs until counter is done.
+  void wait(const JobCounter& counter);
+
+  // Recursively splits [0, count) in halves down to grainSize and blocks
+  // until every range ran. Which thread runs which range is not
+  // deterministic.
+  void parallelFor(uint32_t count, uint32_t grainSize, const RangeFunction& function);
+
+  static uint32_t defaultWorkerCount();
+
+private:
+  struct Job {
+    Task task;
+    JobCounter* counter = nullptr;
+  };
+
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  struct RangeContext {
+    JobSystem* system;
+    const RangeFunction* function;
+    JobCounter* counter;
+    uint32_t grainSize;
+  };
+
+  std::vector<std::thread> m_workers;
+  std::vector<std::unique_ptr<WorkQueue>> m_queues;
+
+  std::atomic<uint32_t> m_queuedJobs{0};
+  std::mutex m_sleepMutex;
+  std::condition_variable m_wake;
+  bool m_quit = false;
+
+  void start(const Config& config);
+  void workerLoop(uint32_t threadIndex, bool pinThread);
+
+  void push(uint32_t threadIndex, Job&& job);
+  bool pop(uint32_t threadIndex, Job& job);
+  bool steal(uint32_t threadIndex, Job& job);
+  void execute(Job& job, uint32_t threadIndex);
+  void finish(JobCounter* counter);
+
+  static void runRange(const RangeContext* context, uint32_t begin, uint32_t end, uint32_t threadIndex);
+};
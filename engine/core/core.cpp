@@ -6,8 +6,15 @@ CoreEngine::CoreEngine(std::shared_ptr<Context> ctx) : m_context(ctx) {
     CRITLOG("Failed to Initialize SDL3!");
   }
 
+  m_jobSystem = std::make_unique<JobSystem>();
+  m_context->jobSystem = m_jobSystem.get();
+
+  m_physicsEngine = std::make_unique<PhysicsEngine>();
+  m_physicsEngine->setJobSystem(m_jobSystem.get());
+  m_physicsEngine->setProfilingEnabled(true);
+
   m_renderer = createRenderer(m_context);
-  m_resourceManager = std::make_unique<ResourceManager>();
+  m_resourceManager = std::make_unique<ResourceManager>(m_jobSystem.get());
 
   LOG("Core engine initialized");
 
@@ -20,9 +27,11 @@ CoreEngine::CoreEngine(std::shared_ptr<Context> ctx) : m_context(ctx) {
   m_performanceMetrics.avgFrameTime = 0.0;
   m_performanceMetrics.avgUpdateTime = 0.0;
   m_performanceMetrics.avgRenderTime = 0.0;
+  m_performanceMetrics.avgPhysicsTime = 0.0;
   m_performanceMetrics.frameTimeHistory.resize(m_performanceMetrics.frameTimeHistorySize, 0.0);
   m_performanceMetrics.updateTimeHistory.resize(m_performanceMetrics.frameTimeHistorySize, 0.0);
   m_performanceMetrics.renderTimeHistory.resize(m_performanceMetrics.frameTimeHistorySize, 0.0);
+  m_performanceMetrics.physicsTimeHistory.resize(m_performanceMetrics.frameTimeHistorySize, 0.0);
 }
 
 CoreEngine::~CoreEngine() {
@@ -50,6 +59,7 @@ void CoreEngine::run() {
     
     uint64_t updateStartTime = SDLCompat::GetTicks();
     int updateCount = 0;
+    m_physicsFrameTime = 0.0;
     
     while (m_gameLoopData.accumulator >= m_gameLoopData.fixedTimeStep) {
       fixedUpdate(m_gameLoopData.fixedTimeStep);
@@ -79,7 +89,7 @@ void CoreEngine::run() {
     uint64_t frameEndTime = SDLCompat::GetTicks();
     double frameTime = (frameEndTime - frameStartTime) / 1000.0;
     
-    updatePerformanceMetrics(frameTime, updateTime, renderTime);
+    updatePerformanceMetrics(frameTime, updateTime, renderTime, m_physicsFrameTime);
     
     m_gameLoopData.frameCount++;
     if (currentTime - m_gameLoopData.lastFPSUpdateTime >= m_gameLoopData.fpsUpdateInterval) {
@@ -91,6 +101,7 @@ void CoreEngine::run() {
       
       LOOPLOG("FPS: ", std::fixed, std::setprecision(1), fps, 
               " | Frame time: ", std::setprecision(2), frameTimeAvg * 1000.0, "ms", 
+              " | Physics: ", m_performanceMetrics.avgPhysicsTime * 1000.0, "ms",
               " | Updates/s: ", m_gameLoopData.fixedUpdateCount / elapsedSeconds);
       
       m_gameLoopData.frameCount = 0;
@@ -127,6 +138,11 @@ void CoreEngine::fixedUpdate(double fixedTimeStep) {
   if(m_game) {
     m_game->update(fixedTimeStep);
   }
+
+  m_physicsEngine->update(static_cast<float>(fixedTimeStep));
+  if (m_physicsEngine->isProfilingEnabled()) {
+    m_physicsFrameTime += static_cast<double>(m_physicsEngine->getStats().stepNs) / 1e9;
+  }
 }
 
 void CoreEngine::variableUpdate(double deltaTime) {
@@ -137,16 +153,18 @@ void CoreEngine::render(double interpolation) {
   m_renderer->beginFrame();
 
   if(m_game) {
-    m_game->render(m_renderer.get());
+    m_game->render(m_renderer.get(), interpolation);
   }
 
   m_renderer->endFrame();
 }
 
-void CoreEngine::updatePerformanceMetrics(double frameTime, double updateTime, double renderTime) {
+void CoreEngine::updatePerformanceMetrics(double frameTime, double updateTime, double renderTime, double physicsTime) {
   m_performanceMetrics.frameTimeHistory[m_performanceMetrics.frameTimeHistoryIndex] = frameTime;
   m_performanceMetrics.updateTimeHistory[m_performanceMetrics.frameTimeHistoryIndex] = updateTime;
   m_performanceMetrics.renderTimeHistory[m_performanceMetrics.frameTimeHistoryIndex] = renderTime;
+  m_performanceMetrics.physicsTimeHistory[m_performanceMetrics.frameTimeHistoryIndex] = physicsTime;
+  m_performanceMetrics.physics = m_physicsEngine->getStats();
   
   m_performanceMetrics.frameTimeHistoryIndex = 
     (m_performanceMetrics.frameTimeHistoryIndex + 1) % m_performanceMetrics.frameTimeHistorySize;
@@ -154,16 +172,20 @@ void CoreEngine::updatePerformanceMetrics(double frameTime, double updateTime, d
   m_performanceMetrics.avgFrameTime = 0.0;
   m_performanceMetrics.avgUpdateTime = 0.0;
   m_performanceMetrics.avgRenderTime = 0.0;
+  m_performanceMetrics.avgPhysicsTime = 0.0;
   
   for (size_t i = 0; i < m_performanceMetrics.frameTimeHistorySize; i++) {
     m_performanceMetrics.avgFrameTime += m_performanceMetrics.frameTimeHistory[i];
     m_performanceMetrics.avgUpdateTime += m_performanceMetrics.updateTimeHistory[i];
     m_performanceMetrics.avgRenderTime += m_performanceMetrics.renderTimeHistory[i];
+    m_performanceMetrics.avgPhysicsTime += m_performanceMetrics.physicsTimeHistory[i];
   }
   
-  m_performanceMetrics.avgFrameTime /= m_performanceMetrics.frameTimeHistorySize;
-  m_performanceMetrics.avgUpdateTime /= m_performanceMetrics.frameTimeHistorySize;
-  m_performanceMetrics.avgRenderTime /= m_performanceMetrics.frameTimeHistorySize;
+  const double historySize = static_cast<double>(m_performanceMetrics.frameTimeHistorySize);
+  m_performanceMetrics.avgFrameTime /= historySize;
+  m_performanceMetrics.avgUpdateTime /= historySize;
+  m_performanceMetrics.avgRenderTime /= historySize;
+  m_performanceMetrics.avgPhysicsTime /= historySize;
 }
 
 void CoreEngine::limitFrameRate(uint64_t frameStartTime) {
@@ -3,6 +3,8 @@
 #include "Renderer/Inter_Renderer.hpp"
 #include "Renderer/factory_renderer.hpp"
 #include "ResourceManager/ResourceManager.hpp"
+#include "JobSystem.hpp"
+#include "Physics/Physics.hpp"
 
 class Game;
 
@@ -13,7 +15,8 @@ typedef struct GameLoopData_t {
 
   bool limitFrameRate = true;
   double targetFPS = 165.0;
-  double fixedTimeStep = 1.0f / 165.f;
+  // Independent of targetFPS; render() interpolates between steps.
+  double fixedTimeStep = 1.0f / 60.f;
   double maxFrameTime = 0.25f;
 
   uint32_t frameCount = 0;
@@ -30,10 +33,16 @@ typedef struct PerformanceMetrics_t {
   double avgFrameTime = 0.0f;
   double avgUpdateTime = 0.0f;
   double avgRenderTime = 0.0f;
+  // Physics steps of a frame, a part of the update time.
+  double avgPhysicsTime = 0.0;
 
   std::vector<double> frameTimeHistory;
   std::vector<double> updateTimeHistory;
   std::vector<double> renderTimeHistory;
+  std::vector<double> physicsTimeHistory;
+
+  // Phase timings and counters of the last physics step.
+  PhysicsStats physics;
 
   size_t frameTimeHistorySize = 60;
   size_t frameTimeHistoryIndex = 0;
@@ -52,12 +61,15 @@ public:
   void variableUpdate(double deltaTime);
   void render(double interpolation);
 
-  void updatePerformanceMetrics(double frameTime, double updateTime, double renderTime);
+  void updatePerformanceMetrics(double frameTime, double updateTime, double renderTime, double physicsTime);
   void limitFrameRate(uint64_t frameStartTime);
   PerformanceMetrics getPerformanceMetrics() const;
 
   IRenderer* getRenderer() const { return m_renderer.get(); }
   ResourceManager* getResourceManager() const { return m_resourceManager.get(); }
+  JobSystem* getJobSystem() const { return m_jobSystem.get(); }
+  PhysicsEngine* getPhysicsEngine() const { return m_physicsEngine.get(); }
+  const GameLoopData& getGameLoopData() const { return m_gameLoopData; }
 
   WindowData getWindowSize() const {
     if(m_context) {
@@ -74,6 +86,10 @@ private:
   GameLoopData m_gameLoopData;
   PerformanceMetrics m_performanceMetrics;
   
+  // Declared first so it outlives every system that submits jobs to it.
+  std::unique_ptr<JobSystem> m_jobSystem;
+  std::unique_ptr<PhysicsEngine> m_physicsEngine;
+  double m_physicsFrameTime = 0.0;
   std::unique_ptr<Game> m_game;
   std::unique_ptr<IRenderer> m_renderer;
   std::unique_ptr<ResourceManager> m_resourceManager;
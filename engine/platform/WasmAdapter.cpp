@@ -14,12 +14,13 @@ void emscripten_main_loop_callback(void* arg) {
     
     if (!engine || !game) return;
     
+    const GameLoopData loopData = engine->getGameLoopData();
     uint64_t currentTime = SDLCompat::GetTicks();
     double deltaTime = (currentTime - adapter->getLastFrameTime()) / 1000.0;
     
-    if (deltaTime > 0.25) {
-        WARLOG("Frame time exceeded maximum threshold: ", deltaTime, "s. Capping to 0.25s");
-        deltaTime = 0.25;
+    if (deltaTime > loopData.maxFrameTime) {
+        WARLOG("Frame time exceeded maximum threshold: ", deltaTime, "s. Capping to ", loopData.maxFrameTime, "s");
+        deltaTime = loopData.maxFrameTime;
     }
     
     adapter->setLastFrameTime(currentTime);
@@ -48,12 +49,15 @@ void emscripten_main_loop_callback(void* arg) {
     adapter->addAccumulatedTime(deltaTime);
     
     int updateCount = 0;
-    const double fixedTimeStep = 1.0 / 60.0;
+    const double fixedTimeStep = loopData.fixedTimeStep;
     
-    while (adapter->getAccumulatedTime() >= fixedTimeStep && updateCount < 5) {
+    while (adapter->getAccumulatedTime() >= fixedTimeStep && updateCount < loopData.maxUpdatesPerFrame) {
         if (game) {
             game->update(fixedTimeStep);
         }
+        if (engine->getPhysicsEngine()) {
+            engine->getPhysicsEngine()->update(static_cast<float>(fixedTimeStep));
+        }
         adapter->reduceAccumulatedTime(fixedTimeStep);
         updateCount++;
     }
@@ -65,7 +69,7 @@ void emscripten_main_loop_callback(void* arg) {
         renderer->beginFrame();
         
         if (game) {
-            game->render(renderer);
+            game->render(renderer, alpha);
         }
         
         renderer->endFrame();
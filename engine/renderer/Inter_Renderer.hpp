@@ -4,6 +4,8 @@
 #include "loadShader.hpp"
 #include "Sprite.hpp"
 
+class JobSystem;
+
 enum class RenderType {
   OPENGL,
   OPENGL_ES_3,
@@ -20,6 +22,7 @@ typedef struct Context_t {
   WindowData window_data;
   RenderType api;
   Shader shader;
+  JobSystem* jobSystem = nullptr;
 } Context; 
 
 class IRenderer {
@@ -37,4 +40,5 @@ public:
     const glm::vec2& size = glm::vec2(1.0f),
     float rotation = 0.0f, 
     const glm::vec4& color = glm::vec4(1.0f)) = 0;
+  virtual void drawSprites(const std::vector<const Sprite*>& sprites) = 0;
 };
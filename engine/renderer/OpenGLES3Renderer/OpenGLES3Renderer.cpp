@@ -74,6 +74,7 @@ void OpenGLES3Renderer::setShader(const Shader& shader) {
 void OpenGLES3Renderer::initSpriteRenderer() {
   m_spriteRenderer = std::make_unique<SpriteRenderer>();
   m_spriteRenderer->init(m_ctx->window_data.width, m_ctx->window_data.height);
+  m_spriteRenderer->setJobSystem(m_ctx->jobSystem);
   LOG("Sprite renderer initialized");
 }
 
@@ -88,3 +89,9 @@ void OpenGLES3Renderer::drawSprite(const Sprite& sprite) {
     m_spriteRenderer->drawSprite(sprite);
   }
 }
+
+void OpenGLES3Renderer::drawSprites(const std::vector<const Sprite*>& sprites) {
+  if (m_spriteRenderer) {
+    m_spriteRenderer->drawSprites(sprites);
+  }
+}
@@ -28,6 +28,7 @@ public:
   void drawSprite(const Texture* texture, const glm::vec2& position, 
                  const glm::vec2& size, float rotation, 
                  const glm::vec4& color) override;
+  void drawSprites(const std::vector<const Sprite*>& sprites) override;
 
 private:
   SDL_Window* m_window;
@@ -35,3 +35,7 @@ void SoftwareRenderer::drawSprite(const Sprite& sprite) {
 void SoftwareRenderer::drawSprite(const Texture* texture, const glm::vec2& position, const glm::vec2& size, float rotation, const glm::vec4& color) {
   
 }
+
+void SoftwareRenderer::drawSprites(const std::vector<const Sprite*>& sprites) {
+
+}
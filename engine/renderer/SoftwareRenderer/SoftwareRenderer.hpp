@@ -18,6 +18,7 @@ public:
   void initSpriteRenderer() override;
   void drawSprite(const Sprite& sprite) override;
   void drawSprite(const Texture* texture, const glm::vec2& position, const glm::vec2& size = glm::vec2(1.0f), float rotation = 0.0f, const glm::vec4& color = glm::vec4(1.0f)) override;
+  void drawSprites(const std::vector<const Sprite*>& sprites) override;
 
 private:
 
@@ -10,7 +10,35 @@ Texture::~Texture() {
   }
 }
 
+void Texture::PixelDeleter::operator()(unsigned char* pixels) const {
+  stbi_image_free(pixels);
+}
+
 bool Texture::loadFromFile(const std::string& path) {
+  ImageData image;
+  if(!decodeFile(path, image)) {
+    ERRLOG("Failed to load texture: ", path);
+    return false;
+  }
+
+  upload(image);
+  LOG("Loaded texture: ", path, " (", m_width, "x", m_height, ", ", m_channels, " channels)");
+  return true;
+}
+
+bool Texture::decodeFile(const std::string& path, ImageData& image) {
+  // The per-thread flag keeps concurrent decodes from racing on stb's
+  // global setting.
+  stbi_set_flip_vertically_on_load_thread(true);
+  image.pixels.reset(stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 0));
+  return image.pixels != nullptr;
+}
+
+bool Texture::upload(const ImageData& image) {
+  if(!image.pixels) {
+    return false;
+  }
+
   if(m_textureID > 0) {
     glDeleteTextures(1, &m_textureID);
   }
@@ -23,31 +51,23 @@ bool Texture::loadFromFile(const std::string& path) {
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-  stbi_set_flip_vertically_on_load(true);
-  unsigned char* data = stbi_load(path.c_str(), &m_width, &m_height, &m_channels, 0);
-
-  if(data) {
-    GLenum format = GL_RGB;
-    if(m_channels == 1) {
-      format = GL_RED;
-    } else if(m_channels == 3) {
-      format = GL_RGB;
-    } else if(m_channels == 4) {
-      format = GL_RGBA;
-    }
-
-    glTexImage2D(GL_TEXTURE_2D, 0, format, m_width, m_height, 0, format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+  m_width = image.width;
+  m_height = image.height;
+  m_channels = image.channels;
+
+  GLenum format = GL_RGB;
+  if(m_channels == 1) {
+    format = GL_RED;
+  } else if(m_channels == 3) {
+    format = GL_RGB;
+  } else if(m_channels == 4) {
+    format = GL_RGBA;
+  }
 
-    LOG("Loaded texture: ", path, " (", m_width, "x", m_height, ", ", m_channels, " channels)");
+  glTexImage2D(GL_TEXTURE_2D, 0, format, m_width, m_height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get());
+  glGenerateMipmap(GL_TEXTURE_2D);
 
-    stbi_image_free(data);
-    return true;
-  } else {
-    ERRLOG("Failed to load texture: ", path);
-    stbi_image_free(data);
-    return false;
-  }
+  return true;
 }
 
 void Texture::bind(unsigned int slot) const {
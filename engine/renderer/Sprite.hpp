@@ -3,11 +3,27 @@
 
 class Texture {
 public:
+  struct PixelDeleter {
+    void operator()(unsigned char* pixels) const;
+  };
+
+  struct ImageData {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::unique_ptr<unsigned char, PixelDeleter> pixels;
+  };
+
   Texture() = default;
   ~Texture();
 
   bool loadFromFile(const std::string& path);
 
+  // decodeFile() touches no GL state and can run on any thread; upload()
+  // must run on the thread that owns the GL context.
+  static bool decodeFile(const std::string& path, ImageData& image);
+  bool upload(const ImageData& image);
+
   static bool loadTextureFromFile(const std::string& path, Texture& texture) {
     return texture.loadFromFile(path);
   }
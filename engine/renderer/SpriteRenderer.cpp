@@ -1,4 +1,5 @@
 #include "SpriteRenderer.hpp"
+#include "Core/JobSystem.hpp"
 
 SpriteRenderer::SpriteRenderer() {}
 
@@ -41,20 +42,7 @@ void SpriteRenderer::drawSprite(const Sprite& sprite) {
     return;
   }
 
-  glm::mat4 model = glm::mat4(1.0f);
-
-  model = glm::translate(model, glm::vec3(
-    sprite.getPosition().x - (sprite.getSize().x / 2.0f),
-    sprite.getPosition().y - (sprite.getSize().y / 2.0f),
-    0.0f));
-
-  if(sprite.getRotation() != 0.0f) {
-    model = glm::translate(model, glm::vec3(sprite.getSize().x * 0.5f, sprite.getSize().y * 0.5f, 0.0f));
-    model = glm::rotate(model, sprite.getRotation(), glm::vec3(0.0f, 0.0f, 1.0f));
-    model = glm::translate(model, glm::vec3(-sprite.getSize().x * 0.5f, -sprite.getSize().y * 0.5f, 0.0f));
-  }
-
-  model = glm::scale(model, glm::vec3(sprite.getSize(), 1.0f));
+  glm::mat4 model = computeModelMatrix(sprite.getPosition(), sprite.getSize(), sprite.getRotation());
 
   m_shader.setMat4("model", model);
   m_shader.setVec4("color", sprite.getColor());
@@ -72,20 +60,7 @@ void SpriteRenderer::drawSprite(const Texture* texture, const glm::vec2& positio
       return;
     }
   
-    glm::mat4 model = glm::mat4(1.0f);
-    
-    model = glm::translate(model, glm::vec3(
-      position.x - (size.x / 2.0f), 
-      position.y - (size.y / 2.0f), 
-      0.0f));
-    
-    if (rotation != 0.0f) {
-      model = glm::translate(model, glm::vec3(size.x * 0.5f, size.y * 0.5f, 0.0f));
-      model = glm::rotate(model, rotation, glm::vec3(0.0f, 0.0f, 1.0f));
-      model = glm::translate(model, glm::vec3(-size.x * 0.5f, -size.y * 0.5f, 0.0f));
-    }
-    
-    model = glm::scale(model, glm::vec3(size, 1.0f));
+    glm::mat4 model = computeModelMatrix(position, size, rotation);
   
     Sprite tempSprite;
     tempSprite.init(size.x, size.y);
@@ -101,6 +76,65 @@ void SpriteRenderer::drawSprite(const Texture* texture, const glm::vec2& positio
     glBindVertexArray(0);
 }
 
+void SpriteRenderer::drawSprites(const std::vector<const Sprite*>& sprites) {
+  const uint32_t count = static_cast<uint32_t>(sprites.size());
+  m_batchModels.resize(count);
+
+  auto buildModels = [this, &sprites](uint32_t begin, uint32_t end, uint32_t) {
+    for (uint32_t i = begin; i < end; ++i) {
+      const Sprite* sprite = sprites[i];
+      if (sprite) {
+        m_batchModels[i] = computeModelMatrix(sprite->getPosition(), sprite->getSize(), sprite->getRotation());
+      }
+    }
+  };
+
+  if (m_jobSystem) {
+    m_jobSystem->parallelFor(count, BATCH_GRAIN_SIZE, buildModels);
+  } else {
+    buildModels(0, count, 0);
+  }
+
+  const Texture* boundTexture = nullptr;
+  for (uint32_t i = 0; i < count; ++i) {
+    const Sprite* sprite = sprites[i];
+    if (!sprite || !sprite->getTexture()) {
+      WARLOG("Attempting to draw sprite with no texture");
+      continue;
+    }
+
+    m_shader.setMat4("model", m_batchModels[i]);
+    m_shader.setVec4("color", sprite->getColor());
+
+    if (sprite->getTexture() != boundTexture) {
+      boundTexture = sprite->getTexture();
+      boundTexture->bind();
+    }
+
+    glBindVertexArray(sprite->getVAO());
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+  }
+  glBindVertexArray(0);
+}
+
 void SpriteRenderer::setShader(const Shader& shader) {
   m_shader = shader;
 }
+
+glm::mat4 SpriteRenderer::computeModelMatrix(const glm::vec2& position, const glm::vec2& size, float rotation) {
+  glm::mat4 model = glm::mat4(1.0f);
+
+  model = glm::translate(model, glm::vec3(
+    position.x - (size.x / 2.0f),
+    position.y - (size.y / 2.0f),
+    0.0f));
+
+  if(rotation != 0.0f) {
+    model = glm::translate(model, glm::vec3(size.x * 0.5f, size.y * 0.5f, 0.0f));
+    model = glm::rotate(model, rotation, glm::vec3(0.0f, 0.0f, 1.0f));
+    model = glm::translate(model, glm::vec3(-size.x * 0.5f, -size.y * 0.5f, 0.0f));
+  }
+
+  model = glm::scale(model, glm::vec3(size, 1.0f));
+  return model;
+}
@@ -3,6 +3,8 @@
 #include "Sprite.hpp"
 #include "loadShader.hpp"
 
+class JobSystem;
+
 class SpriteRenderer {
 public:
   SpriteRenderer();
@@ -19,11 +21,23 @@ public:
                   const glm::vec2& size = glm::vec2(1.0f),
                   float rotation = 0.0f,
                   const glm::vec4& color = glm::vec4(1.0f));
+  // Builds all model matrices up front (in parallel when a job system is
+  // set), then issues the draws on the calling thread.
+  void drawSprites(const std::vector<const Sprite*>& sprites);
 
   void setShader(const Shader& shader);
   Shader& getShader() { return m_shader; }
 
+  void setJobSystem(JobSystem* jobSystem) { m_jobSystem = jobSystem; }
+
 private:
+  static constexpr uint32_t BATCH_GRAIN_SIZE = 256;
+
   Shader m_shader;
   glm::mat4 m_projectionMatrix;
+
+  JobSystem* m_jobSystem = nullptr;
+  std::vector<glm::mat4> m_batchModels;
+
+  static glm::mat4 computeModelMatrix(const glm::vec2& position, const glm::vec2& size, float rotation);
 };